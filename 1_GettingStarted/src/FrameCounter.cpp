@@ -0,0 +1,46 @@
+#include "FrameCounter.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+// Guarded, since a counter may be created or destroyed on any thread. Built on first use: static
+// counters register during static initialization.
+struct CounterRegistry {
+    mutex lock;
+    vector<FrameCounters *> counters;
+};
+
+static CounterRegistry &registry()
+{
+    static CounterRegistry counters;
+    return counters;
+}
+
+FrameCounters::FrameCounters()
+{
+    CounterRegistry &counters = registry();
+    lock_guard<mutex> lock(counters.lock);
+    counters.counters.push_back(this);
+}
+
+FrameCounters::FrameCounters(const FrameCounters &) : FrameCounters()
+{
+}
+
+FrameCounters::~FrameCounters()
+{
+    CounterRegistry &counters = registry();
+    lock_guard<mutex> lock(counters.lock);
+    counters.counters.erase(remove(counters.counters.begin(), counters.counters.end(), this), counters.counters.end());
+}
+
+void FrameCounters::EndFrame()
+{
+    CounterRegistry &counters = registry();
+    lock_guard<mutex> lock(counters.lock);
+    for (FrameCounters *counter : counters.counters)
+        counter->endFrame();
+}
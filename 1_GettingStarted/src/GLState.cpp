@@ -0,0 +1,161 @@
+#include "GLState.hpp"
+
+#include <iostream>
+
+GLState &GLState::Instance()
+{
+    static GLState state;
+    return state;
+}
+
+int GLState::bufferSlot(GLenum target)
+{
+    switch (target)
+    {
+        case GL_ARRAY_BUFFER:         return 0;
+        case GL_ELEMENT_ARRAY_BUFFER: return 1;
+        case GL_UNIFORM_BUFFER:       return 2;
+        case GL_PIXEL_UNPACK_BUFFER:  return 3;
+        case GL_DRAW_INDIRECT_BUFFER: return 4;
+        default:                      return -1;
+    }
+}
+
+int GLState::textureSlot(GLenum target)
+{
+    switch (target)
+    {
+        case GL_TEXTURE_2D:       return 0;
+        case GL_TEXTURE_2D_ARRAY: return 1;
+        case GL_TEXTURE_CUBE_MAP: return 2;
+        default:                  return -1;
+    }
+}
+
+bool GLState::update(GLuint &shadow, GLuint value)
+{
+    if (shadow == value)
+    {
+        frame.ThisFrame().elided++;
+        total.elided++;
+        return false;
+    }
+    shadow = value;
+    frame.ThisFrame().issued++;
+    total.issued++;
+    return true;
+}
+
+void GLState::UseProgram(GLuint program)
+{
+    if (update(this->program, program))
+        glUseProgram(program);
+}
+
+void GLState::BindVertexArray(GLuint vertexArray)
+{
+    if (update(this->vertexArray, vertexArray))
+    {
+        glBindVertexArray(vertexArray);
+        // the element array binding is part of the vertex array we just switched to
+        buffers[bufferSlot(GL_ELEMENT_ARRAY_BUFFER)] = UNKNOWN;
+    }
+}
+
+void GLState::BindBuffer(GLenum target, GLuint buffer)
+{
+    int slot = bufferSlot(target);
+    GLuint untracked = UNKNOWN;
+    if (update(slot >= 0 ? buffers[slot] : untracked, buffer))
+        glBindBuffer(target, buffer);
+}
+
+void GLState::BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+    glBindBufferRange(target, index, buffer, offset, size);
+    int slot = bufferSlot(target);
+    if (slot >= 0)
+        buffers[slot] = buffer;
+    frame.ThisFrame().issued++;
+    total.issued++;
+}
+
+void GLState::ActiveTexture(GLenum unit)
+{
+    if (update(activeUnit, unit))
+        glActiveTexture(unit);
+}
+
+void GLState::BindTexture(GLenum target, GLuint texture)
+{
+    int slot = textureSlot(target);
+    GLuint unit = activeUnit - GL_TEXTURE0;
+    GLuint untracked = UNKNOWN;
+    bool tracked = slot >= 0 && activeUnit != UNKNOWN && unit < MAX_TEXTURE_UNITS;
+    if (update(tracked ? textures[unit][slot] : untracked, texture))
+        glBindTexture(target, texture);
+}
+
+void GLState::BindTextureUnit(GLuint unit, GLenum target, GLuint texture)
+{
+    int slot = textureSlot(target);
+    // skip the unit switch too when the texture is already bound there
+    if (slot >= 0 && unit < MAX_TEXTURE_UNITS && textures[unit][slot] == texture)
+    {
+        frame.ThisFrame().elided++;
+        total.elided++;
+        return;
+    }
+    ActiveTexture(GL_TEXTURE0 + unit);
+    BindTexture(target, texture);
+}
+
+void GLState::ProgramDeleted(GLuint program)
+{
+    // a deleted program stays in use until another one is bound, make sure the next bind goes through
+    if (this->program == program)
+        this->program = UNKNOWN;
+}
+
+void GLState::VertexArrayDeleted(GLuint vertexArray)
+{
+    if (this->vertexArray == vertexArray)
+    {
+        this->vertexArray = 0;
+        buffers[bufferSlot(GL_ELEMENT_ARRAY_BUFFER)] = UNKNOWN;
+    }
+}
+
+void GLState::BufferDeleted(GLuint buffer)
+{
+    for (GLuint &bound : buffers)
+        if (bound == buffer)
+            bound = 0;
+}
+
+void GLState::TextureDeleted(GLuint texture)
+{
+    for (auto &unit : textures)
+        for (GLuint &bound : unit)
+            if (bound == texture)
+                bound = 0;
+}
+
+void GLState::Invalidate()
+{
+    program = UNKNOWN;
+    vertexArray = UNKNOWN;
+    activeUnit = UNKNOWN;
+    for (GLuint &bound : buffers)
+        bound = UNKNOWN;
+    for (auto &unit : textures)
+        for (GLuint &bound : unit)
+            bound = UNKNOWN;
+}
+
+void GLState::PrintStats() const
+{
+    const GLStateStats &lastFrame = frame.LastFrame();
+    std::cout << "GLState: last frame " << lastFrame.issued << " binds issued, " << lastFrame.elided
+              << " elided; total " << total.issued << " issued, " << total.elided << " elided" << std::endl;
+}
@@ -6,14 +6,31 @@
 #include <sstream>
 #include <iostream>
 #include <cerrno>
+#include <stdint.h>
 
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 std::string get_file_contents(const char* filename);
 
+// Pre-resolved uniform of a Shader, returned by Shader::GetUniform for use in hot paths
+struct UniformHandle
+{
+    int index = -1;
+    bool IsValid() const { return index >= 0; }
+};
+
+// Process-wide count of glUniform* calls issued and skipped because the value was unchanged
+struct UniformCallStats
+{
+    unsigned long issued = 0;
+    unsigned long elided = 0;
+};
+
 class Shader
 {
 public:
@@ -22,6 +39,7 @@ public:
     // Checks if shaders failed to compile during initialization
     void compileErrors(unsigned int shader, const char* type);
     // Constructor that build the Shader Program from 2 different shaders
+    // (or from the program binary cache, when a binary for these sources and this driver exists)
     Shader(const char* vertexFile, const char* fragmentFile);
 
     // Activates the Shader Program
@@ -33,6 +51,52 @@ public:
     void setInt(const std::string &name, int value) const;
     void setFloat(const std::string &name, float value) const;
     void setMat4(const std::string &name, glm::mat4 value) const;
+    void setVec3(const std::string &name, float value1, float value2, float value3) const;
+    void setVec3(const std::string &name, glm::vec3 value) const;
+
+    // Connects the uniform block blockName to a uniform buffer binding point
+    void BindUniformBlock(const char* blockName, GLuint bindingPoint);
+
+    // Looks a uniform up once; the handle setters below skip the name lookup entirely.
+    // Returns an invalid handle (ignored by the setters) for names that are not active.
+    UniformHandle GetUniform(const std::string &name) const;
+    void setBool(UniformHandle uniform, bool value) const;
+    void setInt(UniformHandle uniform, int value) const;
+    void setFloat(UniformHandle uniform, float value) const;
+    void setMat4(UniformHandle uniform, const glm::mat4 &value) const;
+    void setVec3(UniformHandle uniform, float value1, float value2, float value3) const;
+    void setVec3(UniformHandle uniform, glm::vec3 value) const;
+
+    // The shadow assumes this object is the only one setting uniforms of its program
+    static const UniformCallStats &UniformStats() { return uniformStats; }
+    static void PrintUniformStats();
+
+    // Where linked program binaries are cached ("shadercache" by default, empty disables the cache)
+    static void SetBinaryCacheDirectory(const std::string &directory);
+private:
+    // Active uniform as found at link time, with the last value we sent to it
+    struct UniformSlot
+    {
+        GLint location;
+        bool hasValue;
+        GLfloat value[16];
+    };
+    std::unordered_map<std::string, int> uniformIndices;
+    // mutable: the setters are const but remember what they sent
+    mutable std::vector<UniformSlot> uniforms;
+    static UniformCallStats uniformStats;
+    static std::string binaryCacheDirectory;
+
+    void compileFromSource(const std::string &vertexCode, const std::string &fragmentCode, bool retrievable);
+    static uint64_t binaryKey(const std::string &vertexCode, const std::string &fragmentCode);
+    // Creates the program from a cached binary. Returns false (and removes the file) if the driver rejects it.
+    bool loadBinary(const std::string &path, double &sourceCompileMs);
+    void saveBinary(const std::string &path, double sourceCompileMs) const;
+
+    // Builds the uniform table from the linked program
+    void introspectUniforms();
+    // Returns false (and counts it) when the uniform already holds value
+    bool updateShadow(UniformHandle uniform, const void *value, size_t size) const;
 };
 
 #endif
@@ -1,27 +1,46 @@
 #include "VBO.hpp"
+#include "GLState.hpp"
 
 // Constructor that generates a Vertex Buffer Object and links it to vertices
 VBO::VBO(GLfloat* vertices, GLsizeiptr size)
 {
     glGenBuffers(1, &ID);
-    glBindBuffer(GL_ARRAY_BUFFER, ID);
+    GLState::Instance().BindBuffer(GL_ARRAY_BUFFER, ID);
     glBufferData(GL_ARRAY_BUFFER, size, vertices, GL_STATIC_DRAW);
 }
 
+// Constructor that generates an empty Vertex Buffer Object of size bytes, meant to be rewritten with Update
+VBO::VBO(GLsizeiptr size)
+{
+    glGenBuffers(1, &ID);
+    GLState::Instance().BindBuffer(GL_ARRAY_BUFFER, ID);
+    glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STREAM_DRAW);
+}
+
+// Replaces the contents of the VBO with size bytes of data
+void VBO::Update(const void* data, GLsizeiptr size)
+{
+    GLState::Instance().BindBuffer(GL_ARRAY_BUFFER, ID);
+    // Orphan the old storage first so we never wait on a draw that is still reading it
+    glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, size, data);
+}
+
 // Binds the VBO
 void VBO::Bind()
 {
-    glBindBuffer(GL_ARRAY_BUFFER, ID);
+    GLState::Instance().BindBuffer(GL_ARRAY_BUFFER, ID);
 }
 
 // Unbinds the VBO
 void VBO::Unbind()
 {
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    GLState::Instance().BindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 // Deletes the VBO
 void VBO::Delete()
 {
     glDeleteBuffers(1, &ID);
+    GLState::Instance().BufferDeleted(ID);
 }
@@ -1,4 +1,7 @@
 #include <iostream>
+#include <chrono>
+#include <cmath>
+#include <vector>
 
 // GLEW
 #define GLEW_STATIC
@@ -16,6 +19,7 @@
 #include "VAO.hpp"
 #include "VBO.hpp"
 #include "Shader.hpp"
+#include "GLState.hpp"
 
 // GLM
 #include <glm/glm.hpp>
@@ -27,6 +31,9 @@ using namespace std;
 void processInput(GLFWwindow *window);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
+vector<glm::vec3> buildCubeField(const glm::vec3* cubePositions, unsigned int cubeCount, unsigned int fieldCount);
+void buildCubeTransforms(vector<glm::mat4> &transforms, const vector<glm::vec3> &positions, float time, size_t count);
 
 const GLint WIDTH = 800, HEIGHT = 800;
 
@@ -43,6 +50,24 @@ float yaw = -90.0f, pitch = 0.0f;
 float fov = 45.0f;
 bool firstMouse = true;
 
+// --------------------- Cube Field --------------------- //
+/*
+    The scene is the ten tutorial cubes. F extends them into a field of CUBE_FIELD_COUNT cubes.
+    The instanced path uploads every model matrix into one instance buffer and draws all the cubes
+    with a single glDrawArraysInstanced call; the per-draw path is the original setMat4 +
+    glDrawArrays loop. I toggles between the two, B runs a benchmark of both on the field.
+*/
+const unsigned int TUTORIAL_CUBE_COUNT = 10;
+const unsigned int CUBE_FIELD_COUNT = 100000;
+const unsigned int BENCHMARK_FRAMES = 120;
+bool instancedRendering = true;
+bool showCubeField = false;
+// Frame of the running benchmark, BENCHMARK_IDLE when none is running
+const unsigned int BENCHMARK_IDLE = ~0u;
+unsigned int benchmarkFrame = BENCHMARK_IDLE;
+bool instancedBeforeBenchmark = true;
+bool fieldBeforeBenchmark = false;
+
 int main() {
     // --------------------- Initialization --------------------- //
     glfwInit();
@@ -72,6 +97,7 @@ int main() {
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
+    glfwSetKeyCallback(window, key_callback);
     
     lastX = screenWidth;
     lastY = screenHeight;
@@ -93,6 +119,7 @@ int main() {
     
     // Shader Compilation
     Shader shaderProgram("default.vert", "default.frag");
+    Shader instancedShader("instanced.vert", "default.frag");
 
     float vertices[] = {
         -0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
@@ -172,6 +199,12 @@ int main() {
     // Links VBO to VAO
     VAO1.LinkAttrib(VBO1, 0, 3, GL_FLOAT, 5 * sizeof(float), (void*)0);
     VAO1.LinkAttrib(VBO1, 1, 2, GL_FLOAT, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+
+    // Instance buffer with one model matrix per cube, rewritten every frame
+    vector<glm::vec3> cubeField = buildCubeField(cubePositions, TUTORIAL_CUBE_COUNT, CUBE_FIELD_COUNT);
+    vector<glm::mat4> cubeTransforms(cubeField.size());
+    VBO instanceVBO(cubeTransforms.size() * sizeof(glm::mat4));
+    VAO1.LinkInstanceMat4(instanceVBO, 3);
     
     // Unbind all to prevent accidentally modifying them
     VAO1.Unbind();
@@ -211,11 +244,19 @@ int main() {
     // Set the value of the uniforms to the texture units we want
     shaderProgram.setInt("texture1", 0);
     shaderProgram.setInt("texture2", 1);
+    instancedShader.Activate();
+    instancedShader.setInt("texture1", 0);
+    instancedShader.setInt("texture2", 1);
+    UniformHandle modelUniform = shaderProgram.GetUniform("model");
+    double benchmarkMs[2] = { 0.0, 0.0 };
     
     // --------------------- Transformations & Coordinate Systems --------------------- //
 
     
 
+    // Textures were bound directly while loading, start the loop with a clean shadow
+    GLState::Instance().Invalidate();
+
     // --------------------- Render Loop --------------------- //
     while(!glfwWindowShouldClose(window))
     {
@@ -228,45 +269,81 @@ int main() {
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         
         // Activate texture unit and bind our textures to them to pass to frag shader
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texture1);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, texture2);
+        GLState::Instance().BindTextureUnit(0, GL_TEXTURE_2D, texture1);
+        GLState::Instance().BindTextureUnit(1, GL_TEXTURE_2D, texture2);
         
-        shaderProgram.Activate();
+        // The benchmark renders BENCHMARK_FRAMES frames of the field per-draw, then as many instanced
+        if (benchmarkFrame != BENCHMARK_IDLE)
+        {
+            instancedRendering = benchmarkFrame >= BENCHMARK_FRAMES;
+            showCubeField = true;
+        }
+        size_t cubeCount = showCubeField ? cubeField.size() : TUTORIAL_CUBE_COUNT;
+        auto drawStart = chrono::steady_clock::now();
+
+        Shader &cubeShader = instancedRendering ? instancedShader : shaderProgram;
+        cubeShader.Activate();
 
         VAO1.Bind();
         
         // --------------------- Cameras --------------------- //
         glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
-        shaderProgram.setMat4("view", view);
+        cubeShader.setMat4("view", view);
         
         glm::mat4 projection = glm::perspective(glm::radians(fov), 800.0f / 600.0f, 0.1f, 100.0f);
-        shaderProgram.setMat4("projection", projection);
-        // Draw the triangle using the GL_TRIANGLES primitive
-        for(unsigned int i = 0; i < 10; i++)
+        cubeShader.setMat4("projection", projection);
+
+        buildCubeTransforms(cubeTransforms, cubeField, (float)glfwGetTime(), cubeCount);
+        if (instancedRendering)
+        {
+            // One upload and one draw call for every cube
+            instanceVBO.Update(&cubeTransforms[0], cubeCount * sizeof(glm::mat4));
+            glDrawArraysInstanced(GL_TRIANGLES, 0, 36, (GLsizei)cubeCount);
+        }
+        else
         {
-            glm::mat4 model = glm::mat4(1.0f);
-            model = glm::translate(model, cubePositions[i]);
-            float angle = 20.0f * i;
-            model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
-            if(i % 3 == 0) {
-                model = glm::rotate(model, (float)glfwGetTime() * glm::radians(10.0f), glm::vec3(0.5f, 1.0f, 0.0f));
+            // Draw the triangle using the GL_TRIANGLES primitive
+            for(unsigned int i = 0; i < cubeCount; i++)
+            {
+                shaderProgram.setMat4(modelUniform, cubeTransforms[i]);
+
+                glDrawArrays(GL_TRIANGLES, 0, 36);
             }
-            shaderProgram.setMat4("model", model);
+        }
 
-            glDrawArrays(GL_TRIANGLES, 0, 36);
+        if (benchmarkFrame != BENCHMARK_IDLE)
+        {
+            // Wait for the GPU so the frame time covers the whole draw, not just its submission
+            glFinish();
+            benchmarkMs[instancedRendering] += chrono::duration<double, milli>(chrono::steady_clock::now() - drawStart).count();
+            if (++benchmarkFrame == 2 * BENCHMARK_FRAMES)
+            {
+                double perDrawMs = benchmarkMs[0] / BENCHMARK_FRAMES;
+                double instancedMs = benchmarkMs[1] / BENCHMARK_FRAMES;
+                std::cout << "Cube field benchmark (" << cubeCount << " cubes): per-draw " << perDrawMs
+                          << " ms/frame (" << cubeCount << " draw calls), instanced " << instancedMs
+                          << " ms/frame (1 draw call), " << perDrawMs / instancedMs << "x" << std::endl;
+                benchmarkMs[0] = benchmarkMs[1] = 0.0;
+                benchmarkFrame = BENCHMARK_IDLE;
+                instancedRendering = instancedBeforeBenchmark;
+                showCubeField = fieldBeforeBenchmark;
+            }
         }
         glfwSwapBuffers(window);
         
         glfwPollEvents();
+        // closes the per-frame stats of every subsystem
+        FrameCounters::EndFrame();
     }
     // --------------------- Clean up --------------------- //
+    GLState::Instance().PrintStats();
 
     VAO1.Delete();
     VBO1.Delete();
+    instanceVBO.Delete();
     
     shaderProgram.Delete();
+    instancedShader.Delete();
     glfwDestroyWindow(window);
     glfwTerminate();
     
@@ -329,3 +406,57 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
     if (fov > 45.0f)
         fov = 45.0f;
 }
+
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+    if (action != GLFW_PRESS)
+        return;
+    if (key == GLFW_KEY_I && benchmarkFrame == BENCHMARK_IDLE)
+    {
+        instancedRendering = !instancedRendering;
+        std::cout << (instancedRendering ? "Instanced" : "Per-draw") << " cube rendering" << std::endl;
+    }
+    if (key == GLFW_KEY_F && benchmarkFrame == BENCHMARK_IDLE)
+    {
+        showCubeField = !showCubeField;
+        std::cout << (showCubeField ? CUBE_FIELD_COUNT : TUTORIAL_CUBE_COUNT) << " cubes" << std::endl;
+    }
+    if (key == GLFW_KEY_B && benchmarkFrame == BENCHMARK_IDLE)
+    {
+        instancedBeforeBenchmark = instancedRendering;
+        fieldBeforeBenchmark = showCubeField;
+        benchmarkFrame = 0;
+    }
+}
+
+// Keeps the tutorial's cubes and fills the rest of the field with a grid of cubes behind them
+vector<glm::vec3> buildCubeField(const glm::vec3* cubePositions, unsigned int cubeCount, unsigned int fieldCount)
+{
+    vector<glm::vec3> field(cubePositions, cubePositions + cubeCount);
+    unsigned int side = (unsigned int)std::ceil(std::cbrt((double)fieldCount));
+    const float spacing = 2.5f;
+    for (unsigned int i = 0; field.size() < fieldCount; i++)
+    {
+        float x = (float)(i % side) - side / 2.0f;
+        float y = (float)(i / side % side) - side / 2.0f;
+        float z = (float)(i / (side * side));
+        field.push_back(glm::vec3(x * spacing, y * spacing, -20.0f - z * spacing));
+    }
+    return field;
+}
+
+// The original per-cube transform: rotated by index, every third cube also spinning over time
+void buildCubeTransforms(vector<glm::mat4> &transforms, const vector<glm::vec3> &positions, float time, size_t count)
+{
+    for(unsigned int i = 0; i < count; i++)
+    {
+        glm::mat4 model = glm::mat4(1.0f);
+        model = glm::translate(model, positions[i]);
+        float angle = 20.0f * i;
+        model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
+        if(i % 3 == 0) {
+            model = glm::rotate(model, time * glm::radians(10.0f), glm::vec3(0.5f, 1.0f, 0.0f));
+        }
+        transforms[i] = model;
+    }
+}
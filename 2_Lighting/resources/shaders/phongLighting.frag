@@ -11,6 +11,7 @@ struct Material {
     float shininess;
 };
 
+// Member order keeps every float in the padding after a vec3 (std140), mirrored in LightBlocks.hpp
 struct DirLight {
     vec3 direction;
   
@@ -21,29 +22,26 @@ struct DirLight {
 
 struct PointLight {
     vec3 position;
-    
     float constant;
-    float linear;
-    float quadratic;
-
     vec3 ambient;
+    float linear;
     vec3 diffuse;
+    float quadratic;
     vec3 specular;
 };
 
 struct SpotLight {
     vec3 position;
-    vec3  direction;
     float cutOff;
+    vec3  direction;
     float outerCutOff;
     
-    float constant;
-    float linear;
-    float quadratic;
-    
     vec3 ambient;
+    float constant;
     vec3 diffuse;
+    float linear;
     vec3 specular;
+    float quadratic;
 };
 
 vec3 CalcDirLight(DirLight light, vec3 viewDir);
@@ -52,13 +50,21 @@ vec3 CalcSpotLight(SpotLight light, vec3 viewDir);
 
 
 #define NR_POINT_LIGHTS 4
-uniform DirLight dirLight;
-uniform PointLight pointLights[NR_POINT_LIGHTS];
-uniform SpotLight spotLight;
+layout (std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    float time;
+};
+
+layout (std140) uniform LightData {
+    DirLight dirLight;
+    PointLight pointLights[NR_POINT_LIGHTS];
+    SpotLight spotLight;
+};
 uniform Material material;
 
 uniform vec3 lightPos;
-uniform vec3 viewPos;
 
 void main() {
     // Fragment Properties
@@ -4,8 +4,14 @@ layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+// Shared with every shader on binding point FRAME_BLOCK_BINDING, see LightBlocks.hpp
+layout (std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    float time;
+};
 
 out vec3 FragPos;
 out vec3 Normal;
@@ -0,0 +1,31 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+
+// Per-instance model matrix, takes locations 3 to 6
+layout (location = 3) in mat4 aModel;
+
+// Shared with every shader on binding point FRAME_BLOCK_BINDING, see LightBlocks.hpp
+layout (std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    float time;
+};
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoords;
+
+void main()
+{
+    gl_Position = projection * view * aModel * vec4(aPos, 1.0);
+    FragPos = vec3(view * aModel * vec4(aPos, 1.0));
+    TexCoords = aTexCoords;
+
+    // Calculate the normal matrix so that non-uniform scaling doesn't mess up our normal
+    mat3 normalMatrix = mat3(transpose(inverse(view * aModel))); // Inversing matrices is expensive for shaders, typically do on CPU.
+    Normal = normalize(normalMatrix * aNormal);
+    
+}
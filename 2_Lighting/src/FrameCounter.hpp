@@ -0,0 +1,48 @@
+#ifndef FRAMECOUNTER_HPP
+#define FRAMECOUNTER_HPP
+
+// --------------------- Frame Counters --------------------- //
+/*
+    The per-frame half of a subsystem's statistics. Counts add up in
+    ThisFrame() while a frame runs; ending the frame moves them to
+    LastFrame() and starts the next one from zero. Totals and peaks that span
+    frames stay in the subsystem's own stats.
+
+    Every counter registers itself when it is constructed and leaves when it
+    is destroyed, so the render loop closes the frame of all of them with one
+    FrameCounters::EndFrame() instead of one call per subsystem.
+*/
+
+class FrameCounters {
+    public:
+        // Closes the frame of every live counter. Call once per frame, after the last draw.
+        static void EndFrame();
+
+    protected:
+        FrameCounters();
+        // a copy is a counter of its own, registered separately
+        FrameCounters(const FrameCounters &);
+        FrameCounters &operator=(const FrameCounters &) { return *this; }
+        virtual ~FrameCounters();
+
+        virtual void endFrame() = 0;
+};
+
+template <typename Counts>
+class FrameCounter : public FrameCounters {
+    public:
+        Counts &ThisFrame() { return thisFrame; }
+        const Counts &LastFrame() const { return lastFrame; }
+
+    private:
+        Counts thisFrame = Counts();
+        Counts lastFrame = Counts();
+
+        void endFrame() override
+        {
+            lastFrame = thisFrame;
+            thisFrame = Counts();
+        }
+};
+
+#endif /* FrameCounter_hpp */
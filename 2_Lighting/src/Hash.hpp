@@ -0,0 +1,41 @@
+#ifndef HASH_HPP
+#define HASH_HPP
+
+#include <stdint.h>
+#include <fstream>
+#include <string>
+
+// --------------------- Hashing --------------------- //
+// 64-bit FNV-1a, used to key the on-disk caches and to spot duplicate files.
+const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+const uint64_t FNV_PRIME        = 1099511628211ull;
+
+inline uint64_t fnv1a(const void *data, size_t size, uint64_t hash = FNV_OFFSET_BASIS)
+{
+    const unsigned char *bytes = (const unsigned char *)data;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+// Hashes the whole file at path. Returns false if it cannot be opened.
+inline bool hashFile(const std::string &path, uint64_t &hash)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        return false;
+
+    hash = FNV_OFFSET_BASIS;
+    char buffer[1 << 16];
+    while (in)
+    {
+        in.read(buffer, sizeof(buffer));
+        hash = fnv1a(buffer, (size_t)in.gcount(), hash);
+    }
+    return true;
+}
+
+#endif /* Hash_hpp */
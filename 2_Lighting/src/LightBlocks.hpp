@@ -0,0 +1,77 @@
+#ifndef LIGHT_BLOCKS_H
+#define LIGHT_BLOCKS_H
+
+#include <cstddef>
+#include <glm/glm.hpp>
+
+/*
+    C++ mirrors of the std140 uniform blocks declared in the shaders. Under std140 a vec3 starts
+    on a 16 byte boundary but only fills 12 bytes, so every vec3 is followed by a float (or padding)
+    to keep the C++ offsets identical to the GLSL ones. The static_asserts catch any drift.
+*/
+
+// Binding points shared by every shader that declares these blocks
+const unsigned int FRAME_BLOCK_BINDING = 0;
+const unsigned int LIGHT_BLOCK_BINDING = 1;
+
+const unsigned int NR_POINT_LIGHTS = 4;
+
+// layout (std140) uniform FrameData
+struct FrameData {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec3 viewPos;
+    float     time;
+};
+
+struct DirLight {
+    glm::vec3 direction;
+    float     _pad0;
+    glm::vec3 ambient;
+    float     _pad1;
+    glm::vec3 diffuse;
+    float     _pad2;
+    glm::vec3 specular;
+    float     _pad3;
+};
+
+struct PointLight {
+    glm::vec3 position;
+    float     constant;
+    glm::vec3 ambient;
+    float     linear;
+    glm::vec3 diffuse;
+    float     quadratic;
+    glm::vec3 specular;
+    float     _pad0;
+};
+
+struct SpotLight {
+    glm::vec3 position;
+    float     cutOff;
+    glm::vec3 direction;
+    float     outerCutOff;
+    glm::vec3 ambient;
+    float     constant;
+    glm::vec3 diffuse;
+    float     linear;
+    glm::vec3 specular;
+    float     quadratic;
+};
+
+// layout (std140) uniform LightData
+struct LightData {
+    DirLight   dirLight;
+    PointLight pointLights[NR_POINT_LIGHTS];
+    SpotLight  spotLight;
+};
+
+static_assert(sizeof(glm::vec3) == 12, "glm::vec3 must be tightly packed");
+static_assert(offsetof(FrameData, viewPos) == 128 && sizeof(FrameData) == 144, "FrameData does not match std140");
+static_assert(sizeof(DirLight) == 64, "DirLight does not match std140");
+static_assert(sizeof(PointLight) == 64, "PointLight does not match std140");
+static_assert(sizeof(SpotLight) == 80, "SpotLight does not match std140");
+static_assert(offsetof(LightData, pointLights) == 64 && offsetof(LightData, spotLight) == 320 &&
+              sizeof(LightData) == 400, "LightData does not match std140");
+
+#endif
@@ -0,0 +1,54 @@
+#include "UBO.hpp"
+#include "GLState.hpp"
+
+// Constructor that generates a Uniform Buffer Object of size bytes
+UBO::UBO(GLsizeiptr size)
+{
+    glGenBuffers(1, &ID);
+    GLState::Instance().BindBuffer(GL_UNIFORM_BUFFER, ID);
+    // rewritten every frame
+    glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+    GLState::Instance().BindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+// Rounds offset up to the alignment the driver requires between bound ranges
+GLintptr UBO::AlignOffset(GLintptr offset)
+{
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    if (alignment <= 0)
+        alignment = 256;
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+// Attaches size bytes starting at offset to a uniform block binding point
+void UBO::BindRange(GLuint bindingPoint, GLintptr offset, GLsizeiptr size)
+{
+    GLState::Instance().BindBufferRange(GL_UNIFORM_BUFFER, bindingPoint, ID, offset, size);
+}
+
+// Copies data into the buffer starting at offset
+void UBO::Update(const void* data, GLsizeiptr size, GLintptr offset)
+{
+    GLState::Instance().BindBuffer(GL_UNIFORM_BUFFER, ID);
+    glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+}
+
+// Binds the UBO
+void UBO::Bind()
+{
+    GLState::Instance().BindBuffer(GL_UNIFORM_BUFFER, ID);
+}
+
+// Unbinds the UBO
+void UBO::Unbind()
+{
+    GLState::Instance().BindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+// Deletes the UBO
+void UBO::Delete()
+{
+    glDeleteBuffers(1, &ID);
+    GLState::Instance().BufferDeleted(ID);
+}
@@ -0,0 +1,33 @@
+#ifndef UBO_CLASS_H
+#define UBO_CLASS_H
+
+#include <GL/glew.h>
+
+/*
+    UBO (UNIFORM BUFFER OBJECT) - holds uniform block data that several shader programs read from.
+    A block is tied to a binding point on both sides: the shader maps its block to the point
+    (Shader::BindUniformBlock) and the buffer range is attached to the same point here.
+*/
+class UBO
+{
+public:
+    // Reference ID of the Uniform Buffer Object
+    GLuint ID;
+    // Constructor that generates a Uniform Buffer Object of size bytes
+    UBO(GLsizeiptr size);
+
+    // Rounds offset up to the alignment the driver requires between bound ranges
+    static GLintptr AlignOffset(GLintptr offset);
+    // Attaches size bytes starting at offset to a uniform block binding point
+    void BindRange(GLuint bindingPoint, GLintptr offset, GLsizeiptr size);
+    // Copies data into the buffer starting at offset
+    void Update(const void* data, GLsizeiptr size, GLintptr offset = 0);
+    // Binds the UBO
+    void Bind();
+    // Unbinds the UBO
+    void Unbind();
+    // Deletes the UBO
+    void Delete();
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include "VAO.hpp"
+#include "GLState.hpp"
 
 // Constructor that generates a VAO ID
 VAO::VAO()
@@ -15,20 +16,36 @@ void VAO::LinkAttrib(VBO& VBO, GLuint layout, GLuint numComponents, GLenum type,
     VBO.Unbind();
 }
 
+// Links a VBO Attribute that advances once per instance instead of once per vertex
+void VAO::LinkInstanceAttrib(VBO& VBO, GLuint layout, GLuint numComponents, GLenum type, GLsizeiptr stride, void* offset)
+{
+    LinkAttrib(VBO, layout, numComponents, type, stride, offset);
+    glVertexAttribDivisor(layout, 1);
+}
+
+// Links a per-instance mat4 from a VBO of tightly packed matrices (uses layouts layout..layout + 3)
+void VAO::LinkInstanceMat4(VBO& VBO, GLuint layout)
+{
+    // A mat4 attribute takes four vec4 slots, one per column
+    for (GLuint column = 0; column < 4; column++)
+        LinkInstanceAttrib(VBO, layout + column, 4, GL_FLOAT, 16 * sizeof(float), (void*)(column * 4 * sizeof(float)));
+}
+
 // Binds the VAO
 void VAO::Bind()
 {
-    glBindVertexArray(ID);
+    GLState::Instance().BindVertexArray(ID);
 }
 
 // Unbinds the VAO
 void VAO::Unbind()
 {
-    glBindVertexArray(0);
+    GLState::Instance().BindVertexArray(0);
 }
 
 // Deletes the VAO
 void VAO::Delete()
 {
     glDeleteVertexArrays(1, &ID);
+    GLState::Instance().VertexArrayDeleted(ID);
 }
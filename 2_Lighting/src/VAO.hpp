@@ -14,6 +14,10 @@ public:
 
     // Links a VBO Attribute such as a position or color to the VAO
     void LinkAttrib(VBO& VBO, GLuint layout, GLuint numComponents, GLenum type, GLsizeiptr stride, void* offset);    // Binds the VAO
+    // Links a VBO Attribute that advances once per instance instead of once per vertex
+    void LinkInstanceAttrib(VBO& VBO, GLuint layout, GLuint numComponents, GLenum type, GLsizeiptr stride, void* offset);
+    // Links a per-instance mat4 from a VBO of tightly packed matrices (uses layouts layout..layout + 3)
+    void LinkInstanceMat4(VBO& VBO, GLuint layout);
     // Bind VAO
     void Bind();
     // Unbinds the VAO
@@ -10,6 +10,11 @@ public:
     GLuint ID;
     // Constructor that generates a Vertex Buffer Object and links it to vertices
     VBO(GLfloat* vertices, GLsizeiptr size);
+    // Constructor that generates an empty Vertex Buffer Object of size bytes, meant to be rewritten with Update
+    VBO(GLsizeiptr size);
+
+    // Replaces the contents of the VBO with size bytes of data
+    void Update(const void* data, GLsizeiptr size);
 
     // Binds the VBO
     void Bind();
@@ -1,4 +1,7 @@
 #include <iostream>
+#include <chrono>
+#include <cmath>
+#include <vector>
 
 // GLEW
 #define GLEW_STATIC
@@ -15,8 +18,11 @@
 #include "EBO.hpp"
 #include "VAO.hpp"
 #include "VBO.hpp"
+#include "UBO.hpp"
 #include "Shader.hpp"
+#include "GLState.hpp"
 #include "Camera.hpp"
+#include "LightBlocks.hpp"
 
 // GLM
 #include <glm/glm.hpp>
@@ -28,6 +34,8 @@ using namespace std;
 void processInput(GLFWwindow *window);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
+vector<glm::mat4> buildCubeField(const glm::vec3* cubePositions, unsigned int cubeCount, unsigned int fieldCount);
 
 const GLint WIDTH = 800, HEIGHT = 800;
 
@@ -40,6 +48,25 @@ float lastX = WIDTH / 2.0f;
 float lastY = HEIGHT / 2.0f;
 bool firstMouse = true;
 
+// --------------------- Cube Field --------------------- //
+/*
+    The scene is the ten tutorial cubes. F extends them into a field of CUBE_FIELD_COUNT cubes.
+    The model matrices of the whole field, tutorial cubes first, sit in a static instance buffer,
+    so the instanced path lights the cubes on screen with one glDrawArraysInstanced call. The per-draw path is
+    the original setMat4 + glDrawArrays loop. I toggles between the two, B runs a benchmark of
+    both on the field.
+*/
+const unsigned int TUTORIAL_CUBE_COUNT = 10;
+const unsigned int CUBE_FIELD_COUNT = 100000;
+const unsigned int BENCHMARK_FRAMES = 120;
+bool instancedRendering = true;
+bool showCubeField = false;
+// Frame of the running benchmark, BENCHMARK_IDLE when none is running
+const unsigned int BENCHMARK_IDLE = ~0u;
+unsigned int benchmarkFrame = BENCHMARK_IDLE;
+bool instancedBeforeBenchmark = true;
+bool fieldBeforeBenchmark = false;
+
 
 int main() {
     // --------------------- Initialization --------------------- //
@@ -69,6 +96,7 @@ int main() {
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
+    glfwSetKeyCallback(window, key_callback);
     
     lastX = WIDTH;
     lastY = HEIGHT;
@@ -91,6 +119,14 @@ int main() {
     // Shader Compilation
     Shader lightingShader("phongLighting.vert", "phongLighting.frag");
     Shader lightCubeShader("lightSource.vert", "lightSource.frag");
+    Shader lightingInstancedShader("phongLightingInstanced.vert", "phongLighting.frag");
+
+    // Both programs read view/projection from the same FrameData block, only the lit one needs LightData
+    lightingShader.BindUniformBlock("FrameData", FRAME_BLOCK_BINDING);
+    lightingShader.BindUniformBlock("LightData", LIGHT_BLOCK_BINDING);
+    lightCubeShader.BindUniformBlock("FrameData", FRAME_BLOCK_BINDING);
+    lightingInstancedShader.BindUniformBlock("FrameData", FRAME_BLOCK_BINDING);
+    lightingInstancedShader.BindUniformBlock("LightData", LIGHT_BLOCK_BINDING);
 
     float vertices[] = {
         // positions          // normals           // texture coords
@@ -181,6 +217,11 @@ int main() {
     VAO1.LinkAttrib(VBO1, 0, 3, GL_FLOAT, strideLength * sizeof(float), (void*)0);
     VAO1.LinkAttrib(VBO1, 1, 3, GL_FLOAT, strideLength * sizeof(float), (void*)(3 * sizeof(float)));
     VAO1.LinkAttrib(VBO1, 2, 2, GL_FLOAT, strideLength * sizeof(float), (void*)(6 * sizeof(float)));
+
+    // Instance buffer with one model matrix per cube. The cubes never move, so it is filled once.
+    vector<glm::mat4> cubeTransforms = buildCubeField(cubePositions, TUTORIAL_CUBE_COUNT, CUBE_FIELD_COUNT);
+    VBO instanceVBO((GLfloat*)glm::value_ptr(cubeTransforms[0]), cubeTransforms.size() * sizeof(glm::mat4));
+    VAO1.LinkInstanceMat4(instanceVBO, 3);
     
     // Unbind all to prevent accidentally modifying them
     VAO1.Unbind();
@@ -191,6 +232,63 @@ int main() {
     VAO_Light.Unbind();
     
     
+    // --------------------- Uniform Buffers --------------------- //
+    /*
+       Camera and light uniforms live in one buffer holding both std140 blocks (see LightBlocks.hpp).
+       Each block gets its own range, and the whole buffer is rewritten with a single upload per frame
+       instead of ~40 glUniform calls on each program.
+    */
+    const GLintptr lightDataOffset = UBO::AlignOffset(sizeof(FrameData));
+    const GLsizeiptr uniformBufferSize = lightDataOffset + sizeof(LightData);
+    vector<unsigned char> uniformStaging(uniformBufferSize);
+    FrameData &frameData = *reinterpret_cast<FrameData*>(&uniformStaging[0]);
+    LightData &lightData = *reinterpret_cast<LightData*>(&uniformStaging[lightDataOffset]);
+
+    UBO UBO1(uniformBufferSize);
+    UBO1.BindRange(FRAME_BLOCK_BINDING, 0, sizeof(FrameData));
+    UBO1.BindRange(LIGHT_BLOCK_BINDING, lightDataOffset, sizeof(LightData));
+
+    // directional light
+    lightData.dirLight.direction = glm::vec3(-0.2f, -1.0f, -0.3f);
+    lightData.dirLight.ambient   = glm::vec3(0.05f, 0.05f, 0.05f);
+    lightData.dirLight.diffuse   = glm::vec3(0.4f, 0.4f, 0.4f);
+    lightData.dirLight.specular  = glm::vec3(0.5f, 0.5f, 0.5f);
+    // point lights
+    for (unsigned int i = 0; i < NR_POINT_LIGHTS; i++)
+    {
+        PointLight &pointLight = lightData.pointLights[i];
+        pointLight.position  = pointLightPositions[i];
+        pointLight.ambient   = glm::vec3(0.05f, 0.05f, 0.05f);
+        pointLight.diffuse   = glm::vec3(0.8f, 0.8f, 0.8f);
+        pointLight.specular  = glm::vec3(1.0f, 1.0f, 1.0f);
+        pointLight.constant  = 1.0f;
+        pointLight.linear    = 0.09f;
+        pointLight.quadratic = 0.032f;
+    }
+    // spotLight (its direction follows the camera every frame)
+    lightData.spotLight.position    = glm::vec3(0, 0, 0);
+    lightData.spotLight.ambient     = glm::vec3(0.0f, 0.0f, 0.0f);
+    lightData.spotLight.diffuse     = glm::vec3(0.604f, 0.988f, 0.49f);
+    lightData.spotLight.specular    = glm::vec3(0.604f, 0.988f, 0.49f);
+    lightData.spotLight.constant    = 1.0f;
+    lightData.spotLight.linear      = 0.09f;
+    lightData.spotLight.quadratic   = 0.032f;
+    lightData.spotLight.cutOff      = glm::cos(glm::radians(12.5f));
+    lightData.spotLight.outerCutOff = glm::cos(glm::radians(15.0f));
+
+    // Material uniforms never change, so they are set once
+    lightingShader.Activate();
+    lightingShader.setInt("material.diffuse", 0); // Bind diffuse and specular to texture locations
+    lightingShader.setInt("material.specular", 1);
+    lightingShader.setFloat("material.shininess", 32.0f);
+    lightingInstancedShader.Activate();
+    lightingInstancedShader.setInt("material.diffuse", 0);
+    lightingInstancedShader.setInt("material.specular", 1);
+    lightingInstancedShader.setFloat("material.shininess", 32.0f);
+    UniformHandle lightingModel = lightingShader.GetUniform("model");
+    UniformHandle lightCubeModel = lightCubeShader.GetUniform("model");
+    double benchmarkMs[2] = { 0.0, 0.0 };
+
     // --------------------- Textures --------------------- //
     unsigned int diffuseMap;
     glGenTextures(1, &diffuseMap);
@@ -225,6 +323,9 @@ int main() {
     }
     stbi_image_free(data);
     
+    // Textures were bound directly while loading, start the loop with a clean shadow
+    GLState::Instance().Invalidate();
+
     // --------------------- Render Loop --------------------- //
     while(!glfwWindowShouldClose(window))
     {
@@ -241,110 +342,80 @@ int main() {
         
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         
+        // The benchmark renders BENCHMARK_FRAMES frames of the field per-draw, then as many instanced
+        if (benchmarkFrame != BENCHMARK_IDLE)
+        {
+            instancedRendering = benchmarkFrame >= BENCHMARK_FRAMES;
+            showCubeField = true;
+        }
+        size_t cubeCount = showCubeField ? cubeTransforms.size() : TUTORIAL_CUBE_COUNT;
+        auto drawStart = chrono::steady_clock::now();
+        
         // --------------------- Cameras --------------------- //
         glm::mat4 view = camera.GetViewMatrix();
         glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)screenWidth / (float)screenHeight, 0.1f, 100.0f);
         
-        lightingShader.Activate();
+        frameData.view = view;
+        frameData.projection = projection;
+        frameData.viewPos = camera.Position;
+        frameData.time = currentFrame;
+        lightData.spotLight.direction = camera.Front;
+        // One upload feeds both blocks of both shaders
+        UBO1.Update(&uniformStaging[0], uniformBufferSize);
         
-        // Vertex Shader Uniforms
-        lightingShader.setMat4("view", view);
-        lightingShader.setMat4("projection", projection);
-        
-        // Fragment Shader Uniforms
-        lightingShader.setInt("material.diffuse", 0); // Bind diffuse and specular to texture locations
-        lightingShader.setInt("material.specular", 1);
-        lightingShader.setFloat("material.shininess", 32.0f);
-        
-        lightingShader.setVec3("viewPos", camera.Position);
-        /*
-           Here we set all the uniforms for the 5/6 types of lights we have. We have to set them manually and index
-           the proper PointLight struct in the array to set each uniform variable. This can be done more code-friendly
-           by defining light types as classes and set their values in there, or by using a more efficient uniform approach
-           by using 'Uniform buffer objects', but that is something we'll discuss in the 'Advanced GLSL' tutorial.
-        */
-        
-        // directional light
-        lightingShader.setVec3("dirLight.direction", -0.2f, -1.0f, -0.3f);
-        lightingShader.setVec3("dirLight.ambient", 0.05f, 0.05f, 0.05f);
-        lightingShader.setVec3("dirLight.diffuse", 0.4f, 0.4f, 0.4f);
-        lightingShader.setVec3("dirLight.specular", 0.5f, 0.5f, 0.5f);
-        // point light 1
-        lightingShader.setVec3("pointLights[0].position", pointLightPositions[0]);
-        lightingShader.setVec3("pointLights[0].ambient", 0.05f, 0.05f, 0.05f);
-        lightingShader.setVec3("pointLights[0].diffuse", 0.8f, 0.8f, 0.8f);
-        lightingShader.setVec3("pointLights[0].specular", 1.0f, 1.0f, 1.0f);
-        lightingShader.setFloat("pointLights[0].constant", 1.0f);
-        lightingShader.setFloat("pointLights[0].linear", 0.09f);
-        lightingShader.setFloat("pointLights[0].quadratic", 0.032f);
-        // point light 2
-        lightingShader.setVec3("pointLights[1].position", pointLightPositions[1]);
-        lightingShader.setVec3("pointLights[1].ambient", 0.05f, 0.05f, 0.05f);
-        lightingShader.setVec3("pointLights[1].diffuse", 0.8f, 0.8f, 0.8f);
-        lightingShader.setVec3("pointLights[1].specular", 1.0f, 1.0f, 1.0f);
-        lightingShader.setFloat("pointLights[1].constant", 1.0f);
-        lightingShader.setFloat("pointLights[1].linear", 0.09f);
-        lightingShader.setFloat("pointLights[1].quadratic", 0.032f);
-        // point light 3
-        lightingShader.setVec3("pointLights[2].position", pointLightPositions[2]);
-        lightingShader.setVec3("pointLights[2].ambient", 0.05f, 0.05f, 0.05f);
-        lightingShader.setVec3("pointLights[2].diffuse", 0.8f, 0.8f, 0.8f);
-        lightingShader.setVec3("pointLights[2].specular", 1.0f, 1.0f, 1.0f);
-        lightingShader.setFloat("pointLights[2].constant", 1.0f);
-        lightingShader.setFloat("pointLights[2].linear", 0.09f);
-        lightingShader.setFloat("pointLights[2].quadratic", 0.032f);
-        // point light 4
-        lightingShader.setVec3("pointLights[3].position", pointLightPositions[3]);
-        lightingShader.setVec3("pointLights[3].ambient", 0.05f, 0.05f, 0.05f);
-        lightingShader.setVec3("pointLights[3].diffuse", 0.8f, 0.8f, 0.8f);
-        lightingShader.setVec3("pointLights[3].specular", 1.0f, 1.0f, 1.0f);
-        lightingShader.setFloat("pointLights[3].constant", 1.0f);
-        lightingShader.setFloat("pointLights[3].linear", 0.09f);
-        lightingShader.setFloat("pointLights[3].quadratic", 0.032f);
-        // spotLight
-        lightingShader.setVec3("spotLight.position", glm::vec3(0, 0, 0));
-        lightingShader.setVec3("spotLight.direction", camera.Front);
-        lightingShader.setVec3("spotLight.ambient", 0.0f, 0.0f, 0.0f);
-        lightingShader.setVec3("spotLight.diffuse", 0.604f, 0.988f, 0.49f);
-        lightingShader.setVec3("spotLight.specular", 0.604f, 0.988f, 0.49f);
-        lightingShader.setFloat("spotLight.constant", 1.0f);
-        lightingShader.setFloat("spotLight.linear", 0.09f);
-        lightingShader.setFloat("spotLight.quadratic", 0.032f);
-        lightingShader.setFloat("spotLight.cutOff", glm::cos(glm::radians(12.5f)));
-        lightingShader.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(15.0f)));
+        Shader &cubeShader = instancedRendering ? lightingInstancedShader : lightingShader;
+        cubeShader.Activate();
         
         // Activate and bind our respective textures
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, diffuseMap);
+        GLState::Instance().BindTextureUnit(0, GL_TEXTURE_2D, diffuseMap);
         
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, specularMap);
+        GLState::Instance().BindTextureUnit(1, GL_TEXTURE_2D, specularMap);
         
         // Draw the triangle using the GL_TRIANGLES primitive
         VAO1.Bind();
         
-        for(unsigned int i = 0; i < 10; i++)
+        if (instancedRendering)
         {
-            glm::mat4 model = glm::mat4(1.0f);
-            model = glm::translate(model, cubePositions[i]);
-            float angle = 20.0f * i;
-            model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
-            lightingShader.setMat4("model", model);
+            // Every cube in one draw call
+            glDrawArraysInstanced(GL_TRIANGLES, 0, 36, (GLsizei)cubeCount);
+        }
+        else
+        {
+            for(unsigned int i = 0; i < cubeCount; i++)
+            {
+                lightingShader.setMat4(lightingModel, cubeTransforms[i]);
 
-            glDrawArrays(GL_TRIANGLES, 0, 36);
+                glDrawArrays(GL_TRIANGLES, 0, 36);
+            }
+        }
+
+        if (benchmarkFrame != BENCHMARK_IDLE)
+        {
+            // Wait for the GPU so the frame time covers the whole draw, not just its submission
+            glFinish();
+            benchmarkMs[instancedRendering] += chrono::duration<double, milli>(chrono::steady_clock::now() - drawStart).count();
+            if (++benchmarkFrame == 2 * BENCHMARK_FRAMES)
+            {
+                double perDrawMs = benchmarkMs[0] / BENCHMARK_FRAMES;
+                double instancedMs = benchmarkMs[1] / BENCHMARK_FRAMES;
+                std::cout << "Cube field benchmark (" << cubeCount << " cubes): per-draw " << perDrawMs
+                          << " ms/frame (" << cubeCount << " draw calls), instanced " << instancedMs
+                          << " ms/frame (1 draw call), " << perDrawMs / instancedMs << "x" << std::endl;
+                benchmarkMs[0] = benchmarkMs[1] = 0.0;
+                benchmarkFrame = BENCHMARK_IDLE;
+                instancedRendering = instancedBeforeBenchmark;
+                showCubeField = fieldBeforeBenchmark;
+            }
         }
         
         lightCubeShader.Activate();
-        // Vertex Shader Uniforms
-        lightCubeShader.setMat4("view", view);
-        lightCubeShader.setMat4("projection", projection);
         
         for (unsigned int i = 0; i < 4; i++)
         {
             glm::mat4 model = glm::mat4(1.0f);
             model = glm::translate(model, pointLightPositions[i]);
             model = glm::scale(model, glm::vec3(0.2f)); // Make it a smaller cube
-            lightCubeShader.setMat4("model", model);
+            lightCubeShader.setMat4(lightCubeModel, model);
             glDrawArrays(GL_TRIANGLES, 0, 36);
         }
         VAO_Light.Bind();
@@ -354,14 +425,21 @@ int main() {
         glfwSwapBuffers(window);
         
         glfwPollEvents();
+        // closes the per-frame stats of every subsystem
+        FrameCounters::EndFrame();
     }
     // --------------------- Clean up --------------------- //
+    Shader::PrintUniformStats();
+    GLState::Instance().PrintStats();
 
     VAO1.Delete();
     VBO1.Delete();
+    instanceVBO.Delete();
+    UBO1.Delete();
     
     lightingShader.Delete();
     lightCubeShader.Delete();
+    lightingInstancedShader.Delete();
     glfwDestroyWindow(window);
     glfwTerminate();
     
@@ -407,3 +485,51 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
     camera.ProcessMouseScroll(static_cast<float>(yoffset));
 }
+
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+    if (action != GLFW_PRESS)
+        return;
+    if (key == GLFW_KEY_I && benchmarkFrame == BENCHMARK_IDLE)
+    {
+        instancedRendering = !instancedRendering;
+        std::cout << (instancedRendering ? "Instanced" : "Per-draw") << " cube rendering" << std::endl;
+    }
+    if (key == GLFW_KEY_F && benchmarkFrame == BENCHMARK_IDLE)
+    {
+        showCubeField = !showCubeField;
+        std::cout << (showCubeField ? CUBE_FIELD_COUNT : TUTORIAL_CUBE_COUNT) << " cubes" << std::endl;
+    }
+    if (key == GLFW_KEY_B && benchmarkFrame == BENCHMARK_IDLE)
+    {
+        instancedBeforeBenchmark = instancedRendering;
+        fieldBeforeBenchmark = showCubeField;
+        benchmarkFrame = 0;
+    }
+}
+
+// Keeps the tutorial's cubes and fills the rest of the field with a grid of cubes behind them
+vector<glm::mat4> buildCubeField(const glm::vec3* cubePositions, unsigned int cubeCount, unsigned int fieldCount)
+{
+    vector<glm::vec3> positions(cubePositions, cubePositions + cubeCount);
+    unsigned int side = (unsigned int)std::ceil(std::cbrt((double)fieldCount));
+    const float spacing = 2.5f;
+    for (unsigned int i = 0; positions.size() < fieldCount; i++)
+    {
+        float x = (float)(i % side) - side / 2.0f;
+        float y = (float)(i / side % side) - side / 2.0f;
+        float z = (float)(i / (side * side));
+        positions.push_back(glm::vec3(x * spacing, y * spacing, -20.0f - z * spacing));
+    }
+
+    vector<glm::mat4> transforms(positions.size());
+    for(unsigned int i = 0; i < positions.size(); i++)
+    {
+        glm::mat4 model = glm::mat4(1.0f);
+        model = glm::translate(model, positions[i]);
+        float angle = 20.0f * i;
+        model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
+        transforms[i] = model;
+    }
+    return transforms;
+}
@@ -0,0 +1,12 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+flat in uint Layer;
+
+uniform sampler2DArray texture_diffuse1;
+
+void main()
+{
+    FragColor = texture(texture_diffuse1, vec3(TexCoords, float(Layer)));
+}
@@ -0,0 +1,21 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+// Layer of the mesh's material in the texture arrays (RenderQueue::LAYER_ATTRIBUTE): per draw
+// from the render queue's layer buffer, or a constant value set before the draw
+layout (location = 3) in uint aLayer;
+
+out vec2 TexCoords;
+flat out uint Layer;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    TexCoords = aTexCoords;
+    Layer = aLayer;
+    gl_Position = projection * view * model * vec4(aPos, 1.0);
+}
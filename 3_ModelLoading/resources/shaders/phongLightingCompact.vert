@@ -0,0 +1,18 @@
+#version 330 core
+// CompactVertex input: positions are unorm16 inside the mesh's box (the model matrix
+// carries the box), normals octahedral snorm16, texture coordinates half floats
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+
+out vec2 TexCoords;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    TexCoords = aTexCoords;
+    gl_Position = projection * view * model * vec4(aPos, 1.0);
+}
@@ -0,0 +1,281 @@
+#include "BVH.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+static const int SAH_BINS = 12;
+static const unsigned int ALL_PLANES = (1u << Frustum::PLANE_COUNT) - 1;
+
+enum Containment { OUTSIDE, INTERSECTING, INSIDE };
+
+// Tests bounds against the planes still set in planeMask and clears the ones it lies fully inside
+static Containment classify(const Frustum &frustum, const Bounds &bounds, unsigned int &planeMask,
+                            unsigned long &planeTests)
+{
+    glm::vec3 extents = bounds.Extents();
+    for (int p = 0; p < Frustum::PLANE_COUNT; p++)
+    {
+        if (!(planeMask & (1u << p)))
+            continue;
+        planeTests++;
+        const glm::vec4 &plane = frustum.planes[p];
+        float distance = plane.x * bounds.center.x + plane.y * bounds.center.y + plane.z * bounds.center.z + plane.w;
+        float boxRadius = std::fabs(plane.x) * extents.x + std::fabs(plane.y) * extents.y +
+                          std::fabs(plane.z) * extents.z;
+        // the geometry is inside both the box and the sphere, so the tighter of the two decides
+        float reach = std::min(bounds.radius, boxRadius);
+        if (distance < -reach)
+            return OUTSIDE;
+        if (distance >= reach)
+            planeMask &= ~(1u << p);
+    }
+    return planeMask ? INTERSECTING : INSIDE;
+}
+
+static float surfaceArea(const glm::vec3 &min, const glm::vec3 &max)
+{
+    glm::vec3 size = max - min;
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+void BVH::Build(const vector<Bounds> &items)
+{
+    auto start = chrono::steady_clock::now();
+    Clear();
+    this->items = items;
+    if (items.empty())
+        return;
+
+    order.resize(items.size());
+    for (uint32_t i = 0; i < order.size(); i++)
+        order[i] = i;
+    nodes.reserve(2 * items.size());
+    nodes.resize(1);
+    buildNode(0, 0, (uint32_t)items.size());
+    buildMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+void BVH::Clear()
+{
+    nodes.clear();
+    order.clear();
+    items.clear();
+    buildMs = 0.0;
+}
+
+void BVH::Refit(const vector<Bounds> &items)
+{
+    if (items.size() != this->items.size())
+    {
+        Build(items);
+        return;
+    }
+    this->items = items;
+    // children are always stored after their parent
+    for (size_t index = nodes.size(); index-- > 0;)
+    {
+        BVHNode &node = nodes[index];
+        if (node.left == 0)
+            node.bounds = enclose(node.first, node.count);
+        else
+            node.bounds = Bounds::Merge(nodes[node.left].bounds, nodes[node.left + 1].bounds);
+    }
+}
+
+Bounds BVH::enclose(uint32_t first, uint32_t count) const
+{
+    Bounds bounds;
+    bounds.min = items[order[first]].min;
+    bounds.max = items[order[first]].max;
+    for (uint32_t i = first + 1; i < first + count; i++)
+    {
+        bounds.min = glm::min(bounds.min, items[order[i]].min);
+        bounds.max = glm::max(bounds.max, items[order[i]].max);
+    }
+    bounds.center = (bounds.min + bounds.max) * 0.5f;
+    bounds.radius = 0.0f;
+    for (uint32_t i = first; i < first + count; i++)
+    {
+        const Bounds &item = items[order[i]];
+        bounds.radius = max(bounds.radius, glm::length(item.center - bounds.center) + item.radius);
+    }
+    bounds.radius = min(bounds.radius, glm::length(bounds.Extents()));
+    return bounds;
+}
+
+void BVH::buildNode(uint32_t index, uint32_t first, uint32_t count)
+{
+    Bounds bounds = enclose(first, count);
+    nodes[index].bounds = bounds;
+    nodes[index].first = first;
+    nodes[index].count = count;
+    if (count <= LEAF_SIZE)
+        return;
+
+    uint32_t leftCount = split(first, count);
+    uint32_t left = (uint32_t)nodes.size();
+    nodes.resize(nodes.size() + 2);
+    nodes[index].left = left;
+    buildNode(left, first, leftCount);
+    buildNode(left + 1, first + leftCount, count - leftCount);
+}
+
+// Binned SAH on the longest axis of the item centers, median split when the bins can't separate them
+uint32_t BVH::split(uint32_t first, uint32_t count)
+{
+    glm::vec3 centerMin = items[order[first]].center;
+    glm::vec3 centerMax = centerMin;
+    for (uint32_t i = first + 1; i < first + count; i++)
+    {
+        centerMin = glm::min(centerMin, items[order[i]].center);
+        centerMax = glm::max(centerMax, items[order[i]].center);
+    }
+    glm::vec3 spread = centerMax - centerMin;
+    int axis = 0;
+    if (spread.y > spread[axis])
+        axis = 1;
+    if (spread.z > spread[axis])
+        axis = 2;
+
+    uint32_t *begin = order.data() + first;
+    uint32_t *end = begin + count;
+    if (spread[axis] > 0.0f)
+    {
+        float scale = SAH_BINS / spread[axis];
+        float origin = centerMin[axis];
+        auto binOf = [&](uint32_t item) {
+            return min(SAH_BINS - 1, (int)((items[item].center[axis] - origin) * scale));
+        };
+
+        uint32_t binCount[SAH_BINS] = { 0 };
+        glm::vec3 binMin[SAH_BINS], binMax[SAH_BINS];
+        for (uint32_t *it = begin; it != end; ++it)
+        {
+            int bin = binOf(*it);
+            const Bounds &item = items[*it];
+            binMin[bin] = binCount[bin] ? glm::min(binMin[bin], item.min) : item.min;
+            binMax[bin] = binCount[bin] ? glm::max(binMax[bin], item.max) : item.max;
+            binCount[bin]++;
+        }
+
+        // area * count of everything right of each split plane, swept from the right
+        float rightCost[SAH_BINS] = { 0.0f };
+        glm::vec3 sweepMin, sweepMax;
+        uint32_t sweepCount = 0;
+        for (int bin = SAH_BINS - 1; bin > 0; bin--)
+        {
+            if (binCount[bin])
+            {
+                sweepMin = sweepCount ? glm::min(sweepMin, binMin[bin]) : binMin[bin];
+                sweepMax = sweepCount ? glm::max(sweepMax, binMax[bin]) : binMax[bin];
+                sweepCount += binCount[bin];
+            }
+            rightCost[bin] = sweepCount ? sweepCount * surfaceArea(sweepMin, sweepMax) : 0.0f;
+        }
+
+        int bestSplit = -1;
+        float bestCost = 0.0f;
+        sweepCount = 0;
+        for (int bin = 0; bin < SAH_BINS - 1; bin++)
+        {
+            if (binCount[bin])
+            {
+                sweepMin = sweepCount ? glm::min(sweepMin, binMin[bin]) : binMin[bin];
+                sweepMax = sweepCount ? glm::max(sweepMax, binMax[bin]) : binMax[bin];
+                sweepCount += binCount[bin];
+            }
+            if (sweepCount == 0 || sweepCount == count)
+                continue;
+            float cost = sweepCount * surfaceArea(sweepMin, sweepMax) + rightCost[bin + 1];
+            if (bestSplit < 0 || cost < bestCost)
+            {
+                bestSplit = bin + 1;
+                bestCost = cost;
+            }
+        }
+
+        if (bestSplit > 0)
+        {
+            uint32_t *middle = std::partition(begin, end, [&](uint32_t item) { return binOf(item) < bestSplit; });
+            return (uint32_t)(middle - begin);
+        }
+    }
+
+    uint32_t half = count / 2;
+    std::nth_element(begin, begin + half, end, [&](uint32_t a, uint32_t b) {
+        return items[a].center[axis] < items[b].center[axis];
+    });
+    return half;
+}
+
+size_t BVH::Cull(const Frustum &frustum, vector<uint8_t> &visible)
+{
+    auto start = chrono::steady_clock::now();
+    traversal = BVHTraversal();
+    visible.assign(items.size(), 0);
+    if (nodes.empty())
+        return 0;
+
+    size_t visibleCount = 0;
+    struct Pending {
+        uint32_t node;
+        unsigned int planeMask;
+    };
+    Pending stack[64];
+    vector<Pending> overflow;  // only used by degenerate trees deeper than the fixed stack
+    int top = 0;
+    stack[top++] = { 0, ALL_PLANES };
+
+    while (top > 0 || !overflow.empty())
+    {
+        Pending pending;
+        if (!overflow.empty())
+        {
+            pending = overflow.back();
+            overflow.pop_back();
+        }
+        else
+            pending = stack[--top];
+
+        const BVHNode &node = nodes[pending.node];
+        traversal.nodesVisited++;
+        unsigned int planeMask = pending.planeMask;
+        Containment containment = classify(frustum, node.bounds, planeMask, traversal.planeTests);
+        if (containment == OUTSIDE)
+            continue;
+
+        if (containment == INSIDE)
+        {
+            for (uint32_t i = node.first; i < node.first + node.count; i++)
+                visible[order[i]] = 1;
+            visibleCount += node.count;
+        }
+        else if (node.left == 0)
+        {
+            for (uint32_t i = node.first; i < node.first + node.count; i++)
+            {
+                unsigned int itemMask = planeMask;
+                if (classify(frustum, items[order[i]], itemMask, traversal.planeTests) != OUTSIDE)
+                {
+                    visible[order[i]] = 1;
+                    visibleCount++;
+                }
+            }
+        }
+        else
+        {
+            for (uint32_t child = node.left; child < node.left + 2; child++)
+            {
+                if (top < 64)
+                    stack[top++] = { child, planeMask };
+                else
+                    overflow.push_back({ child, planeMask });
+            }
+        }
+    }
+
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    FrustumCuller::Record(visibleCount, items.size() - visibleCount, ms);
+    return visibleCount;
+}
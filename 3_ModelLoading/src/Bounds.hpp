@@ -0,0 +1,57 @@
+#ifndef BOUNDS_HPP
+#define BOUNDS_HPP
+
+#include <glm/glm.hpp>
+
+// --------------------- Bounding Volumes --------------------- //
+/*
+    Axis aligned box and bounding sphere of a mesh (in the mesh's own space
+    unless transformed) or of a group of them. Both share the box's center:
+    for a mesh the sphere radius is the distance to the farthest vertex from
+    it, which is never larger than half the box diagonal.
+*/
+struct Bounds {
+    glm::vec3 min = glm::vec3(0.0f);
+    glm::vec3 max = glm::vec3(0.0f);
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 0.0f;
+
+    // Half size of the box along each axis
+    glm::vec3 Extents() const { return (max - min) * 0.5f; }
+
+    // Bounds of the same geometry after model is applied. The box is re-fitted around
+    // the transformed box (Arvo), the sphere grows with the largest axis scale.
+    Bounds Transformed(const glm::mat4 &model) const
+    {
+        glm::vec3 extents = Extents();
+        glm::vec3 newExtents(0.0f);
+        float maxScale = 0.0f;
+        for (int column = 0; column < 3; column++)
+        {
+            glm::vec3 axis(model[column]);
+            newExtents += glm::abs(axis) * extents[column];
+            maxScale = glm::max(maxScale, glm::length(axis));
+        }
+        Bounds bounds;
+        bounds.center = glm::vec3(model * glm::vec4(center, 1.0f));
+        bounds.min = bounds.center - newExtents;
+        bounds.max = bounds.center + newExtents;
+        bounds.radius = glm::min(radius * maxScale, glm::length(newExtents));
+        return bounds;
+    }
+
+    // Smallest box holding both, and a sphere around its center holding both spheres
+    static Bounds Merge(const Bounds &a, const Bounds &b)
+    {
+        Bounds bounds;
+        bounds.min = glm::min(a.min, b.min);
+        bounds.max = glm::max(a.max, b.max);
+        bounds.center = (bounds.min + bounds.max) * 0.5f;
+        bounds.radius = glm::max(glm::length(a.center - bounds.center) + a.radius,
+                                 glm::length(b.center - bounds.center) + b.radius);
+        bounds.radius = glm::min(bounds.radius, glm::length(bounds.Extents()));
+        return bounds;
+    }
+};
+
+#endif /* Bounds_hpp */
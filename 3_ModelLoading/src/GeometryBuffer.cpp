@@ -0,0 +1,180 @@
+#include "GeometryBuffer.hpp"
+#include "GLState.hpp"
+
+#include <algorithm>
+
+// Smallest buffer allocated, so small meshes do not regrow it on every add
+const size_t MIN_VERTEX_CAPACITY = 4096;
+const size_t MIN_INDEX_CAPACITY = 16384;
+
+// Index ranges are sized in multiples of 4 bytes, so every one starts 4-byte aligned
+static size_t alignIndexOffset(size_t offset)
+{
+    return (offset + 3) & ~(size_t)3;
+}
+
+void GeometryBuffer::attachBuffers()
+{
+    GLState &state = GLState::Instance();
+    state.BindVertexArray(VAO);
+    state.BindBuffer(GL_ARRAY_BUFFER, VBO);
+    state.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    Mesh::SetVertexAttributes(format);
+    state.BindVertexArray(0);
+}
+
+void GeometryBuffer::grow(GLuint &buffer, size_t used, size_t capacity)
+{
+    GLuint grown;
+    glGenBuffers(1, &grown);
+    GLState &state = GLState::Instance();
+    state.BindBuffer(GL_COPY_WRITE_BUFFER, grown);
+    glBufferData(GL_COPY_WRITE_BUFFER, capacity, NULL, GL_STATIC_DRAW);
+    if (used > 0)
+    {
+        state.BindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, used);
+    }
+    if (buffer != 0)
+    {
+        glDeleteBuffers(1, &buffer);
+        state.BufferDeleted(buffer);
+    }
+    buffer = grown;
+}
+
+void GeometryBuffer::Reserve(size_t vertexCount, size_t indexBytes)
+{
+    if (VAO == 0)
+        glGenVertexArrays(1, &VAO);
+
+    size_t neededVertices = this->vertexCount + vertexCount;
+    // every range is padded to 4 bytes; a reserve that is a little too big is fine
+    size_t neededIndices = this->indexBytes + alignIndexOffset(indexBytes);
+    bool grew = false;
+    if (neededVertices > vertexCapacity || VBO == 0)
+    {
+        vertexCapacity = max(max(neededVertices, vertexCapacity * 2), MIN_VERTEX_CAPACITY);
+        grow(VBO, this->vertexCount * vertexSize(), vertexCapacity * vertexSize());
+        grew = true;
+    }
+    if (neededIndices > indexCapacity || EBO == 0)
+    {
+        indexCapacity = max(max(neededIndices, indexCapacity * 2), MIN_INDEX_CAPACITY);
+        grow(EBO, this->indexBytes, indexCapacity);
+        grew = true;
+    }
+    if (grew)
+    {
+        // the first allocation is not a regrow
+        if (this->vertexCount > 0 || this->indexBytes > 0)
+            grows++;
+        attachBuffers();
+    }
+}
+
+bool GeometryBuffer::takeFree(vector<FreeRange> &ranges, size_t &freeTotal, size_t size, size_t &first)
+{
+    if (size == 0)
+        return false;
+    for (size_t i = 0; i < ranges.size(); i++)
+    {
+        if (ranges[i].size < size)
+            continue;
+        first = ranges[i].first;
+        ranges[i].first += size;
+        ranges[i].size -= size;
+        if (ranges[i].size == 0)
+            ranges.erase(ranges.begin() + i);
+        freeTotal -= size;
+        return true;
+    }
+    return false;
+}
+
+void GeometryBuffer::giveBack(vector<FreeRange> &ranges, size_t &freeTotal, size_t first, size_t size, size_t &end)
+{
+    if (size == 0)
+        return;
+    auto next = lower_bound(ranges.begin(), ranges.end(), first,
+                            [](const FreeRange &range, size_t value) { return range.first < value; });
+    next = ranges.insert(next, { first, size });
+    freeTotal += size;
+    // merge with the free ranges right after and right before
+    if (next + 1 != ranges.end() && next->first + next->size == (next + 1)->first)
+    {
+        next->size += (next + 1)->size;
+        ranges.erase(next + 1);
+    }
+    if (next != ranges.begin() && (next - 1)->first + (next - 1)->size == next->first)
+    {
+        (next - 1)->size += next->size;
+        next = ranges.erase(next) - 1;
+    }
+    // a free range at the end is just unused capacity
+    if (ranges.back().first + ranges.back().size == end)
+    {
+        end = ranges.back().first;
+        freeTotal -= ranges.back().size;
+        ranges.pop_back();
+    }
+}
+
+GeometryRange GeometryBuffer::Add(const void *vertices, size_t vertexCount, const void *indices, size_t indexBytes)
+{
+    GeometryRange range;
+    range.vertexCount = vertexCount;
+    // every index range starts 4-byte aligned, whatever the width of the indices before it
+    range.indexBytes = alignIndexOffset(indexBytes);
+
+    size_t firstVertex;
+    bool vertexReused = takeFree(freeVertices, freeVertexCount, range.vertexCount, firstVertex);
+    bool indexReused = takeFree(freeIndices, freeIndexBytes, range.indexBytes, range.indexOffset);
+    Reserve(vertexReused ? 0 : range.vertexCount, indexReused ? 0 : range.indexBytes);
+    if (!vertexReused)
+    {
+        firstVertex = this->vertexCount;
+        this->vertexCount += range.vertexCount;
+    }
+    if (!indexReused)
+    {
+        range.indexOffset = this->indexBytes;
+        this->indexBytes += range.indexBytes;
+    }
+    range.baseVertex = (GLint)firstVertex;
+
+    GLState &state = GLState::Instance();
+    // uploads go through the copy target so the bound vertex array's element buffer is left alone
+    state.BindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, firstVertex * vertexSize(), vertexCount * vertexSize(), vertices);
+    state.BindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, range.indexOffset, indexBytes, indices);
+    return range;
+}
+
+void GeometryBuffer::Release(const GeometryRange &range)
+{
+    // ranges of a deleted buffer went with it
+    if (VAO == 0)
+        return;
+    giveBack(freeVertices, freeVertexCount, (size_t)range.baseVertex, range.vertexCount, vertexCount);
+    giveBack(freeIndices, freeIndexBytes, range.indexOffset, range.indexBytes, indexBytes);
+}
+
+void GeometryBuffer::Delete()
+{
+    if (VAO == 0)
+        return;
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+    GLState &state = GLState::Instance();
+    state.VertexArrayDeleted(VAO);
+    state.BufferDeleted(VBO);
+    state.BufferDeleted(EBO);
+    VAO = VBO = EBO = 0;
+    vertexCount = vertexCapacity = indexBytes = indexCapacity = 0;
+    freeVertices.clear();
+    freeIndices.clear();
+    freeVertexCount = freeIndexBytes = 0;
+}
@@ -0,0 +1,85 @@
+#ifndef GEOMETRYBUFFER_HPP
+#define GEOMETRYBUFFER_HPP
+
+#include <stddef.h>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "Mesh.hpp"
+
+using namespace std;
+// --------------------- Geometry Buffer --------------------- //
+/*
+    One vertex buffer, one index buffer and one vertex array shared by many
+    meshes of the same vertex format. Every mesh gets a range of each: its
+    indices stay relative to its own first vertex and are drawn with that
+    vertex as the base vertex (glDrawElementsBaseVertex), so meshes keep
+    their 8/16-bit indices however far into the buffer they land.
+
+    Since all meshes in it draw with the same vertex array, draws of them
+    never switch vertex arrays, and the render queue can merge consecutive
+    ones into a single glMultiDrawElementsBaseVertex.
+
+    Ranges given back (Release, from Mesh::Delete) go on a free list per
+    buffer, merged with free neighbours, and the first free range big enough
+    takes the next mesh; a free range at the end just shortens the buffer.
+    Everything else is appended. When a buffer runs out it is replaced by one
+    twice the size and the old contents are copied over on the GPU; the
+    vertex array keeps its name, so meshes never see the move. Reserve the
+    total up front to avoid that.
+*/
+
+class GeometryBuffer {
+    public:
+        GeometryBuffer(VertexFormat format = VertexFormat::Float) : format(format) {}
+
+        // Makes room for vertexCount more vertices and indexBytes more bytes of indices
+        void Reserve(size_t vertexCount, size_t indexBytes);
+        // Adds a mesh: vertexCount vertices in the buffer's format and indexBytes of indices. Freed
+        // ranges are filled first, so Reserve only counts what goes past the end.
+        GeometryRange Add(const void *vertices, size_t vertexCount, const void *indices, size_t indexBytes);
+        // Gives a range returned by Add back for later meshes
+        void Release(const GeometryRange &range);
+        // Deletes the vertex array and both buffers
+        void Delete();
+
+        VertexFormat Format() const { return format; }
+        unsigned int VertexArray() const { return VAO; }
+        // Bytes in use and bytes allocated on the GPU
+        size_t UsedBytes() const
+        {
+            return (vertexCount - freeVertexCount) * vertexSize() + indexBytes - freeIndexBytes;
+        }
+        size_t CapacityBytes() const { return vertexCapacity * vertexSize() + indexCapacity; }
+        // How often a buffer had to be reallocated because Reserve was too small
+        unsigned int GrowCount() const { return grows; }
+
+    private:
+        // first and size of a free range, in vertices or in index bytes
+        struct FreeRange {
+            size_t first;
+            size_t size;
+        };
+
+        VertexFormat format;
+        unsigned int VAO = 0, VBO = 0, EBO = 0;
+        size_t vertexCount = 0, vertexCapacity = 0;
+        size_t indexBytes = 0, indexCapacity = 0;
+        unsigned int grows = 0;
+        // free ranges below vertexCount and indexBytes, sorted by first, never touching each other
+        vector<FreeRange> freeVertices, freeIndices;
+        size_t freeVertexCount = 0, freeIndexBytes = 0;
+
+        size_t vertexSize() const { return format == VertexFormat::Compact ? sizeof(CompactVertex) : sizeof(Vertex); }
+        // Moves buffer into a new one of capacity bytes, keeping its first used bytes
+        void grow(GLuint &buffer, size_t used, size_t capacity);
+        // Points the vertex array at the current buffers
+        void attachBuffers();
+        // Takes size from the first free range that fits; false when none does
+        static bool takeFree(vector<FreeRange> &ranges, size_t &freeTotal, size_t size, size_t &first);
+        // Puts [first, first + size) on the free list, or cuts it off end when it is the last range
+        static void giveBack(vector<FreeRange> &ranges, size_t &freeTotal, size_t first, size_t size, size_t &end);
+};
+
+#endif /* GeometryBuffer_hpp */
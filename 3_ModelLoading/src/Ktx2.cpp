@@ -0,0 +1,216 @@
+#include "Ktx2.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+static const uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+struct Ktx2Header {
+    uint8_t  identifier[12];
+    uint32_t vkFormat;
+    uint32_t typeSize;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t layerCount;
+    uint32_t faceCount;
+    uint32_t levelCount;
+    uint32_t supercompressionScheme;
+    uint32_t dfdByteOffset;
+    uint32_t dfdByteLength;
+    uint32_t kvdByteOffset;
+    uint32_t kvdByteLength;
+    uint64_t sgdByteOffset;
+    uint64_t sgdByteLength;
+};
+static_assert(sizeof(Ktx2Header) == 80, "Ktx2Header must match the file layout");
+
+struct Ktx2LevelIndex {
+    uint64_t byteOffset;
+    uint64_t byteLength;
+    uint64_t uncompressedByteLength;
+};
+
+// Vulkan format, what it is made of, and what GL calls it
+struct FormatInfo {
+    uint32_t    vkFormat;
+    BlockFormat format;
+    bool        srgb;
+    GLenum      glFormat;
+};
+static const FormatInfo FORMATS[] = {
+    { 131, BlockFormat::BC1,  false, GL_COMPRESSED_RGB_S3TC_DXT1_EXT },
+    { 132, BlockFormat::BC1,  true,  GL_COMPRESSED_SRGB_S3TC_DXT1_EXT },
+    { 137, BlockFormat::BC3,  false, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT },
+    { 138, BlockFormat::BC3,  true,  GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT },
+    { 141, BlockFormat::BC5,  false, GL_COMPRESSED_RG_RGTC2 },
+    { 147, BlockFormat::ETC2, false, GL_COMPRESSED_RGB8_ETC2 },
+    { 148, BlockFormat::ETC2, true,  GL_COMPRESSED_SRGB8_ETC2 },
+};
+
+static const FormatInfo *findFormat(uint32_t vkFormat)
+{
+    for (const FormatInfo &info : FORMATS)
+        if (info.vkFormat == vkFormat)
+            return &info;
+    return nullptr;
+}
+
+uint32_t Ktx2::VkFormat(BlockFormat format, bool srgb)
+{
+    // BC5 holds vectors, never colors
+    if (format == BlockFormat::BC5)
+        srgb = false;
+    for (const FormatInfo &info : FORMATS)
+        if (info.format == format && info.srgb == srgb)
+            return info.vkFormat;
+    return 0;
+}
+
+GLenum Ktx2::GLFormat(uint32_t vkFormat)
+{
+    const FormatInfo *info = findFormat(vkFormat);
+    return info ? info->glFormat : 0;
+}
+
+bool Ktx2::Supported(uint32_t vkFormat)
+{
+    const FormatInfo *info = findFormat(vkFormat);
+    if (!info)
+        return false;
+    switch (info->format)
+    {
+        case BlockFormat::BC1:
+        case BlockFormat::BC3:
+            return GLEW_EXT_texture_compression_s3tc;
+        case BlockFormat::BC5:
+            return true;
+        case BlockFormat::ETC2:
+            return GLEW_VERSION_4_3 || GLEW_ARB_ES3_compatibility;
+    }
+    return false;
+}
+
+// Basic data format descriptor (Khronos Data Format 1.3) of a 4x4 block format: one 64-bit sample per
+// BC1 / ETC2 block, two per BC3 / BC5 block
+static vector<uint32_t> dataFormatDescriptor(BlockFormat format, bool srgb)
+{
+    // color models, channel ids and qualifiers from khr_df.h
+    const uint32_t ALPHA_CHANNEL = 15;     // of the BC3 color model
+    const uint32_t LINEAR_QUALIFIER = 0x10;
+    uint32_t colorModel = 0;
+    vector<uint32_t> channels;
+    switch (format)
+    {
+        case BlockFormat::BC1:  colorModel = 128; channels = { 0 };      break;  // BC1A: color
+        case BlockFormat::BC3:  colorModel = 130; channels = { 15, 0 };  break;  // BC3: alpha, color
+        case BlockFormat::BC5:  colorModel = 132; channels = { 0, 1 };   break;  // BC5: red, green
+        case BlockFormat::ETC2: colorModel = 161; channels = { 2 };      break;  // ETC2: color
+    }
+    uint32_t primaries = 1;                 // BT.709
+    uint32_t transfer = srgb ? 2 : 1;       // sRGB or linear
+    uint32_t blockSize = 24 + 16 * (uint32_t)channels.size();
+
+    vector<uint32_t> words;
+    words.push_back(4 + blockSize);         // total size
+    words.push_back(0);                     // vendor 0 (Khronos), descriptor type 0 (basic)
+    words.push_back(2 | blockSize << 16);   // version 2
+    words.push_back(colorModel | primaries << 8 | transfer << 16);
+    words.push_back(3 | 3 << 8);            // 4x4x1x1 texel blocks, stored minus one
+    words.push_back((uint32_t)TextureCompressor::BlockBytes(format));
+    words.push_back(0);
+    for (size_t i = 0; i < channels.size(); i++)
+    {
+        // alpha is never sRGB encoded: in an sRGB texture it has to say it stays linear
+        uint32_t channelType = channels[i] | (srgb && channels[i] == ALPHA_CHANNEL ? LINEAR_QUALIFIER : 0);
+        words.push_back((uint32_t)(i * 64) | 63 << 16 | channelType << 24);  // bit offset, length - 1, channel
+        words.push_back(0);                 // sample position
+        words.push_back(0);                 // lower
+        words.push_back(0xFFFFFFFFu);       // upper
+    }
+    return words;
+}
+
+static size_t alignUp(size_t n, size_t alignment)
+{
+    return (n + alignment - 1) / alignment * alignment;
+}
+
+bool Ktx2::Write(const string &path, BlockFormat format, bool srgb, int width, int height,
+                 const vector<vector<uint8_t>> &levels)
+{
+    vector<uint32_t> dfd = dataFormatDescriptor(format, srgb);
+    Ktx2Header header;
+    memcpy(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+    header.vkFormat = VkFormat(format, srgb);
+    header.typeSize = 1;
+    header.pixelWidth = (uint32_t)width;
+    header.pixelHeight = (uint32_t)height;
+    header.pixelDepth = 0;
+    header.layerCount = 0;
+    header.faceCount = 1;
+    header.levelCount = (uint32_t)levels.size();
+    header.supercompressionScheme = 0;
+    header.dfdByteOffset = (uint32_t)(sizeof(Ktx2Header) + levels.size() * sizeof(Ktx2LevelIndex));
+    header.dfdByteLength = (uint32_t)(dfd.size() * sizeof(uint32_t));
+    header.kvdByteOffset = header.kvdByteLength = 0;
+    header.sgdByteOffset = header.sgdByteLength = 0;
+
+    // levels are stored smallest first, each aligned to the block size
+    size_t alignment = TextureCompressor::BlockBytes(format);
+    vector<Ktx2LevelIndex> index(levels.size());
+    size_t offset = header.dfdByteOffset + header.dfdByteLength;
+    for (size_t level = levels.size(); level-- > 0;)
+    {
+        offset = alignUp(offset, alignment);
+        index[level] = { offset, levels[level].size(), levels[level].size() };
+        offset += levels[level].size();
+    }
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+        return false;
+    out.write((const char *)&header, sizeof(header));
+    out.write((const char *)index.data(), index.size() * sizeof(Ktx2LevelIndex));
+    out.write((const char *)dfd.data(), dfd.size() * sizeof(uint32_t));
+    const char padding[16] = { 0 };
+    for (size_t level = levels.size(); level-- > 0;)
+    {
+        size_t position = (size_t)out.tellp();
+        out.write(padding, index[level].byteOffset - position);
+        out.write((const char *)levels[level].data(), levels[level].size());
+    }
+    return (bool)out;
+}
+
+bool Ktx2::Parse(vector<uint8_t> file, Ktx2Texture &texture)
+{
+    if (file.size() < sizeof(Ktx2Header))
+        return false;
+    Ktx2Header header;
+    memcpy(&header, file.data(), sizeof(header));
+    const FormatInfo *info = findFormat(header.vkFormat);
+    if (memcmp(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0 || !info ||
+        header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth > 1 || header.layerCount > 1 ||
+        header.faceCount != 1 || header.supercompressionScheme != 0 || header.levelCount == 0 ||
+        sizeof(Ktx2Header) + (size_t)header.levelCount * sizeof(Ktx2LevelIndex) > file.size())
+        return false;
+
+    texture.levels.clear();
+    for (uint32_t level = 0; level < header.levelCount; level++)
+    {
+        Ktx2LevelIndex index;
+        memcpy(&index, file.data() + sizeof(Ktx2Header) + level * sizeof(Ktx2LevelIndex), sizeof(index));
+        int width = max((int)(header.pixelWidth >> level), 1), height = max((int)(header.pixelHeight >> level), 1);
+        if (index.byteLength != TextureCompressor::LevelBytes(info->format, width, height) ||
+            index.byteOffset > file.size() || index.byteLength > file.size() - index.byteOffset)
+            return false;
+        texture.levels.push_back({ (size_t)index.byteOffset, (size_t)index.byteLength });
+    }
+    texture.vkFormat = header.vkFormat;
+    texture.width = (int)header.pixelWidth;
+    texture.height = (int)header.pixelHeight;
+    texture.file = std::move(file);
+    return true;
+}
@@ -0,0 +1,60 @@
+#ifndef KTX2_HPP
+#define KTX2_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "TextureCompressor.hpp"
+
+using namespace std;
+// --------------------- KTX2 Files --------------------- //
+/*
+    Reads and writes the subset of KTX 2.0 texbake produces: one 2D image
+    (no array layers, no cube faces, no supercompression) in a block
+    compressed format, with its mip chain. The file is the 80 byte header,
+    the level index, a basic data format descriptor, then the levels,
+    smallest first, each 8 or 16 byte aligned.
+
+    Formats are identified by their Vulkan format number, as KTX2 does;
+    GLFormat maps them to the GL internal format glCompressedTexImage2D
+    takes.
+*/
+
+// A KTX2 file read into memory
+struct Ktx2Texture {
+    uint32_t vkFormat = 0;
+    int width = 0;
+    int height = 0;
+    vector<uint8_t> file;
+    // where each mip level is in file, finest first
+    struct Level {
+        size_t offset;
+        size_t size;
+    };
+    vector<Level> levels;
+
+    const uint8_t *LevelData(size_t level) const { return file.data() + levels[level].offset; }
+};
+
+class Ktx2 {
+    public:
+        static uint32_t VkFormat(BlockFormat format, bool srgb);
+        // GL internal format of a Vulkan format, 0 for formats this loader does not know
+        static GLenum GLFormat(uint32_t vkFormat);
+        // Whether the context can sample vkFormat (S3TC needs EXT_texture_compression_s3tc,
+        // ETC2 GL 4.3 or ARB_ES3_compatibility, RGTC is core)
+        static bool Supported(uint32_t vkFormat);
+
+        // Writes levels (finest first, each already encoded in format) as a KTX2 file
+        static bool Write(const string &path, BlockFormat format, bool srgb, int width, int height,
+                          const vector<vector<uint8_t>> &levels);
+        // Takes over file (the contents of a KTX2 file) and validates it. Returns false on anything
+        // this loader cannot upload.
+        static bool Parse(vector<uint8_t> file, Ktx2Texture &texture);
+};
+
+#endif /* Ktx2_hpp */
@@ -1,63 +1,443 @@
 #include "Mesh.hpp"
+#include "GeometryBuffer.hpp"
+#include "GLState.hpp"
+#include "MeshletBuilder.hpp"
 
-Mesh::Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <utility>
+#include <glm/gtc/matrix_transform.hpp>
+
+Mesh::Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, VertexFormat format,
+           GeometryBuffer *geometry, vector<MeshLod> lods, const Bounds *positionBox)
+{
+    this->format = format;
+    this->geometry = geometry;
+    this->vertices = std::move(vertices);
+    this->indices = std::move(indices);
+    this->textures = std::move(textures);
+    this->lods = std::move(lods);
+    vertexCount = this->vertices.size();
+
+    vector<string> types;
+    vector<unsigned int> textureIds;
+    for (const Texture &texture : this->textures)
+    {
+        types.push_back(texture.type);
+        textureIds.push_back(texture.id);
+    }
+    samplerNames = SamplerNames(types);
+    materialId = RenderQueue::RegisterMaterial(textureIds, samplerNames);
+    ownsMaterial = true;
+
+    setupMesh(positionBox);
+}
+
+Mesh::Mesh(Mesh &&other) noexcept
+{
+    moveFrom(other);
+}
+
+Mesh &Mesh::operator=(Mesh &&other) noexcept
+{
+    if (this != &other)
+    {
+        Delete();
+        moveFrom(other);
+    }
+    return *this;
+}
+
+void Mesh::moveFrom(Mesh &other)
 {
-    this->vertices = vertices;
-    this->indices = indices;
-    this->textures = textures;
+    vertices = std::move(other.vertices);
+    indices = std::move(other.indices);
+    lods = std::move(other.lods);
+    textures = std::move(other.textures);
+    bounds = other.bounds;
+    meshlets = std::move(other.meshlets);
+    VAO = exchange(other.VAO, 0u);
+    VBO = exchange(other.VBO, 0u);
+    EBO = exchange(other.EBO, 0u);
+    format = other.format;
+    geometry = exchange(other.geometry, nullptr);
+    geometryRange = other.geometryRange;
+    vertexCount = other.vertexCount;
+    totalIndexCount = other.totalIndexCount;
+    baseVertex = other.baseVertex;
+    levels = std::move(other.levels);
+    positionDecode = other.positionDecode;
+    indexType = other.indexType;
+    samplerNames = std::move(other.samplerNames);
+    samplerUniforms = std::move(other.samplerUniforms);
+    samplerProgram = other.samplerProgram;
+    materialId = other.materialId;
+    ownsMaterial = exchange(other.ownsMaterial, false);
+    layered = other.layered;
+    layer = other.layer;
+    visibleMeshlets = std::move(other.visibleMeshlets);
+}
 
-    setupMesh();
+vector<string> Mesh::SamplerNames(const vector<string> &types)
+{
+    // retrieve texture number (the N in diffuse_textureN)
+    unsigned int diffuseNr = 1;
+    unsigned int specularNr = 1;
+    vector<string> names;
+    for (const string &name : types)
+    {
+        string number;
+        if(name == "texture_diffuse")
+            number = std::to_string(diffuseNr++);
+        else if(name == "texture_specular")
+            number = std::to_string(specularNr++);
+        names.push_back("material." + name + number);
+    }
+    return names;
+}
+
+void Mesh::UseTextureArrays(const ArrayMaterial &material)
+{
+    // the array pool holds its own registration of the shared material
+    if (ownsMaterial)
+        RenderQueue::ReleaseMaterial(materialId);
+    ownsMaterial = false;
+    materialId = material.materialId;
+    layer = material.layer;
+    layered = true;
 }
-void Mesh::setupMesh()
+
+void Mesh::setupMesh(const Bounds *positionBox)
 {
+    indexType = IndexTypeFor(vertices.size());
+    vector<CompactVertex> compact;
+    const void *vertexData = vertices.data();
+    size_t vertexBytes = vertices.size() * sizeof(Vertex);
+    if (format == VertexFormat::Compact)
+    {
+        compact = packCompact(positionBox);
+        vertexData = compact.data();
+        vertexBytes = compact.size() * sizeof(CompactVertex);
+    }
+    vector<uint8_t> indexData = packIndices();
+
+    if (geometry)
+    {
+        geometryRange = geometry->Add(vertexData, vertices.size(), indexData.data(), indexData.size());
+        VAO = geometry->VertexArray();
+        baseVertex = geometryRange.baseVertex;
+        for (Level &level : levels)
+            level.indexOffset += geometryRange.indexOffset;
+        return;
+    }
+
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
     glGenBuffers(1, &EBO);
   
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    GLState &state = GLState::Instance();
+    state.BindVertexArray(VAO);
+    state.BindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertexBytes, vertexData, GL_STATIC_DRAW);
 
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+    state.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexData.size(), indexData.data(), GL_STATIC_DRAW);
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int),
-                 &indices[0], GL_STATIC_DRAW);
+    SetVertexAttributes(format);
+    state.BindVertexArray(0);
+}
 
-    // vertex positions
+void Mesh::SetVertexAttributes(VertexFormat format)
+{
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-    // vertex normals
     glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-    // vertex texture coords
     glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+    if (format == VertexFormat::Compact)
+    {
+        // positions in [0, 1] of the quantization box, octahedral normals in [-1, 1], half float uvs
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, Position));
+        glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, Normal));
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, TexCoords));
+    }
+    else
+    {
+        // vertex positions
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+        // vertex normals
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+        // vertex texture coords
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+    }
+}
+
+void Mesh::Draw(Shader &shader, unsigned int level)
+{
+    GLState &state = GLState::Instance();
+    if (layered)
+    {
+        RenderQueue::BindMaterial(shader, materialId);
+        // vertex arrays have no array for the layer outside a render queue flush, so this constant is read
+        glVertexAttribI1ui(RenderQueue::LAYER_ATTRIBUTE, layer);
+    }
+    else
+    {
+        // only look the sampler uniforms up again when drawn with a different program
+        if (samplerProgram != shader.ID || samplerUniforms.size() != samplerNames.size())
+        {
+            samplerUniforms.clear();
+            for (const string &samplerName : samplerNames)
+                samplerUniforms.push_back(shader.GetUniform(samplerName));
+            samplerProgram = shader.ID;
+        }
 
-    glBindVertexArray(0);
+        for(unsigned int i = 0; i < textures.size(); i++)
+        {
+            shader.setInt(samplerUniforms[i], i);
+            state.BindTextureUnit(i, GL_TEXTURE_2D, textures[i].id);
+        }
+    }
+
+    // draw mesh. The VAO stays bound: the next draw binds its own, and binding 0 in between costs a call for nothing
+    state.BindVertexArray(VAO);
+    const Level &drawn = levels[level];
+    glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)drawn.indexCount, indexType, (void*)drawn.indexOffset, baseVertex);
 }
 
-void Mesh::Draw(Shader &shader)
+void Mesh::Submit(RenderQueue &queue, Shader &shader, const glm::mat4 &model, unsigned int level)
 {
-    unsigned int diffuseNr = 1;
-    unsigned int specularNr = 1;
-    for(unsigned int i = 0; i < textures.size(); i++)
+    const Level &drawn = levels[level];
+    queue.Submit(shader, VAO, materialId, format == VertexFormat::Compact ? model * positionDecode : model,
+                 GL_TRIANGLES, (GLsizei)drawn.indexCount, indexType, false, drawn.indexOffset, baseVertex, layer);
+}
+
+void Mesh::SubmitMeshlets(RenderQueue &queue, Shader &shader, const glm::mat4 &model, const Frustum &frustum,
+                          const glm::vec3 *eye)
+{
+    MeshletBuilder::Cull(meshlets, frustum, eye, visibleMeshlets);
+    glm::mat4 placed = format == VertexFormat::Compact ? model * positionDecode : model;
+    size_t indexSize = IndexSize(indexType);
+    for (size_t i = 0; i < meshlets.size(); i++)
     {
-        glActiveTexture(GL_TEXTURE0 + i); // activate proper texture unit before binding
-        // retrieve texture number (the N in diffuse_textureN)
-        string number;
-        string name = textures[i].type;
-        if(name == "texture_diffuse")
-            number = std::to_string(diffuseNr++);
-        else if(name == "texture_specular")
-            number = std::to_string(specularNr++);
+        if (!visibleMeshlets[i])
+            continue;
+        // neighbouring meshlets are neighbouring index ranges: one draw for the whole run
+        size_t end = i + 1;
+        while (end < meshlets.size() && visibleMeshlets[end])
+            end++;
+        const Meshlet &last = meshlets[end - 1];
+        GLsizei indexCount = (GLsizei)(last.firstIndex + last.triangleCount * 3 - meshlets[i].firstIndex);
+        queue.Submit(shader, VAO, materialId, placed, GL_TRIANGLES, indexCount, indexType, false,
+                     levels[0].indexOffset + meshlets[i].firstIndex * indexSize, baseVertex, layer);
+        i = end - 1;
+    }
+}
+
+unsigned int Mesh::SelectLevel(const LodView &view, const Bounds &worldBounds) const
+{
+    float projectedRadius = view.ProjectedRadius(worldBounds);
+    if (projectedRadius <= 0.0f)
+        return 0;
+    for (unsigned int level = (unsigned int)levels.size() - 1; level > 0; level--)
+        if (levels[level].error * projectedRadius <= view.pixelError)
+            return level;
+    return 0;
+}
+
+size_t Mesh::VertexBufferBytes() const
+{
+    return vertexCount * (format == VertexFormat::Compact ? sizeof(CompactVertex) : sizeof(Vertex));
+}
+
+// Byte indices are in core GL but some drivers convert them on the CPU; worth timing per target
+GLenum Mesh::IndexTypeFor(size_t vertexCount)
+{
+    if (vertexCount <= 0x100)
+        return GL_UNSIGNED_BYTE;
+    if (vertexCount <= 0x10000)
+        return GL_UNSIGNED_SHORT;
+    return GL_UNSIGNED_INT;
+}
+
+size_t Mesh::IndexSize(GLenum indexType)
+{
+    switch (indexType)
+    {
+        case GL_UNSIGNED_BYTE:  return 1;
+        case GL_UNSIGNED_SHORT: return 2;
+        default:                return 4;
+    }
+}
+
+// Appends indices to bytes as Index
+template <typename Index>
+static void narrowIndices(const vector<unsigned int> &indices, vector<uint8_t> &bytes)
+{
+    size_t start = bytes.size();
+    bytes.resize(start + indices.size() * sizeof(Index));
+    Index *out = (Index *)(bytes.data() + start);
+    for (size_t i = 0; i < indices.size(); i++)
+        out[i] = (Index)indices[i];
+}
+
+static void narrowIndices(GLenum indexType, const vector<unsigned int> &indices, vector<uint8_t> &bytes)
+{
+    if (indexType == GL_UNSIGNED_BYTE)
+        narrowIndices<uint8_t>(indices, bytes);
+    else if (indexType == GL_UNSIGNED_SHORT)
+        narrowIndices<uint16_t>(indices, bytes);
+    else
+        narrowIndices<uint32_t>(indices, bytes);
+}
+
+vector<uint8_t> Mesh::packIndices()
+{
+    vector<uint8_t> bytes;
+    levels.clear();
+    levels.push_back({ 0, indices.size(), 0.0f });
+    narrowIndices(indexType, indices, bytes);
+    for (const MeshLod &lod : lods)
+    {
+        levels.push_back({ bytes.size(), lod.indices.size(), lod.error });
+        narrowIndices(indexType, lod.indices, bytes);
+    }
+    totalIndexCount = bytes.size() / IndexSize(indexType);
+    return bytes;
+}
+
+// IEEE half from float: round to nearest, overflow to infinity, tiny values flush to zero
+static uint16_t toHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+    int exponent = (int)((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFF;
+    if (((bits >> 23) & 0xFF) == 0xFF)
+        return sign | 0x7C00 | (mantissa ? 0x200 : 0);  // inf / nan
+    if (exponent >= 31)
+        return sign | 0x7C00;
+    if (exponent <= 0)
+    {
+        if (exponent < -10)
+            return sign;
+        // subnormal half
+        mantissa |= 0x800000;
+        uint32_t shift = (uint32_t)(14 - exponent);
+        uint16_t half = (uint16_t)(mantissa >> shift);
+        if ((mantissa >> (shift - 1)) & 1)
+            half++;
+        return sign | half;
+    }
+    uint16_t half = (uint16_t)(sign | (exponent << 10) | (mantissa >> 13));
+    if (mantissa & 0x1000)
+        half++;  // carries into the exponent correctly, up to infinity
+    return half;
+}
+
+static int16_t toSnorm16(float value)
+{
+    return (int16_t)lroundf(glm::clamp(value, -1.0f, 1.0f) * 32767.0f);
+}
+
+// Octahedral mapping: project onto |x| + |y| + |z| = 1 and fold the lower half over the upper one
+static void encodeOctahedral(const glm::vec3 &normal, int16_t out[2])
+{
+    float sum = fabsf(normal.x) + fabsf(normal.y) + fabsf(normal.z);
+    if (sum == 0.0f)
+    {
+        out[0] = out[1] = 0;
+        return;
+    }
+    float x = normal.x / sum;
+    float y = normal.y / sum;
+    if (normal.z < 0.0f)
+    {
+        float foldedX = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float foldedY = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = foldedX;
+        y = foldedY;
+    }
+    out[0] = toSnorm16(x);
+    out[1] = toSnorm16(y);
+}
+
+vector<CompactVertex> Mesh::packCompact(const Bounds *positionBox)
+{
+    glm::vec3 boxMin(0.0f), boxMax(0.0f);
+    if (positionBox)
+    {
+        boxMin = positionBox->min;
+        boxMax = positionBox->max;
+    }
+    else
+    {
+        if (!vertices.empty())
+            boxMin = boxMax = vertices[0].Position;
+        for (const Vertex &vertex : vertices)
+        {
+            boxMin = glm::min(boxMin, vertex.Position);
+            boxMax = glm::max(boxMax, vertex.Position);
+        }
+    }
+    // a flat box side would divide by zero; any scale decodes 0 back to boxMin there
+    glm::vec3 size = glm::max(boxMax - boxMin, glm::vec3(1e-6f));
+    positionDecode = glm::scale(glm::translate(glm::mat4(1.0f), boxMin), size);
 
-        shader.setInt(("material." + name + number).c_str(), i);
-        glBindTexture(GL_TEXTURE_2D, textures[i].id);
+    vector<CompactVertex> packed(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        const Vertex &vertex = vertices[i];
+        CompactVertex &out = packed[i];
+        glm::vec3 unit = (vertex.Position - boxMin) / size;
+        for (int axis = 0; axis < 3; axis++)
+            out.Position[axis] = (uint16_t)lroundf(glm::clamp(unit[axis], 0.0f, 1.0f) * 65535.0f);
+        out.Padding = 0;
+        encodeOctahedral(vertex.Normal, out.Normal);
+        out.TexCoords[0] = toHalf(vertex.TexCoords.x);
+        out.TexCoords[1] = toHalf(vertex.TexCoords.y);
     }
-    glActiveTexture(GL_TEXTURE0);
+    return packed;
+}
 
-    // draw mesh
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
+void Mesh::ReleaseCpuData()
+{
+    // swapping with empty vectors frees the storage, clear() would keep it
+    vector<Vertex>().swap(vertices);
+    vector<unsigned int>().swap(indices);
+    vector<MeshLod>().swap(lods);
+}
+
+size_t Mesh::CpuBytes() const
+{
+    size_t bytes = vertices.capacity() * sizeof(Vertex) + indices.capacity() * sizeof(unsigned int);
+    for (const MeshLod &lod : lods)
+        bytes += lod.indices.capacity() * sizeof(unsigned int);
+    return bytes;
+}
+
+void Mesh::Delete()
+{
+    if (ownsMaterial)
+        RenderQueue::ReleaseMaterial(materialId);
+    ownsMaterial = false;
+    // the geometry buffer's owner deletes the shared vertex array and buffers, the mesh only gives its
+    // range back; a moved-from mesh has none
+    if (geometry)
+    {
+        geometry->Release(geometryRange);
+        geometry = nullptr;
+        VAO = 0;
+        return;
+    }
+    if (VAO == 0)
+        return;
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+    GLState &state = GLState::Instance();
+    state.VertexArrayDeleted(VAO);
+    state.BufferDeleted(VBO);
+    state.BufferDeleted(EBO);
+    VAO = VBO = EBO = 0;
 }
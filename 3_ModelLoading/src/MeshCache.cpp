@@ -0,0 +1,383 @@
+#include "MeshCache.hpp"
+#include "Hash.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Bump whenever the file layout below changes
+static const uint32_t MESH_CACHE_VERSION = 5;
+static const char     MESH_CACHE_MAGIC[8] = { 'M', 'E', 'S', 'H', 'C', 'A', 'C', 'H' };
+
+struct CacheHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t vertexSize;
+    uint32_t importFlags;
+    uint32_t meshCount;
+    uint32_t nodeCount;
+    float    lodErrorBound;
+    uint64_t sourceSize;
+    int64_t  sourceMtime;
+    uint64_t sourceHash;
+    double   coldImportMs;
+};
+
+// Every mesh record is: CacheMeshHeader, texture strings, vertices, indices, per LOD a
+// CacheLodHeader and its indices, then the meshlets (each block 8-byte aligned)
+struct CacheMeshHeader {
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t textureCount;
+    uint32_t stringBytes;
+    uint32_t lodCount;
+    uint32_t meshletCount;
+};
+
+struct CacheLodHeader {
+    uint32_t indexCount;
+    float    error;
+};
+
+// After the meshes, every node record is: CacheNodeHeader, name, mesh indices (each block 8-byte aligned)
+struct CacheNodeHeader {
+    uint32_t parent;
+    uint32_t meshCount;
+    uint32_t nameBytes;
+    uint32_t padding;
+    float    local[16];
+};
+
+static_assert(std::is_trivially_copyable<Meshlet>::value, "Meshlets are written to the cache as raw bytes");
+
+static size_t alignTo8(size_t n)
+{
+    return (n + 7) & ~(size_t)7;
+}
+
+MeshCache::MeshCache(const string &sourcePath, unsigned int importFlags, float lodErrorBound)
+    : sourcePath(sourcePath), cachePath(sourcePath + ".meshcache"), importFlags(importFlags),
+      lodErrorBound(lodErrorBound)
+{
+}
+
+MeshCache::~MeshCache()
+{
+    unmapFile();
+}
+
+bool MeshCache::sourceKey(uint64_t &size, int64_t &mtime, uint64_t &hash) const
+{
+    std::error_code ec;
+    size = (uint64_t)std::filesystem::file_size(sourcePath, ec);
+    if (ec)
+        return false;
+    mtime = (int64_t)std::filesystem::last_write_time(sourcePath, ec).time_since_epoch().count();
+    if (ec)
+        return false;
+    return hashFile(sourcePath, hash);
+}
+
+bool MeshCache::mapFile()
+{
+#ifndef _WIN32
+    int fd = open(cachePath.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(CacheHeader))
+    {
+        close(fd);
+        return false;
+    }
+    void *data = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // the mapping stays valid after the descriptor is closed
+    if (data == MAP_FAILED)
+        return false;
+
+    mapping = data;
+    mappingSize = (size_t)st.st_size;
+    return true;
+#else
+    std::ifstream in(cachePath, std::ios::binary | std::ios::ate);
+    if (!in)
+        return false;
+    std::streamsize size = in.tellg();
+    if (size < (std::streamsize)sizeof(CacheHeader))
+        return false;
+    // back the buffer with doubles so the vertex data stays aligned
+    fallbackBuffer.resize((size_t)size + sizeof(double));
+    char *base = (char *)(((uintptr_t)fallbackBuffer.data() + 7) & ~(uintptr_t)7);
+    in.seekg(0, std::ios::beg);
+    in.read(base, size);
+    mapping = base;
+    mappingSize = (size_t)size;
+    return true;
+#endif
+}
+
+void MeshCache::unmapFile()
+{
+#ifndef _WIN32
+    if (mapping)
+        munmap(mapping, mappingSize);
+#endif
+    mapping = nullptr;
+    mappingSize = 0;
+    fallbackBuffer.clear();
+    meshes.clear();
+    graph.Clear();
+}
+
+bool MeshCache::Read()
+{
+    unmapFile();
+    if (!mapFile())
+        return false;
+
+    const char *base = (const char *)mapping;
+    const CacheHeader *header = (const CacheHeader *)base;
+
+    uint64_t size, hash;
+    int64_t  mtime;
+    if (std::memcmp(header->magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC)) != 0 ||
+        header->version != MESH_CACHE_VERSION ||
+        header->vertexSize != sizeof(Vertex) ||
+        header->importFlags != importFlags ||
+        header->lodErrorBound != lodErrorBound ||
+        !sourceKey(size, mtime, hash) ||
+        header->sourceSize != size || header->sourceMtime != mtime || header->sourceHash != hash)
+    {
+        unmapFile();
+        return false;
+    }
+    coldImportMs = header->coldImportMs;
+
+    size_t offset = alignTo8(sizeof(CacheHeader));
+    for (uint32_t m = 0; m < header->meshCount; m++)
+    {
+        if (offset + sizeof(CacheMeshHeader) > mappingSize)
+        {
+            unmapFile();
+            return false;
+        }
+        const CacheMeshHeader *meshHeader = (const CacheMeshHeader *)(base + offset);
+        offset += sizeof(CacheMeshHeader);
+
+        size_t stringsEnd  = offset + meshHeader->stringBytes;
+        size_t verticesEnd = alignTo8(stringsEnd) + (size_t)meshHeader->vertexCount * sizeof(Vertex);
+        size_t indicesEnd  = alignTo8(verticesEnd) + (size_t)meshHeader->indexCount * sizeof(unsigned int);
+        if (indicesEnd > mappingSize)
+        {
+            unmapFile();
+            return false;
+        }
+
+        CachedMeshView view;
+        // texture strings are stored as [uint32 length][chars] pairs of type then path
+        const char *cursor = base + offset;
+        const char *stringsLimit = base + stringsEnd;
+        for (uint32_t t = 0; t < meshHeader->textureCount; t++)
+        {
+            string fields[2];
+            for (string &field : fields)
+            {
+                uint32_t length;
+                if (cursor + sizeof(length) > stringsLimit)
+                {
+                    unmapFile();
+                    return false;
+                }
+                std::memcpy(&length, cursor, sizeof(length));
+                cursor += sizeof(length);
+                if (length > (size_t)(stringsLimit - cursor))
+                {
+                    unmapFile();
+                    return false;
+                }
+                field.assign(cursor, length);
+                cursor += length;
+            }
+            view.textures.push_back({ fields[0], fields[1] });
+        }
+
+        view.vertices    = (const Vertex *)(base + alignTo8(stringsEnd));
+        view.vertexCount = meshHeader->vertexCount;
+        view.indices     = (const unsigned int *)(base + alignTo8(verticesEnd));
+        view.indexCount  = meshHeader->indexCount;
+        offset = alignTo8(indicesEnd);
+
+        for (uint32_t l = 0; l < meshHeader->lodCount; l++)
+        {
+            if (offset + sizeof(CacheLodHeader) > mappingSize)
+            {
+                unmapFile();
+                return false;
+            }
+            const CacheLodHeader *lodHeader = (const CacheLodHeader *)(base + offset);
+            size_t lodIndices = alignTo8(offset + sizeof(CacheLodHeader));
+            size_t lodEnd = lodIndices + (size_t)lodHeader->indexCount * sizeof(unsigned int);
+            if (lodEnd > mappingSize)
+            {
+                unmapFile();
+                return false;
+            }
+            view.lods.push_back({ (const unsigned int *)(base + lodIndices), lodHeader->indexCount, lodHeader->error });
+            offset = alignTo8(lodEnd);
+        }
+
+        size_t meshletsEnd = offset + (size_t)meshHeader->meshletCount * sizeof(Meshlet);
+        if (meshletsEnd > mappingSize)
+        {
+            unmapFile();
+            return false;
+        }
+        view.meshlets     = (const Meshlet *)(base + offset);
+        view.meshletCount = meshHeader->meshletCount;
+        offset = alignTo8(meshletsEnd);
+        meshes.push_back(std::move(view));
+    }
+
+    for (uint32_t n = 0; n < header->nodeCount; n++)
+    {
+        if (offset + sizeof(CacheNodeHeader) > mappingSize)
+        {
+            unmapFile();
+            return false;
+        }
+        const CacheNodeHeader *nodeHeader = (const CacheNodeHeader *)(base + offset);
+        offset += sizeof(CacheNodeHeader);
+        size_t nameEnd = offset + nodeHeader->nameBytes;
+        size_t refsEnd = alignTo8(nameEnd) + (size_t)nodeHeader->meshCount * sizeof(uint32_t);
+        if (refsEnd > mappingSize || (nodeHeader->parent != SceneGraph::NO_NODE && nodeHeader->parent >= n))
+        {
+            unmapFile();
+            return false;
+        }
+
+        glm::mat4 local;
+        std::memcpy(&local[0][0], nodeHeader->local, sizeof(nodeHeader->local));
+        uint32_t node = graph.AddNode(nodeHeader->parent, local, string(base + offset, nodeHeader->nameBytes));
+        const uint32_t *refs = (const uint32_t *)(base + alignTo8(nameEnd));
+        for (uint32_t r = 0; r < nodeHeader->meshCount; r++)
+        {
+            if (refs[r] >= header->meshCount)
+            {
+                unmapFile();
+                return false;
+            }
+            graph.AddMesh(node, refs[r]);
+        }
+        offset = alignTo8(refsEnd);
+    }
+    return true;
+}
+
+bool MeshCache::Write(const vector<MeshData> &meshes, const SceneGraph &graph, double coldImportMs)
+{
+    CacheHeader header;
+    std::memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC));
+    header.version       = MESH_CACHE_VERSION;
+    header.vertexSize    = sizeof(Vertex);
+    header.importFlags   = importFlags;
+    header.meshCount     = (uint32_t)meshes.size();
+    header.nodeCount     = (uint32_t)graph.NodeCount();
+    header.lodErrorBound = lodErrorBound;
+    header.coldImportMs  = coldImportMs;
+    if (!sourceKey(header.sourceSize, header.sourceMtime, header.sourceHash))
+        return false;
+
+    // write to a temporary file first so a crash never leaves a half-written cache behind
+    string tempPath = cachePath + ".tmp";
+    std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+        cout << "ERROR::MESHCACHE::Could not write " << tempPath << endl;
+        return false;
+    }
+
+    const char padding[8] = { 0 };
+    auto pad = [&]() {
+        size_t position = (size_t)out.tellp();
+        out.write(padding, alignTo8(position) - position);
+    };
+
+    out.write((const char *)&header, sizeof(header));
+    pad();
+    for (const MeshData &mesh : meshes)
+    {
+        CacheMeshHeader meshHeader;
+        meshHeader.vertexCount  = (uint32_t)mesh.vertices.size();
+        meshHeader.indexCount   = (uint32_t)mesh.indices.size();
+        meshHeader.textureCount = (uint32_t)mesh.textures.size();
+        meshHeader.stringBytes  = 0;
+        meshHeader.lodCount     = (uint32_t)mesh.lods.size();
+        meshHeader.meshletCount = (uint32_t)mesh.meshlets.size();
+        for (const TextureRef &texture : mesh.textures)
+            meshHeader.stringBytes += 2 * sizeof(uint32_t) + (uint32_t)(texture.type.size() + texture.path.size());
+        out.write((const char *)&meshHeader, sizeof(meshHeader));
+
+        for (const TextureRef &texture : mesh.textures)
+        {
+            for (const string *field : { &texture.type, &texture.path })
+            {
+                uint32_t length = (uint32_t)field->size();
+                out.write((const char *)&length, sizeof(length));
+                out.write(field->data(), length);
+            }
+        }
+        pad();
+        out.write((const char *)mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+        pad();
+        out.write((const char *)mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+        pad();
+        for (const MeshLod &lod : mesh.lods)
+        {
+            CacheLodHeader lodHeader;
+            lodHeader.indexCount = (uint32_t)lod.indices.size();
+            lodHeader.error      = lod.error;
+            out.write((const char *)&lodHeader, sizeof(lodHeader));
+            pad();
+            out.write((const char *)lod.indices.data(), lod.indices.size() * sizeof(unsigned int));
+            pad();
+        }
+        out.write((const char *)mesh.meshlets.data(), mesh.meshlets.size() * sizeof(Meshlet));
+        pad();
+    }
+    for (uint32_t node = 0; node < graph.NodeCount(); node++)
+    {
+        CacheNodeHeader nodeHeader;
+        nodeHeader.parent    = graph.Parent(node);
+        nodeHeader.meshCount = graph.MeshCount(node);
+        nodeHeader.nameBytes = (uint32_t)graph.Name(node).size();
+        nodeHeader.padding   = 0;
+        std::memcpy(nodeHeader.local, &graph.Local(node)[0][0], sizeof(nodeHeader.local));
+        out.write((const char *)&nodeHeader, sizeof(nodeHeader));
+        out.write(graph.Name(node).data(), nodeHeader.nameBytes);
+        pad();
+        out.write((const char *)(graph.MeshRefs().data() + graph.FirstMesh(node)),
+                  nodeHeader.meshCount * sizeof(uint32_t));
+        pad();
+    }
+    out.close();
+    if (!out)
+    {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempPath, cachePath, ec);
+    return !ec;
+}
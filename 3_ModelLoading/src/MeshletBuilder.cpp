@@ -0,0 +1,145 @@
+#include "MeshletBuilder.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+// Below this, the normals spread too far for the cone to reject anything
+const float MIN_CONE_DOT = 0.1f;
+
+FrameCounter<MeshletStats> MeshletBuilder::stats;
+
+vector<Meshlet> MeshletBuilder::Build(const vector<Vertex> &vertices, const vector<unsigned int> &indices)
+{
+    vector<Meshlet> meshlets;
+    // points or lines: there are no triangles to group, and the loop below would read past the end
+    if (indices.size() % 3 != 0)
+        return meshlets;
+    // the meshlet a vertex was last counted in, so each one is counted once per meshlet
+    vector<uint32_t> seenIn(vertices.size(), ~0u);
+    uint32_t current = 0, firstIndex = 0, triangleCount = 0, vertexCount = 0;
+    for (size_t i = 0; i < indices.size(); i += 3)
+    {
+        unsigned int newVertices = 0;
+        for (int corner = 0; corner < 3; corner++)
+            if (seenIn[indices[i + corner]] != current)
+                newVertices++;
+        if (vertexCount + newVertices > MAX_VERTICES || triangleCount == MAX_TRIANGLES)
+        {
+            meshlets.push_back(finish(vertices, indices, firstIndex, triangleCount));
+            current++;
+            firstIndex = (uint32_t)i;
+            triangleCount = vertexCount = 0;
+        }
+        for (int corner = 0; corner < 3; corner++)
+        {
+            unsigned int index = indices[i + corner];
+            if (seenIn[index] != current)
+            {
+                seenIn[index] = current;
+                vertexCount++;
+            }
+        }
+        triangleCount++;
+    }
+    if (triangleCount > 0)
+        meshlets.push_back(finish(vertices, indices, firstIndex, triangleCount));
+    return meshlets;
+}
+
+Meshlet MeshletBuilder::finish(const vector<Vertex> &vertices, const vector<unsigned int> &indices,
+                               uint32_t firstIndex, uint32_t triangleCount)
+{
+    Meshlet meshlet;
+    meshlet.firstIndex = firstIndex;
+    meshlet.triangleCount = triangleCount;
+
+    uint32_t end = firstIndex + triangleCount * 3;
+    Bounds &bounds = meshlet.bounds;
+    bounds.min = bounds.max = vertices[indices[firstIndex]].Position;
+    for (uint32_t i = firstIndex; i < end; i++)
+    {
+        bounds.min = glm::min(bounds.min, vertices[indices[i]].Position);
+        bounds.max = glm::max(bounds.max, vertices[indices[i]].Position);
+    }
+    bounds.center = (bounds.min + bounds.max) * 0.5f;
+    float radiusSquared = 0.0f;
+    for (uint32_t i = firstIndex; i < end; i++)
+    {
+        glm::vec3 offset = vertices[indices[i]].Position - bounds.center;
+        radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+    }
+    bounds.radius = std::sqrt(radiusSquared);
+
+    // face normals rather than vertex normals: culling is about the triangles' winding
+    glm::vec3 normals[MAX_TRIANGLES];
+    glm::vec3 axis(0.0f);
+    uint32_t normalCount = 0;
+    for (uint32_t i = firstIndex; i < end; i += 3)
+    {
+        glm::vec3 p0 = vertices[indices[i]].Position;
+        glm::vec3 normal = glm::cross(vertices[indices[i + 1]].Position - p0, vertices[indices[i + 2]].Position - p0);
+        float length = glm::length(normal);
+        if (length == 0.0f)
+            continue;
+        normals[normalCount++] = normal / length;
+        axis += normal / length;
+    }
+    float axisLength = glm::length(axis);
+    meshlet.coneAxis = axisLength > 0.0f ? axis / axisLength : glm::vec3(0.0f, 0.0f, 1.0f);
+    meshlet.coneCutoff = 1.0f;
+    if (axisLength > 0.0f)
+    {
+        float minDot = 1.0f;
+        for (uint32_t n = 0; n < normalCount; n++)
+            minDot = std::min(minDot, glm::dot(normals[n], meshlet.coneAxis));
+        if (minDot > MIN_CONE_DOT)
+            meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+    }
+    return meshlet;
+}
+
+bool MeshletBuilder::FacesAway(const Meshlet &meshlet, const glm::vec3 &eye)
+{
+    glm::vec3 toCenter = meshlet.bounds.center - eye;
+    return glm::dot(toCenter, meshlet.coneAxis) >=
+           meshlet.coneCutoff * glm::length(toCenter) + meshlet.bounds.radius;
+}
+
+size_t MeshletBuilder::Cull(const vector<Meshlet> &meshlets, const Frustum &frustum, const glm::vec3 *eye,
+                            vector<uint8_t> &visible)
+{
+    auto start = chrono::steady_clock::now();
+    MeshletStats &thisFrame = stats.ThisFrame();
+    visible.resize(meshlets.size());
+    size_t visibleCount = 0;
+    for (size_t i = 0; i < meshlets.size(); i++)
+    {
+        const Meshlet &meshlet = meshlets[i];
+        bool inside = frustum.Intersects(meshlet.bounds);
+        bool facing = !inside || !eye || !FacesAway(meshlet, *eye);
+        visible[i] = inside && facing;
+        thisFrame.triangles += meshlet.triangleCount;
+        if (!inside)
+            thisFrame.frustumCulled++;
+        else if (!facing)
+            thisFrame.coneCulled++;
+        if (visible[i])
+            visibleCount++;
+        else
+            thisFrame.trianglesCulled += meshlet.triangleCount;
+    }
+    thisFrame.meshlets += meshlets.size();
+    thisFrame.cullMs += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    return visibleCount;
+}
+
+void MeshletBuilder::PrintStats()
+{
+    const MeshletStats &lastFrame = stats.LastFrame();
+    double culledPercent = lastFrame.triangles ? 100.0 * lastFrame.trianglesCulled / lastFrame.triangles : 0.0;
+    cout << "Meshlets: last frame " << lastFrame.meshlets << " tested, " << lastFrame.frustumCulled
+         << " outside the frustum, " << lastFrame.coneCulled << " facing away; " << lastFrame.trianglesCulled
+         << " of " << lastFrame.triangles << " triangles culled (" << culledPercent << "%) in "
+         << lastFrame.cullMs << " ms" << endl;
+}
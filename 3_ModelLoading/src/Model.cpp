@@ -1,45 +1,494 @@
 #include "Model.hpp"
 
-void Model::Draw(Shader &shader)
+#include <chrono>
+#include <cmath>
+
+// Post-processing requested from Assimp. Part of the mesh cache key. SortByPType splits the
+// points and lines Triangulate leaves alone into meshes of their own, which processMesh drops.
+static const unsigned int IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_SortByPType | aiProcess_FlipUVs;
+// Below this many meshes the linear SIMD cull is faster than walking a tree
+static const size_t BVH_MIN_MESHES = 64;
+
+// models started with LoadAsync that still have meshes to upload
+vector<shared_ptr<Model>> Model::loading;
+bool Model::meshletCulling = true;
+bool Model::textureArrays = false;
+// 2% of a mesh's radius; part of the mesh cache key
+float Model::lodErrorBound = 0.02f;
+
+// Both Draws go through the model's own queue, so the meshes are batched into multi-draws
+// (indirect ones where supported) instead of one draw call each
+void Model::Draw(Shader &shader, const glm::mat4 &model)
 {
-    for(unsigned int i = 0; i < meshes.size(); i++)
-        meshes[i].Draw(shader);
+    drawQueue.Begin(glm::mat4(1.0f));
+    Submit(drawQueue, shader, model);
+    drawQueue.Flush();
+}
+
+void Model::Draw(Shader &shader, const glm::mat4 &model, const Frustum &frustum, const LodView &lod)
+{
+    drawQueue.Begin(glm::mat4(1.0f));
+    Submit(drawQueue, shader, model, frustum, lod);
+    drawQueue.Flush();
+}
+
+void Model::Submit(RenderQueue &queue, Shader &shader, const glm::mat4 &model)
+{
+    updateTransforms();
+    for(size_t i = 0; i < drawableNodes.size(); i++)
+        SubmitDrawable(i, queue, shader, model);
+}
+
+void Model::Submit(RenderQueue &queue, Shader &shader, const glm::mat4 &model, const Frustum &frustum,
+                   const LodView &lod)
+{
+    updateTransforms();
+    cullDrawables(model, frustum);
+    for(size_t i = 0; i < drawableNodes.size(); i++)
+        if(visible[i])
+            submitDrawable(i, queue, shader, model, &frustum, lod);
+}
+
+void Model::SubmitDrawable(size_t drawable, RenderQueue &queue, Shader &shader, const glm::mat4 &model,
+                           const LodView &lod)
+{
+    submitDrawable(drawable, queue, shader, model, nullptr, lod);
+}
+
+void Model::SubmitDrawable(size_t drawable, RenderQueue &queue, Shader &shader, const glm::mat4 &model,
+                           const Frustum &frustum, const LodView &lod)
+{
+    submitDrawable(drawable, queue, shader, model, &frustum, lod);
+}
+
+void Model::submitDrawable(size_t drawable, RenderQueue &queue, Shader &shader, const glm::mat4 &model,
+                           const Frustum *frustum, const LodView &lod)
+{
+    if(Mesh *mesh = drawableMesh(drawable))
+    {
+        unsigned int level = 0;
+        if(lod.projectionScale > 0.0f && mesh->LevelCount() > 1)
+            level = mesh->SelectLevel(lod, drawableBounds[drawable].Transformed(model));
+        glm::mat4 world = model * graph.World(drawableNodes[drawable]);
+        // meshlets only cover the full mesh; a mesh far enough away for a LOD is small on screen anyway
+        if(meshletCulling && frustum && level == 0 && mesh->meshlets.size() > 1)
+        {
+            // cone tests need the eye, which only a real LodView carries
+            glm::vec3 eye = glm::vec3(glm::inverse(world) * glm::vec4(lod.position, 1.0f));
+            mesh->SubmitMeshlets(queue, shader, world, frustum->Transformed(world),
+                                 lod.projectionScale > 0.0f ? &eye : nullptr);
+        }
+        else
+            mesh->Submit(queue, shader, world, level);
+    }
+}
+
+size_t Model::VertexBufferBytes() const
+{
+    size_t bytes = 0;
+    for(const Mesh &mesh : meshes)
+        bytes += mesh.VertexBufferBytes();
+    return bytes;
+}
+
+size_t Model::IndexBufferBytes() const
+{
+    size_t bytes = 0;
+    for(const Mesh &mesh : meshes)
+        bytes += mesh.IndexBufferBytes();
+    return bytes;
+}
+
+size_t Model::IndexBufferBytes32() const
+{
+    size_t bytes = 0;
+    for(const Mesh &mesh : meshes)
+        bytes += mesh.IndexBufferBytes32();
+    return bytes;
+}
+
+size_t Model::CpuBytes() const
+{
+    size_t bytes = 0;
+    for(const Mesh &mesh : meshes)
+        bytes += mesh.CpuBytes();
+    // imported but not uploaded yet
+    for(const MeshData &data : importedMeshes)
+    {
+        bytes += data.vertices.capacity() * sizeof(Vertex) + data.indices.capacity() * sizeof(unsigned int);
+        for(const MeshLod &lod : data.lods)
+            bytes += lod.indices.capacity() * sizeof(unsigned int);
+    }
+    return bytes;
+}
+
+void Model::PrintMemoryStats() const
+{
+    size_t meshesByWidth[3] = { 0, 0, 0 };
+    for(const Mesh &mesh : meshes)
+    {
+        size_t size = Mesh::IndexSize(mesh.IndexType());
+        meshesByWidth[size == 1 ? 0 : size == 2 ? 1 : 2]++;
+    }
+    cout << path << ": " << meshes.size() << " meshes, vertex buffers " << VertexBufferBytes() / 1024 << " KB, "
+         << "index buffers " << IndexBufferBytes32() / 1024 << " KB at 32 bits -> " << IndexBufferBytes() / 1024
+         << " KB (" << meshesByWidth[0] << " x 8-bit, " << meshesByWidth[1] << " x 16-bit, "
+         << meshesByWidth[2] << " x 32-bit)" << endl;
+    cout << "  CPU copies of the meshes: " << CpuBytes() / 1024 << " KB (" << (cpuData == CpuData::Keep ? "kept" : "dropped")
+         << " after upload)" << endl;
+    cout << "  " << (ownsGeometry ? "own" : "shared") << " geometry buffer: " << geometry->UsedBytes() / 1024 << " of "
+         << geometry->CapacityBytes() / 1024 << " KB used, regrown " << geometry->GrowCount() << " times" << endl;
+}
+
+Mesh *Model::drawableMesh(size_t drawable)
+{
+    uint32_t mesh = graph.MeshRefs()[drawable];
+    return mesh < meshes.size() ? &meshes[mesh] : nullptr;
+}
+
+void Model::cullDrawables(const glm::mat4 &model, const Frustum &frustum)
+{
+    // one transform of the six planes instead of one per drawable bound
+    Frustum local = frustum.Transformed(model);
+    if(!bvh.Empty())
+        bvh.Cull(local, visible);
+    else
+        culler.Cull(local, visible);
+}
+
+// Places every mesh reference of the graph in model space and sets up culling over them
+void Model::setupDrawables()
+{
+    graph.Update();
+    drawableNodes.clear();
+    drawableBounds.clear();
+    culler.Clear();
+    for(uint32_t node = 0; node < graph.NodeCount(); node++)
+    {
+        for(uint32_t i = 0; i < graph.MeshCount(node); i++)
+        {
+            uint32_t mesh = graph.MeshRefs()[graph.FirstMesh(node) + i];
+            Bounds bounds = mesh < meshBounds.size() ? meshBounds[mesh].Transformed(graph.World(node)) : Bounds();
+            drawableNodes.push_back(node);
+            drawableBounds.push_back(bounds);
+            culler.Add(bounds);
+        }
+    }
+    if(drawableBounds.size() < BVH_MIN_MESHES)
+        return;
+    bvh.Build(drawableBounds);
+    cout << "Built a " << bvh.NodeCount() << " node BVH over the " << drawableBounds.size() << " meshes of " << path
+         << " in " << bvh.BuildMs() << " ms" << endl;
+}
+
+// Recomputes the dirty subtrees of the graph and moves the bounds of the drawables they place
+void Model::updateTransforms()
+{
+    // no drawables yet means the import may still be filling the graph on a worker thread
+    if(drawableNodes.empty() || !graph.Dirty())
+        return;
+    graph.Update();
+    for(const pair<uint32_t, uint32_t> &range : graph.UpdatedRanges())
+    {
+        // drawables of consecutive nodes are consecutive
+        uint32_t first = graph.FirstMesh(range.first);
+        uint32_t end = graph.FirstMesh(range.second - 1) + graph.MeshCount(range.second - 1);
+        for(uint32_t i = first; i < end; i++)
+        {
+            uint32_t mesh = graph.MeshRefs()[i];
+            if(mesh >= meshBounds.size())
+                continue;
+            drawableBounds[i] = meshBounds[mesh].Transformed(graph.World(drawableNodes[i]));
+            culler.Set(i, drawableBounds[i]);
+        }
+    }
+    if(!bvh.Empty())
+        bvh.Refit(drawableBounds);
 }
 
 void Model::loadModel(string path)
 {
+    this->path = path;
+    importMeshes();
+    setupDrawables();
+    prefetchTextures();
+    reserveGeometry();
+    for(MeshData &data : importedMeshes)
+        uploadMesh(data);
+    cancelPrefetch();
+    importedMeshes.clear();
+    loaded = true;
+    PrintMemoryStats();
+}
+
+shared_ptr<Model> Model::LoadAsync(const string &path, VertexFormat format, shared_ptr<GeometryBuffer> geometry,
+                                   CpuData cpuData)
+{
+    shared_ptr<Model> model(new Model());
+    model->path = path;
+    model->vertexFormat = format;
+    model->cpuData = cpuData;
+    model->useGeometry(geometry);
+    // loading keeps the model alive until it is streamed in or deleted, and Delete waits for the task.
+    // The task itself must not hold a reference: its future would keep the model alive forever.
+    Model *importing = model.get();
+    model->importTask = ThreadPool::Shared().Submit([importing]() { importing->importMeshes(); });
+    loading.push_back(model);
+    return model;
+}
+
+void Model::UploadPending(double budgetMs)
+{
+    auto deadline = chrono::steady_clock::now() +
+                    chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double, milli>(budgetMs));
+    for(unsigned int i = 0; i < loading.size();)
+    {
+        if(loading[i]->uploadSlice(deadline))
+            loading.erase(loading.begin() + i);
+        else
+            i++;
+        if(chrono::steady_clock::now() >= deadline)
+            break;
+    }
+}
+
+// Uploads as many of the imported meshes as fit before deadline. Returns true once the model is complete.
+bool Model::uploadSlice(chrono::steady_clock::time_point deadline)
+{
+    if(!imported)
+    {
+        if(importTask.wait_for(chrono::seconds(0)) != future_status::ready)
+            return false;
+        importTask.get();
+        imported = true;
+        setupDrawables();
+        prefetchTextures();
+        reserveGeometry();
+    }
+    streamedFrames++;
+
+    while(nextUpload < importedMeshes.size() && chrono::steady_clock::now() < deadline)
+    {
+        MeshData &data = importedMeshes[nextUpload];
+        // never block the frame on a decode: try again next frame
+        for(const TextureRef &ref : data.textures)
+            if(!TextureCache::Instance().IsReady(ref.path))
+                return false;
+
+        auto start = chrono::steady_clock::now();
+        uploadMesh(data);
+        data = MeshData();
+        nextUpload++;
+        slowestUploadMs = max(slowestUploadMs,
+                              chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+    }
+    if(nextUpload < importedMeshes.size())
+        return false;
+
+    cancelPrefetch();
+    importedMeshes.clear();
+    loaded = true;
+    cout << "Streamed " << path << " to the GPU over " << streamedFrames << " frames (slowest mesh upload "
+         << slowestUploadMs << " ms)" << endl;
+    PrintMemoryStats();
+    return true;
+}
+
+// CPU half of loading: fills importedMeshes and the graph from the mesh cache or Assimp. Never touches GL,
+// so LoadAsync runs it on a worker thread.
+void Model::importMeshes()
+{
+    directory = "";
+    auto start = chrono::steady_clock::now();
+
+    // Warm start: copy the meshes straight out of the mapped cache file
+    MeshCache cache(path, IMPORT_FLAGS, importLodErrorBound);
+    if(cache.Read())
+    {
+        for(const CachedMeshView &view : cache.Meshes())
+        {
+            MeshData data;
+            data.vertices.assign(view.vertices, view.vertices + view.vertexCount);
+            data.indices.assign(view.indices, view.indices + view.indexCount);
+            for(const CachedLodView &lodView : view.lods)
+            {
+                MeshLod lod;
+                lod.indices.assign(lodView.indices, lodView.indices + lodView.indexCount);
+                lod.error = lodView.error;
+                data.lods.push_back(std::move(lod));
+            }
+            data.meshlets.assign(view.meshlets, view.meshlets + view.meshletCount);
+            data.textures = view.textures;
+            data.bounds = computeBounds(data.vertices);
+            meshBounds.push_back(data.bounds);
+            importedMeshes.push_back(std::move(data));
+        }
+        graph = cache.Graph();
+        double warmMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        cout << "Loaded " << path << " from mesh cache in " << warmMs << " ms (cold import took "
+             << cache.ColdImportMs() << " ms)" << endl;
+        return;
+    }
+
     Assimp::Importer import;
-    const aiScene *scene = import.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+    const aiScene *scene = import.ReadFile(path, IMPORT_FLAGS);
     
     if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
     {
         cout << "ERROR::ASSIMP::" << import.GetErrorString() << endl;
         return;
     }
-    directory = "";
 
-    processNode(scene->mRootNode, scene);
+    // every mesh once, in scene order: nodes refer to them by index
+    for(unsigned int i = 0; i < scene->mNumMeshes; i++)
+    {
+        MeshData data = processMesh(scene->mMeshes[i], scene);
+        // weld and reorder once here; the cache then hands out the optimized mesh
+        MeshOptimizeReport report = MeshOptimizer::Optimize(data);
+        cout << "Mesh " << i << ": " << report.verticesBefore << " -> " << report.verticesAfter << " vertices, ACMR "
+             << report.acmrBefore << " -> " << report.acmrAfter << ", ATVR " << report.atvrBefore << " -> "
+             << report.atvrAfter << " (" << report.ms << " ms)" << endl;
+        if(importLodErrorBound > 0.0f)
+        {
+            data.lods = MeshSimplifier::BuildLods(data, importLodErrorBound);
+            cout << "  LODs: " << data.indices.size() / 3;
+            for(const MeshLod &lod : data.lods)
+                cout << " -> " << lod.indices.size() / 3 << " (error " << lod.error << ")";
+            cout << " triangles" << endl;
+        }
+        // after the optimizer: meshlets are ranges of the final index order
+        data.meshlets = MeshletBuilder::Build(data.vertices, data.indices);
+        cout << "  Meshlets: " << data.meshlets.size() << endl;
+        meshBounds.push_back(data.bounds);
+        importedMeshes.push_back(std::move(data));
+    }
+    processNode(scene->mRootNode, SceneGraph::NO_NODE);
+
+    double coldMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    cout << "Imported " << path << " with Assimp in " << coldMs << " ms" << endl;
+    if(!cache.Write(importedMeshes, graph, coldMs))
+        cout << "ERROR::MESHCACHE::Failed to write " << cache.CachePath() << endl;
 }
 
-void Model::processNode(aiNode *node, const aiScene *scene)
+// Diffuse maps hold sRGB color; specular, normal and height maps hold data and keep their mips as stored
+static bool isColor(const string &type)
 {
-    // process all the node's meshes (if any)
-    for(unsigned int i = 0; i < node->mNumMeshes; i++)
+    return type == "texture_diffuse";
+}
+
+// Starts decoding every texture the imported meshes use on the thread pool, so the
+// images are ready (or close to it) by the time uploadMesh asks for them
+void Model::prefetchTextures()
+{
+    vector<string> colorPaths, dataPaths;
+    for(const MeshData &data : importedMeshes)
+        for(const TextureRef &ref : data.textures)
+            (isColor(ref.type) ? colorPaths : dataPaths).push_back(ref.path);
+    TextureCache::Instance().Prefetch(colorPaths, true);
+    TextureCache::Instance().Prefetch(dataPaths, false);
+    prefetchedPaths = colorPaths;
+    prefetchedPaths.insert(prefetchedPaths.end(), dataPaths.begin(), dataPaths.end());
+}
+
+// Only this model's paths: other models may still be streaming theirs
+void Model::cancelPrefetch()
+{
+    TextureCache::Instance().CancelPrefetch(prefetchedPaths);
+    prefetchedPaths.clear();
+}
+
+void Model::useGeometry(shared_ptr<GeometryBuffer> shared)
+{
+    if(shared && shared->Format() != vertexFormat)
+    {
+        cout << "ERROR::MODEL::Geometry buffer has a different vertex format, the model gets its own" << endl;
+        shared = nullptr;
+    }
+    ownsGeometry = !shared;
+    geometry = shared ? shared : make_shared<GeometryBuffer>(vertexFormat);
+}
+
+void Model::reserveGeometry()
+{
+    size_t vertexCount = 0, indexBytes = 0;
+    for(unsigned int i = 0; i < importedMeshes.size(); i++)
+        positionBox = i == 0 ? importedMeshes[i].bounds : Bounds::Merge(positionBox, importedMeshes[i].bounds);
+    for(const MeshData &data : importedMeshes)
     {
-        aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
-        meshes.push_back(processMesh(mesh, scene));
+        vertexCount += data.vertices.size();
+        size_t indexCount = data.indices.size();
+        for(const MeshLod &lod : data.lods)
+            indexCount += lod.indices.size();
+        // plus the worst case padding of the range to 4 bytes
+        indexBytes += indexCount * Mesh::IndexSize(Mesh::IndexTypeFor(data.vertices.size())) + 3;
     }
+    geometry->Reserve(vertexCount, indexBytes);
+}
+
+// GL half of loading: resolves the mesh's textures and uploads its buffers. The mesh takes data's arrays.
+void Model::uploadMesh(MeshData &data)
+{
+    ArrayMaterial arrayMaterial;
+    bool layered = false;
+    if(textureArrays && !data.textures.empty())
+    {
+        vector<string> paths, types;
+        vector<bool> srgb;
+        for(const TextureRef &ref : data.textures)
+        {
+            paths.push_back(ref.path);
+            types.push_back(ref.type);
+            srgb.push_back(isColor(ref.type));
+        }
+        // falls back to plain textures if an image cannot go into an array
+        layered = TextureArrays::Instance().Acquire(paths, srgb, Mesh::SamplerNames(types), arrayMaterial);
+    }
+    vector<Texture> textures;
+    if(!layered)
+        for(const TextureRef &ref : data.textures)
+            textures.push_back(loadTexture(ref.path, ref.type));
+    meshes.emplace_back(std::move(data.vertices), std::move(data.indices), std::move(textures), vertexFormat,
+                        geometry.get(), std::move(data.lods), &positionBox);
+    if(layered)
+    {
+        meshes.back().UseTextureArrays(arrayMaterial);
+        arrayMaterials.push_back(arrayMaterial);
+    }
+    meshes.back().bounds = data.bounds;
+    meshes.back().meshlets = std::move(data.meshlets);
+    if(cpuData == CpuData::Drop)
+        meshes.back().ReleaseCpuData();
+}
+
+// aiMatrix4x4 is row major, glm is column major
+static glm::mat4 toGlm(const aiMatrix4x4 &from)
+{
+    glm::mat4 to;
+    to[0][0] = from.a1; to[1][0] = from.a2; to[2][0] = from.a3; to[3][0] = from.a4;
+    to[0][1] = from.b1; to[1][1] = from.b2; to[2][1] = from.b3; to[3][1] = from.b4;
+    to[0][2] = from.c1; to[1][2] = from.c2; to[2][2] = from.c3; to[3][2] = from.c4;
+    to[0][3] = from.d1; to[1][3] = from.d2; to[2][3] = from.d3; to[3][3] = from.d4;
+    return to;
+}
+
+// Mirrors the aiNode tree into the graph, depth first, keeping each node's transform and meshes
+void Model::processNode(aiNode *node, uint32_t parent)
+{
+    uint32_t index = graph.AddNode(parent, toGlm(node->mTransformation), node->mName.C_Str());
+    for(unsigned int i = 0; i < node->mNumMeshes; i++)
+        graph.AddMesh(index, node->mMeshes[i]);
     // then do the same for each of its children
     for(unsigned int i = 0; i < node->mNumChildren; i++)
     {
-        processNode(node->mChildren[i], scene);
+        processNode(node->mChildren[i], index);
     }
 }
-Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene)
+MeshData Model::processMesh(aiMesh *mesh, const aiScene *scene)
 {
-    vector<Vertex> vertices;
-    vector<unsigned int> indices;
-    vector<Texture> textures;
+    MeshData data;
+    vector<Vertex> &vertices = data.vertices;
+    vector<unsigned int> &indices = data.indices;
+    vector<TextureRef> &textures = data.textures;
 
     for(unsigned int i = 0; i < mesh->mNumVertices; i++)
     {
@@ -71,86 +520,115 @@ Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene)
     for(unsigned int i = 0; i < mesh->mNumFaces; i++)
     {
         aiFace face = mesh->mFaces[i];
+        // points and lines: every pass after this one works on triangles
+        if(face.mNumIndices != 3)
+            continue;
         for(unsigned int j = 0; j < face.mNumIndices; j++)
             indices.push_back(face.mIndices[j]);
     }
+    data.bounds = computeBounds(vertices);
     if(mesh->mMaterialIndex >= 0)
     {
         aiMaterial *material = scene->mMaterials[mesh->mMaterialIndex];
-        vector<Texture> diffuseMaps = loadMaterialTextures(material,
+        vector<TextureRef> diffuseMaps = loadMaterialTextures(material,
                                             aiTextureType_DIFFUSE, "texture_diffuse");
         textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-        vector<Texture> specularMaps = loadMaterialTextures(material,
+        vector<TextureRef> specularMaps = loadMaterialTextures(material,
                                             aiTextureType_SPECULAR, "texture_specular");
         textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
     }
 
-    return Mesh(vertices, indices, textures);
+    return data;
 }
 
-vector<Texture> Model::loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+// Box around the vertices, and the sphere around the box center that reaches the farthest vertex
+Bounds Model::computeBounds(const vector<Vertex> &vertices)
 {
-    vector<Texture> textures;
+    Bounds bounds;
+    if(vertices.empty())
+        return bounds;
+
+    bounds.min = bounds.max = vertices[0].Position;
+    for(const Vertex &vertex : vertices)
+    {
+        bounds.min = glm::min(bounds.min, vertex.Position);
+        bounds.max = glm::max(bounds.max, vertex.Position);
+    }
+    bounds.center = (bounds.min + bounds.max) * 0.5f;
+    float radiusSquared = 0.0f;
+    for(const Vertex &vertex : vertices)
+    {
+        glm::vec3 offset = vertex.Position - bounds.center;
+        radiusSquared = max(radiusSquared, glm::dot(offset, offset));
+    }
+    bounds.radius = sqrt(radiusSquared);
+    return bounds;
+}
+
+vector<TextureRef> Model::loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+{
+    vector<TextureRef> textures;
     for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
     {
         aiString str;
         mat->GetTexture(type, i, &str);
-        bool skip = false;
-        for(unsigned int j = 0; j < textures_loaded.size(); j++)
-        {
-            if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-            {
-                skip = true;
-                break;
-            }
-        }
-        if(!skip)
-        {   // if texture hasn't been loaded already, load it
-            Texture texture;
-            texture.id = TextureFromFile(str.C_Str(), directory);
-            texture.type = typeName;
-            texture.path = str.C_Str();
-            textures.push_back(texture);
-            textures_loaded.push_back(texture); // add to loaded textures
-        }
+        textures.push_back({ typeName, str.C_Str() });
     }
     return textures;
 }
+// Looks the texture up in the process-wide cache, which only decodes and uploads it the first time
+Texture Model::loadTexture(const string &path, const string &typeName)
+{
+    Texture texture;
+    texture.id = TextureFromFile(path.c_str(), directory, isColor(typeName));
+    texture.type = typeName;
+    texture.path = path;
+    textures_loaded.push_back(texture); // every entry holds one cache reference, given back in Delete
+    return texture;
+}
 
 unsigned int Model::TextureFromFile(const char *path, const string &directory, bool gamma) {
     string filename = string(path);
+    return TextureCache::Instance().Acquire(filename, gamma);
+}
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
+void Model::Delete()
+{
+    // stop streaming first: the import may still be running on the thread pool
+    if(importTask.valid())
     {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
+        importTask.wait();
+        importTask = future<void>();
     }
-    else
+    for(unsigned int i = 0; i < loading.size(); i++)
     {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        if(loading[i].get() == this)
+        {
+            loading.erase(loading.begin() + i);
+            break;
+        }
     }
+    cancelPrefetch();
+    importedMeshes.clear();
 
-    return textureID;
+    for(unsigned int i = 0; i < meshes.size(); i++)
+        meshes[i].Delete();
+    // meshes gave their ranges of a shared buffer back above
+    if(ownsGeometry)
+        geometry->Delete();
+    drawQueue.Delete();
+    for(unsigned int i = 0; i < textures_loaded.size(); i++)
+        TextureCache::Instance().Release(textures_loaded[i].id);
+    for(unsigned int i = 0; i < arrayMaterials.size(); i++)
+        TextureArrays::Instance().Release(arrayMaterials[i]);
+    meshes.clear();
+    textures_loaded.clear();
+    arrayMaterials.clear();
+    graph.Clear();
+    meshBounds.clear();
+    drawableNodes.clear();
+    drawableBounds.clear();
+    culler.Clear();
+    bvh.Clear();
+    visible.clear();
 }
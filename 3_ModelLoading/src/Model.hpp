@@ -6,29 +6,183 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include <chrono>
+#include <future>
+#include <memory>
+
+#include "BVH.hpp"
+#include "Frustum.hpp"
+#include "GeometryBuffer.hpp"
+#include "LodView.hpp"
 #include "Mesh.hpp"
+#include "MeshCache.hpp"
+#include "MeshletBuilder.hpp"
+#include "MeshOptimizer.hpp"
+#include "MeshSimplifier.hpp"
+#include "SceneGraph.hpp"
+#include "TextureArrays.hpp"
+#include "TextureCache.hpp"
+#include "ThreadPool.hpp"
 #include "stb_image.h"
 using namespace std;
 
+// What a model does with its meshes' vertices and indices once they are on the GPU
+enum class CpuData {
+    Drop,  // freed, drawing needs only the GPU copy
+    Keep   // kept in Mesh::vertices / indices for CPU-side queries (picking, physics)
+};
+
 class Model
 {
     public:
-        Model(char *path)
+        // All meshes of a model go into one geometry buffer. Pass one to share it between models
+        // (of the same vertex format); otherwise the model makes its own.
+        Model(char *path, VertexFormat format = VertexFormat::Float, shared_ptr<GeometryBuffer> geometry = nullptr,
+              CpuData cpuData = CpuData::Drop)
+            : vertexFormat(format), cpuData(cpuData)
         {
+            useGeometry(geometry);
             loadModel(path);
         }
-        void Draw(Shader &shader);
+        // Starts loading path in the background and returns right away. The model draws
+        // whatever meshes UploadPending has streamed to the GPU so far.
+        // Compact meshes need a vertex shader that decodes CompactVertex (see Mesh.hpp).
+        static shared_ptr<Model> LoadAsync(const string &path, VertexFormat format = VertexFormat::Float,
+                                           shared_ptr<GeometryBuffer> geometry = nullptr,
+                                           CpuData cpuData = CpuData::Drop);
+        // Uploads meshes and textures of models started with LoadAsync until budgetMs is spent.
+        // Call once per frame from the GL thread.
+        static void UploadPending(double budgetMs);
+        // True once every mesh is on the GPU
+        bool IsLoaded() const { return loaded; }
+
+        // Draws every uploaded mesh where its node places it, setting "model" to model * node world
+        void Draw(Shader &shader, const glm::mat4 &model);
+        // Draws only the meshes whose bounds, placed with model, reach into frustum, each at the
+        // level of detail lod picks for its size on screen (the full mesh when lod is left default)
+        void Draw(Shader &shader, const glm::mat4 &model, const Frustum &frustum, const LodView &lod = LodView());
+        // Queues every uploaded mesh with model * its node's world transform
+        void Submit(RenderQueue &queue, Shader &shader, const glm::mat4 &model);
+        // Queues the meshes that survive frustum culling, at the level lod picks. Meshes drawn in full
+        // are culled again meshlet by meshlet: against frustum, and against lod's eye for back-facing
+        // meshlets when lod is set.
+        void Submit(RenderQueue &queue, Shader &shader, const glm::mat4 &model, const Frustum &frustum,
+                    const LodView &lod = LodView());
+
+        // The imported node hierarchy, complete once the import is done (see DrawableCount). Move
+        // sub-parts with Graph().SetLocal; the next Draw or Submit updates the dirty subtrees and their bounds.
+        SceneGraph &Graph() { return graph; }
+
+        // A drawable is one mesh placed by one node (a mesh can be placed more than once).
+        // 0 until the import is done.
+        size_t DrawableCount() const { return drawableNodes.size(); }
+        // Bounds of a drawable in model space
+        const Bounds &DrawableBounds(size_t drawable) const { return drawableBounds[drawable]; }
+        void SubmitDrawable(size_t drawable, RenderQueue &queue, Shader &shader, const glm::mat4 &model,
+                            const LodView &lod = LodView());
+        // The same for a drawable already found inside frustum (world space), whose meshlets are then
+        // culled against it like Submit with a frustum does
+        void SubmitDrawable(size_t drawable, RenderQueue &queue, Shader &shader, const glm::mat4 &model,
+                            const Frustum &frustum, const LodView &lod = LodView());
+        // Largest error (relative to a mesh's bounding radius) LOD generation may introduce, for models
+        // created from now on. 0 imports no LODs.
+        static void SetLodErrorBound(float bound) { lodErrorBound = bound; }
+        // Turns the per meshlet cull of Submit with a frustum on or off (on by default)
+        static void SetMeshletCulling(bool enabled) { meshletCulling = enabled; }
+        static bool MeshletCulling() { return meshletCulling; }
+        // Puts the textures of meshes uploaded from now on into texture array pools (see TextureArrays),
+        // so that meshes with different materials batch into one draw. Off by default: the model then
+        // needs a shader that samples sampler2DArrays at the layer attribute (see Mesh::UseTextureArrays).
+        static void SetTextureArrays(bool enabled) { textureArrays = enabled; }
+        static bool TextureArraysEnabled() { return textureArrays; }
+        // Vertex buffer memory of the uploaded meshes
+        size_t VertexBufferBytes() const;
+        // Index buffer memory of the uploaded meshes, and what it would be with 32-bit indices everywhere
+        size_t IndexBufferBytes() const;
+        size_t IndexBufferBytes32() const;
+        // Mesh data resident on the CPU: the meshes' kept arrays plus anything not uploaded yet
+        size_t CpuBytes() const;
+        // Prints the vertex and index buffer memory, how many meshes use each index width
+        // and the CPU memory still held
+        void PrintMemoryStats() const;
+        const GeometryBuffer &Geometry() const { return *geometry; }
+        // Draw calls and submit time of the Draws in the last frame closed by FrameCounters::EndFrame
+        const RenderQueueStats &DrawStats() const { return drawQueue.Stats(); }
+        // Deletes the meshes and gives the model's textures back to the texture cache and texture arrays.
+        // Ranges in a shared geometry buffer are given back to it; the buffer is left to whoever created it.
+        void Delete();
     private:
         // model data
         vector<Mesh> meshes;
         vector<Texture> textures_loaded; 
+        // layers held in texture array pools, given back in Delete
+        vector<ArrayMaterial> arrayMaterials;
         string directory;
+        string path;
+        VertexFormat vertexFormat = VertexFormat::Float;
+        CpuData cpuData = CpuData::Drop;
+        shared_ptr<GeometryBuffer> geometry;
+        bool ownsGeometry = false;
+        // box around every mesh that Compact meshes quantize in, so they share one position decode and
+        // their draws merge
+        Bounds positionBox;
+        // node hierarchy and the local space bounds of every imported mesh, both filled by the import
+        SceneGraph graph;
+        vector<Bounds> meshBounds;
+        // per drawable: owning node, model space bounds, and the result of the last cull
+        vector<uint32_t> drawableNodes;
+        vector<Bounds> drawableBounds;
+        FrustumCuller culler;
+        vector<uint8_t> visible;
+        // built after the import for models with enough drawables to beat the linear pass
+        BVH bvh;
+        // what Draw batches the visible meshes through
+        RenderQueue drawQueue;
+
+        // loading state: meshes imported on the CPU but not uploaded yet
+        vector<MeshData> importedMeshes;
+        vector<string> prefetchedPaths;     // given back to TextureCache once the meshes are uploaded
+        size_t nextUpload = 0;
+        future<void> importTask;
+        bool imported = false;
+        bool loaded = false;
+        unsigned int streamedFrames = 0;
+        double slowestUploadMs = 0.0;
+        static vector<shared_ptr<Model>> loading;
+        static float lodErrorBound;
+        // lodErrorBound when the model was created: the import reads this copy, possibly on a worker
+        // thread, while SetLodErrorBound may change the static on the GL thread
+        float importLodErrorBound = lodErrorBound;
+        static bool meshletCulling;
+        static bool textureArrays;
 
+        Model() {}
         void loadModel(string path);
-        void processNode(aiNode *node, const aiScene *scene);
-        Mesh processMesh(aiMesh *mesh, const aiScene *scene);
-        vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type,
-                                             string typeName);
+        bool uploadSlice(chrono::steady_clock::time_point deadline);
+        void importMeshes();
+        void prefetchTextures();
+        // Frees whatever this model prefetched and never acquired
+        void cancelPrefetch();
+        void useGeometry(shared_ptr<GeometryBuffer> shared);
+        // Grows the geometry buffer once to fit every imported mesh, instead of while streaming them in,
+        // and fits positionBox around them
+        void reserveGeometry();
+        void uploadMesh(MeshData &data);
+        void setupDrawables();
+        void updateTransforms();
+        // SubmitDrawable, culling the mesh's meshlets when there is a frustum
+        void submitDrawable(size_t drawable, RenderQueue &queue, Shader &shader, const glm::mat4 &model,
+                            const Frustum *frustum, const LodView &lod);
+        void cullDrawables(const glm::mat4 &model, const Frustum &frustum);
+        // Uploaded mesh of a drawable, nullptr while it is still streaming in
+        Mesh *drawableMesh(size_t drawable);
+        void processNode(aiNode *node, uint32_t parent);
+        MeshData processMesh(aiMesh *mesh, const aiScene *scene);
+        static Bounds computeBounds(const vector<Vertex> &vertices);
+        vector<TextureRef> loadMaterialTextures(aiMaterial *mat, aiTextureType type,
+                                                string typeName);
+        Texture loadTexture(const string &path, const string &typeName);
+        // gamma: the image is sRGB color, so its mips are filtered in linear light
         unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
 
 };
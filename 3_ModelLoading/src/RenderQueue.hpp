@@ -0,0 +1,184 @@
+#ifndef RENDERQUEUE_HPP
+#define RENDERQUEUE_HPP
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "FrameCounter.hpp"
+#include "Shader.hpp"
+
+using namespace std;
+// --------------------- Render Queue --------------------- //
+/*
+    Collects the draws of a frame instead of issuing them on the spot, then
+    submits them in the order that changes the least GL state. Every draw gets
+    a 64-bit key, most significant bits first:
+
+        pass (2) | shader (10) | material (16) | VAO (16) | depth (20)
+
+    so a radix sort on the key groups draws by program, then by the textures
+    they bind, then by vertex array. Opaque draws sort front to back within a
+    group; transparent ones go last and back to front.
+
+    Materials are the set of textures a draw binds plus the sampler uniform
+    each one feeds. They are registered once (RegisterMaterial) and referred to
+    by a small id so they fit in the key. Registrations are counted: every
+    RegisterMaterial is paired with a ReleaseMaterial, and the id of a material
+    nobody holds any more is handed out again, so ids stay as small as the
+    number of live materials.
+
+    A material of texture arrays (see TextureArrays) is shared by every mesh
+    whose textures sit in the same arrays; each draw says which layer is its
+    own. The shader reads the layer from attribute LAYER_ATTRIBUTE, so draws
+    of different layers still share a material and sort next to each other.
+
+    After sorting, indexed draws that share everything but their index range
+    (meshes of one geometry buffer placed with the same matrix) end up next to
+    each other and go out as a single glMultiDrawElementsBaseVertex. With GL
+    4.3 or ARB_multi_draw_indirect the ranges of every such run are written to
+    one draw indirect buffer per flush instead, and each run is a
+    glMultiDrawElementsIndirect reading its slice of it. Where base instances
+    work too (GL 4.2 or ARB_base_instance), every command's base instance is
+    its own index into a buffer of layers, read as an instanced attribute,
+    so draws on different layers merge as well. Otherwise the layer is set
+    as a constant attribute value between draws, and only draws on the same
+    layer merge.
+
+    The queue counts program, material and VAO changes both in submission order
+    and in sorted order, so the saving can be read off directly.
+*/
+
+struct RenderQueueStats {
+    unsigned int draws = 0;
+    unsigned long triangles = 0;
+    // GL draw calls issued for them, after merging
+    unsigned int drawCalls = 0;
+    // [0] in the order draws were submitted, [1] in the sorted order actually issued
+    unsigned int shaderChanges[2] = { 0, 0 };
+    unsigned int materialChanges[2] = { 0, 0 };
+    unsigned int vaoChanges[2] = { 0, 0 };
+    // draws that pick their textures from an array layer
+    unsigned int layeredDraws = 0;
+    // CPU time spent issuing the sorted draws, and whether it went through the indirect path
+    double submitMs = 0.0;
+    bool indirect = false;
+};
+
+// Layout glMultiDrawElementsIndirect reads from the draw indirect buffer
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint  baseVertex;
+    GLuint baseInstance;
+};
+
+class RenderQueue {
+    public:
+        // Vertex attribute the layer of an array material is passed in (an unsigned int)
+        static const GLuint LAYER_ATTRIBUTE = 3;
+
+        // Returns the id of the material binding textures[i] (of target) to unit i and setting samplers[i]
+        // to i. Identical texture/sampler sets share one id, counted once per registration.
+        static unsigned int RegisterMaterial(const vector<unsigned int> &textures, const vector<string> &samplers,
+                                             GLenum target = GL_TEXTURE_2D);
+        // Drops one registration of a material; its id is reused once the last one is gone
+        static void ReleaseMaterial(unsigned int materialId);
+        // Points a material at new texture objects, for arrays that were reallocated to grow
+        static void ReplaceTextures(unsigned int materialId, const vector<unsigned int> &textures);
+        // Binds a material's textures and sets its samplers on shader, for drawing outside a queue
+        static void BindMaterial(Shader &shader, unsigned int materialId);
+
+        // Whether the context can draw indirect, and whether queues should when it can (the default)
+        static bool IndirectSupported();
+        static void SetIndirect(bool enabled);
+        static bool IndirectActive();
+        // Whether draws on different array layers can merge into one call: indirect draws with base instances
+        static bool LayerMergingActive();
+
+        // Starts collecting draws seen through view. depthRange is the distance mapped onto the key's depth bits.
+        void Begin(const glm::mat4 &view, float depthRange = 100.0f);
+        // Queues a glDrawArrays (indexType == 0) or glDrawElementsBaseVertex draw of vao with model as the
+        // "model" uniform. indexOffset is in bytes. layer only matters for materials of texture arrays.
+        void Submit(Shader &shader, unsigned int vao, unsigned int materialId, const glm::mat4 &model,
+                    GLenum mode, GLsizei count, GLenum indexType = 0, bool transparent = false,
+                    size_t indexOffset = 0, GLint baseVertex = 0, unsigned int layer = 0);
+        // Sorts the queued draws, issues them and empties the queue
+        void Flush();
+        // Deletes the draw indirect and layer buffers
+        void Delete();
+
+        // Counts of every flush in the last frame closed by FrameCounters::EndFrame
+        const RenderQueueStats &Stats() const { return frame.LastFrame(); }
+        void PrintStats() const;
+
+    private:
+        struct Material {
+            vector<unsigned int> textures;
+            vector<string> samplers;
+            GLenum target;
+            // registrations not yet released; 0 for a free slot
+            unsigned int references = 0;
+        };
+        struct DrawItem {
+            Shader *shader;
+            unsigned int vao;
+            unsigned int materialId;
+            GLenum mode;
+            GLsizei count;
+            GLenum indexType;
+            size_t indexOffset;
+            GLint baseVertex;
+            unsigned int layer;
+            glm::mat4 model;
+        };
+
+        static vector<Material> materials;
+        static unordered_map<string, unsigned int> materialIds;
+        // ids of released materials, handed out again before new ones
+        static vector<unsigned int> freeMaterialIds;
+        static bool indirectEnabled;
+
+        glm::mat4 view = glm::mat4(1.0f);
+        float depthRange = 100.0f;
+        vector<DrawItem> items;
+        vector<uint64_t> keys;
+        // radix sort buffers: key and item index per entry
+        vector<uint64_t> sortKeys, sortScratchKeys;
+        vector<uint32_t> order, scratchOrder;
+        // consecutive entries of order drawn with one call: order[first, end)
+        struct Run {
+            uint32_t first;
+            uint32_t end;
+        };
+        vector<Run> runs;
+        vector<DrawElementsIndirectCommand> commands;
+        GLuint indirectBuffer = 0;
+        // layer of every command, read through its base instance
+        vector<GLuint> commandLayers;
+        GLuint layerBuffer = 0;
+        // arguments of the multi-draw being assembled
+        vector<GLsizei> batchCounts;
+        vector<const void *> batchOffsets;
+        vector<GLint> batchBaseVertices;
+
+        FrameCounter<RenderQueueStats> frame;
+
+        uint64_t makeKey(const DrawItem &item, bool transparent) const;
+        void radixSort();
+        // Counts the state changes walking the items in the given order into slot of the stats
+        void countStateChanges(const vector<uint32_t> &sequence, int slot);
+        // Writes the commands of every indexed run, in run order, to the draw indirect buffer, and
+        // their layers to the layer buffer when layers are read per command
+        void uploadCommands(bool perCommandLayers);
+        static bool layered(const DrawItem &item);
+        // True when b can go into the same multi-draw as a
+        static bool mergeable(const DrawItem &a, const DrawItem &b, bool mergeLayers);
+};
+
+#endif /* RenderQueue_hpp */
@@ -0,0 +1,66 @@
+#include "SceneBVH.hpp"
+
+void SceneBVH::Add(Model &model, const glm::mat4 &transform)
+{
+    if (!model.IsLoaded())
+    {
+        pending.push_back({ &model, transform });
+        return;
+    }
+    addLoaded(model, transform);
+}
+
+void SceneBVH::addLoaded(Model &model, const glm::mat4 &transform)
+{
+    for (size_t i = 0; i < model.DrawableCount(); i++)
+    {
+        entries.push_back({ &model, i, transform });
+        bounds.push_back(model.DrawableBounds(i).Transformed(transform));
+    }
+    built = false;
+}
+
+void SceneBVH::addPending()
+{
+    size_t kept = 0;
+    for (const Placement &placement : pending)
+    {
+        if (placement.model->IsLoaded())
+            addLoaded(*placement.model, placement.transform);
+        else
+            pending[kept++] = placement;
+    }
+    pending.resize(kept);
+}
+
+void SceneBVH::Build()
+{
+    addPending();
+    bvh.Build(bounds);
+    built = true;
+}
+
+void SceneBVH::Clear()
+{
+    entries.clear();
+    pending.clear();
+    bounds.clear();
+    visible.clear();
+    bvh.Clear();
+    built = false;
+}
+
+void SceneBVH::Submit(RenderQueue &queue, Shader &shader, const Frustum &frustum, const LodView &lod)
+{
+    addPending();
+    if (!built)
+        Build();
+    bvh.Cull(frustum, visible);
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        if (!visible[i])
+            continue;
+        const Entry &entry = entries[i];
+        entry.model->SubmitDrawable(entry.drawable, queue, shader, entry.transform, frustum, lod);
+    }
+}
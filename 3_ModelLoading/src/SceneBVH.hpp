@@ -0,0 +1,66 @@
+#ifndef SCENEBVH_HPP
+#define SCENEBVH_HPP
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "BVH.hpp"
+#include "Model.hpp"
+#include "RenderQueue.hpp"
+
+using namespace std;
+// --------------------- Scene BVH --------------------- //
+/*
+    One BVH over the meshes of several placed models, for static scenes where
+    a per-model tree would still leave a linear pass over the models. Every
+    mesh goes in with its bounds moved into world space, so the tree is culled
+    with the camera's frustum as is.
+
+    A model still streaming in (Model::LoadAsync) is held back when it is
+    added and goes into the tree with the first Submit after it is loaded;
+    the tree is rebuilt then. Models and their sub-parts stay where they were
+    added: moving one means Clear and rebuild.
+
+    Submit hands every visible drawable to Model with the frustum and the
+    LodView, so the meshlet cull and the LOD pick work as in Model::Submit.
+*/
+
+class SceneBVH {
+    public:
+        // Adds every drawable of model placed with transform, or holds the model back until it is loaded
+        void Add(Model &model, const glm::mat4 &transform);
+        // Builds the tree over everything loaded so far
+        void Build();
+        void Clear();
+
+        // Queues the meshes inside the world space frustum, at the level lod picks
+        void Submit(RenderQueue &queue, Shader &shader, const Frustum &frustum, const LodView &lod = LodView());
+
+        const BVH &Tree() const { return bvh; }
+        // Placements still waiting for their model to load
+        size_t PendingCount() const { return pending.size(); }
+
+    private:
+        struct Entry {
+            Model *model;
+            size_t drawable;
+            glm::mat4 transform;
+        };
+        struct Placement {
+            Model *model;
+            glm::mat4 transform;
+        };
+        vector<Entry> entries;
+        vector<Placement> pending;
+        bool built = false;
+        vector<Bounds> bounds;
+        vector<uint8_t> visible;
+        BVH bvh;
+
+        void addLoaded(Model &model, const glm::mat4 &transform);
+        // Moves the pending placements whose model has finished loading into the scene
+        void addPending();
+};
+
+#endif /* SceneBVH_hpp */
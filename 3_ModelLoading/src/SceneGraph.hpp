@@ -0,0 +1,85 @@
+#ifndef SCENEGRAPH_HPP
+#define SCENEGRAPH_HPP
+
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+using namespace std;
+// --------------------- Scene Graph --------------------- //
+/*
+    Node hierarchy of a model, as imported from the aiNode tree: every node
+    has a local transform, a world transform (parent world * local) and the
+    meshes it places. Everything is kept in parallel arrays indexed by node.
+
+    Nodes are stored depth first, the order processNode walks the aiNode
+    tree, so a parent always comes before its children and every subtree is
+    one contiguous range of nodes. Updating a subtree is then a single
+    forward loop over that range.
+
+    SetLocal only marks the node dirty. Update recomputes the world matrices
+    of the dirty subtrees and nothing else, and remembers which node ranges
+    it touched so the owner can refresh whatever depends on them (bounds).
+*/
+
+struct SceneGraphUpdate {
+    unsigned long nodesUpdated = 0;
+    double ms = 0.0;
+};
+
+class SceneGraph {
+    public:
+        static const uint32_t NO_NODE = ~0u;
+
+        // Appends a node under parent (NO_NODE for a root). Nodes must be added depth first.
+        uint32_t AddNode(uint32_t parent, const glm::mat4 &local, const string &name = "");
+        // Makes node place mesh. Only the most recently added node can take meshes.
+        void AddMesh(uint32_t node, uint32_t mesh);
+        void Clear();
+
+        size_t NodeCount() const { return parents.size(); }
+        uint32_t Parent(uint32_t node) const { return parents[node]; }
+        const string &Name(uint32_t node) const { return names[node]; }
+        // First node with the given name, NO_NODE if there is none
+        uint32_t Find(const string &name) const;
+
+        const glm::mat4 &Local(uint32_t node) const { return locals[node]; }
+        // Valid for clean nodes, call Update after changing local transforms
+        const glm::mat4 &World(uint32_t node) const { return worlds[node]; }
+        void SetLocal(uint32_t node, const glm::mat4 &local);
+
+        // The node places the meshes MeshRefs()[FirstMesh(node), FirstMesh(node) + MeshCount(node)).
+        // References of consecutive nodes are consecutive as well.
+        uint32_t FirstMesh(uint32_t node) const { return firstMeshes[node]; }
+        uint32_t MeshCount(uint32_t node) const { return meshCounts[node]; }
+        const vector<uint32_t> &MeshRefs() const { return meshRefs; }
+
+        // Recomputes the world matrices of every dirty subtree. Returns the number of nodes updated.
+        size_t Update();
+        bool Dirty() const { return !dirtyNodes.empty(); }
+        // [first, end) node ranges recomputed by the last Update
+        const vector<pair<uint32_t, uint32_t>> &UpdatedRanges() const { return updatedRanges; }
+        const SceneGraphUpdate &LastUpdate() const { return lastUpdate; }
+
+    private:
+        vector<uint32_t> parents;
+        vector<uint32_t> subtreeEnds;  // one past the last node of each node's subtree
+        vector<glm::mat4> locals;
+        vector<glm::mat4> worlds;
+        vector<string> names;
+        vector<uint32_t> firstMeshes;
+        vector<uint32_t> meshCounts;
+        vector<uint32_t> meshRefs;
+
+        vector<uint32_t> dirtyNodes;
+        bool subtreesValid = true;
+        vector<pair<uint32_t, uint32_t>> updatedRanges;
+        SceneGraphUpdate lastUpdate;
+
+        void computeSubtreeEnds();
+};
+
+#endif /* SceneGraph_hpp */
@@ -1,4 +1,11 @@
 #include "Shader.hpp"
+#include "GLState.hpp"
+#include "Hash.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
 
 // Reads a text file and outputs a string with everything in the text file
 std::string get_file_contents(const GLchar* filename)
@@ -43,17 +50,53 @@ void Shader::compileErrors(unsigned int shader, const char* type)
         }
     }
 }
+std::string Shader::binaryCacheDirectory = "shadercache";
+
 // Constructor that build the Shader Program from 2 different shaders
 Shader::Shader(const char* vertexFile, const char* fragmentFile)
 {
+    auto start = std::chrono::steady_clock::now();
+
     // Read vertexFile and fragmentFile and store the strings
     std::string vertexCode = get_file_contents(vertexFile);
     std::string fragmentCode = get_file_contents(fragmentFile);
 
+    // A driver binary is only valid for the exact sources and the exact driver that produced it
+    uint64_t key = binaryKey(vertexCode, fragmentCode);
+    std::string cachePath;
+    if (key)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.progbin", (unsigned long long)key);
+        cachePath = (std::filesystem::path(binaryCacheDirectory) / name).string();
+    }
+
+    double sourceCompileMs = 0.0;
+    if (!cachePath.empty() && loadBinary(cachePath, sourceCompileMs))
+    {
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Shader: " << vertexFile << " + " << fragmentFile << " loaded from program binary in " << ms
+                  << " ms (compiling from source took " << sourceCompileMs << " ms)" << std::endl;
+    }
+    else
+    {
+        compileFromSource(vertexCode, fragmentCode, !cachePath.empty());
+        sourceCompileMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Shader: " << vertexFile << " + " << fragmentFile << " compiled from source in "
+                  << sourceCompileMs << " ms" << std::endl;
+        if (!cachePath.empty())
+            saveBinary(cachePath, sourceCompileMs);
+    }
+
+    introspectUniforms();
+}
+
+// Compiles and links the program from GLSL source
+void Shader::compileFromSource(const std::string &vertexCode, const std::string &fragmentCode, bool retrievable)
+{
     // Convert the shader source strings into character arrays
     const GLchar* vertexSource = vertexCode.c_str();
     const GLchar* fragmentSource = fragmentCode.c_str();
-
     // Create Vertex Shader Object and get its reference
     GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
     // Attach Vertex Shader source to the Vertex Shader Object
@@ -77,6 +120,9 @@ Shader::Shader(const char* vertexFile, const char* fragmentFile)
     // Attach the Vertex and Fragment Shaders to the Shader Program
     glAttachShader(ID, vertexShader);
     glAttachShader(ID, fragmentShader);
+    // Ask the driver to keep the linked binary around so we can cache it
+    if (retrievable)
+        glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     // Wrap-up/Link all the shaders together into the Shader Program
     glLinkProgram(ID);
     
@@ -85,47 +131,307 @@ Shader::Shader(const char* vertexFile, const char* fragmentFile)
     // Delete the now useless Vertex and Fragment Shader objects
     glDeleteShader(vertexShader);
     glDeleteShader(fragmentShader);
+}
+
+// --------------------- Program Binary Cache --------------------- //
+/*
+    Linked programs are saved with glGetProgramBinary to <binaryCacheDirectory>/<key>.progbin
+    and handed straight back to the driver with glProgramBinary on the next launch. The key
+    hashes both sources together with GL_VENDOR, GL_RENDERER and GL_VERSION, so editing a shader
+    or updating the driver simply misses. A binary the driver refuses is deleted and the program
+    is compiled from source again.
+*/
+const char PROGRAM_BINARY_MAGIC[8] = { 'P', 'R', 'O', 'G', 'B', 'I', 'N', '\0' };
+const uint32_t PROGRAM_BINARY_VERSION = 1;
 
+struct ProgramBinaryHeader
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t binaryFormat;
+    uint32_t binaryLength;
+    uint32_t reserved;
+    uint64_t key;
+    double   sourceCompileMs;
+};
+
+void Shader::SetBinaryCacheDirectory(const std::string &directory)
+{
+    binaryCacheDirectory = directory;
+}
+
+// Returns 0 when program binaries are unavailable (no GL 4.1 / ARB_get_program_binary, or no formats)
+uint64_t Shader::binaryKey(const std::string &vertexCode, const std::string &fragmentCode)
+{
+    if (binaryCacheDirectory.empty() || !(GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary))
+        return 0;
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    if (formats <= 0)
+        return 0;
+
+    uint64_t key = fnv1a(vertexCode.data(), vertexCode.size());
+    // separator so moving text between the two stages changes the key
+    key = fnv1a("\0", 1, key);
+    key = fnv1a(fragmentCode.data(), fragmentCode.size(), key);
+    const GLenum driverStrings[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+    for (GLenum name : driverStrings)
+    {
+        const char* value = (const char*)glGetString(name);
+        if (value)
+            key = fnv1a(value, strlen(value) + 1, key);
+    }
+    key = fnv1a(&PROGRAM_BINARY_VERSION, sizeof(PROGRAM_BINARY_VERSION), key);
+    return key ? key : 1;
+}
+
+bool Shader::loadBinary(const std::string &path, double &sourceCompileMs)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        return false;
+
+    ProgramBinaryHeader header;
+    std::vector<char> binary;
+    bool valid = bool(in.read((char*)&header, sizeof(header))) &&
+                 std::memcmp(header.magic, PROGRAM_BINARY_MAGIC, sizeof(header.magic)) == 0 &&
+                 header.version == PROGRAM_BINARY_VERSION && header.binaryLength > 0;
+    if (valid)
+    {
+        binary.resize(header.binaryLength);
+        valid = bool(in.read(binary.data(), binary.size()));
+    }
+    in.close();
+
+    if (valid)
+    {
+        ID = glCreateProgram();
+        glProgramBinary(ID, header.binaryFormat, binary.data(), (GLsizei)binary.size());
+        GLint linked = GL_FALSE;
+        glGetProgramiv(ID, GL_LINK_STATUS, &linked);
+        if (linked == GL_TRUE)
+        {
+            sourceCompileMs = header.sourceCompileMs;
+            return true;
+        }
+        glDeleteProgram(ID);
+        ID = 0;
+    }
+
+    // rejected or corrupt: drop it, the source path writes a fresh one
+    std::cout << "SHADER_BINARY_ERROR for:" << path << ", recompiling from source" << std::endl;
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+    return false;
+}
+
+void Shader::saveBinary(const std::string &path, double sourceCompileMs) const
+{
+    GLint linked = GL_FALSE, length = 0;
+    glGetProgramiv(ID, GL_LINK_STATUS, &linked);
+    glGetProgramiv(ID, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (linked != GL_TRUE || length <= 0)
+        return;
+
+    ProgramBinaryHeader header = {};
+    std::memcpy(header.magic, PROGRAM_BINARY_MAGIC, sizeof(header.magic));
+    header.version = PROGRAM_BINARY_VERSION;
+    header.sourceCompileMs = sourceCompileMs;
+    std::vector<char> binary(length);
+    GLsizei written = 0;
+    GLenum format = 0;
+    glGetProgramBinary(ID, length, &written, &format, binary.data());
+    if (written <= 0)
+        return;
+    header.binaryFormat = format;
+    header.binaryLength = (uint32_t)written;
+
+    std::error_code ec;
+    std::filesystem::create_directories(binaryCacheDirectory, ec);
+    // write to a temporary file first so a crash never leaves a truncated binary behind
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out)
+            return;
+        out.write((const char*)&header, sizeof(header));
+        out.write(binary.data(), written);
+        if (!out)
+            return;
+    }
+    std::filesystem::rename(tempPath, path, ec);
 }
 
 // Activates the Shader Program
 void Shader::Activate()
 {
-    glUseProgram(ID);
+    GLState::Instance().UseProgram(ID);
 }
 
 // Deletes the Shader Program
 void Shader::Delete()
 {
     glDeleteProgram(ID);
+    GLState::Instance().ProgramDeleted(ID);
+}
+
+// Connects the uniform block blockName to a uniform buffer binding point
+void Shader::BindUniformBlock(const char* blockName, GLuint bindingPoint)
+{
+    GLuint blockIndex = glGetUniformBlockIndex(ID, blockName);
+    if (blockIndex == GL_INVALID_INDEX)
+    {
+        std::cout << "SHADER_UNIFORM_BLOCK_ERROR for:" << blockName << std::endl;
+        return;
+    }
+    glUniformBlockBinding(ID, blockIndex, bindingPoint);
+}
+
+UniformCallStats Shader::uniformStats;
+
+// Records the location of every active uniform so setters never call glGetUniformLocation
+void Shader::introspectUniforms()
+{
+    uniformIndices.clear();
+    uniforms.clear();
+
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::vector<GLchar> nameBuffer(maxLength > 0 ? maxLength : 1);
+
+    for (GLint i = 0; i < count; i++)
+    {
+        GLint size;
+        GLenum type;
+        glGetActiveUniform(ID, (GLuint)i, (GLsizei)nameBuffer.size(), NULL, &size, &type, nameBuffer.data());
+        std::string name(nameBuffer.data());
+
+        // arrays are reported once as "name[0]": register every element, plus the bare name
+        std::vector<std::string> names;
+        std::string::size_type bracket = name.find('[');
+        if (bracket != std::string::npos && name.compare(bracket, std::string::npos, "[0]") == 0)
+        {
+            std::string base = name.substr(0, bracket);
+            names.push_back(base);
+            for (GLint element = 0; element < size; element++)
+                names.push_back(base + "[" + std::to_string(element) + "]");
+        }
+        else
+            names.push_back(name);
+
+        for (const std::string &uniformName : names)
+        {
+            GLint location = glGetUniformLocation(ID, uniformName.c_str());
+            // uniforms inside a uniform block have no location
+            if (location < 0 || uniformIndices.count(uniformName))
+                continue;
+            UniformSlot slot;
+            slot.location = location;
+            slot.hasValue = false;
+            uniformIndices[uniformName] = (int)uniforms.size();
+            uniforms.push_back(slot);
+        }
+    }
+}
+
+UniformHandle Shader::GetUniform(const std::string &name) const
+{
+    UniformHandle uniform;
+    auto it = uniformIndices.find(name);
+    if (it != uniformIndices.end())
+        uniform.index = it->second;
+    return uniform;
+}
+
+void Shader::PrintUniformStats()
+{
+    unsigned long total = uniformStats.issued + uniformStats.elided;
+    std::cout << "Shader: " << uniformStats.issued << " glUniform calls issued, " << uniformStats.elided
+              << " skipped as redundant";
+    if (total > 0)
+        std::cout << " (" << 100.0 * uniformStats.elided / total << "%)";
+    std::cout << std::endl;
+}
+
+bool Shader::updateShadow(UniformHandle uniform, const void *value, size_t size) const
+{
+    if (!uniform.IsValid())
+        return false;
+    UniformSlot &slot = uniforms[uniform.index];
+    if (slot.hasValue && std::memcmp(slot.value, value, size) == 0)
+    {
+        uniformStats.elided++;
+        return false;
+    }
+    std::memcpy(slot.value, value, size);
+    slot.hasValue = true;
+    uniformStats.issued++;
+    return true;
+}
+
+void Shader::setBool(UniformHandle uniform, bool value) const
+{
+    setInt(uniform, (int)value);
+}
+// ------------------------------------------------------------------------
+void Shader::setInt(UniformHandle uniform, int value) const
+{
+    if (updateShadow(uniform, &value, sizeof(value)))
+        glUniform1i(uniforms[uniform.index].location, value);
+}
+// ------------------------------------------------------------------------
+void Shader::setFloat(UniformHandle uniform, float value) const
+{
+    if (updateShadow(uniform, &value, sizeof(value)))
+        glUniform1f(uniforms[uniform.index].location, value);
+}
+// ------------------------------------------------------------------------
+void Shader::setMat4(UniformHandle uniform, const glm::mat4 &value) const
+{
+    if (updateShadow(uniform, glm::value_ptr(value), 16 * sizeof(float)))
+        glUniformMatrix4fv(uniforms[uniform.index].location, 1, GL_FALSE, glm::value_ptr(value));
+}
+// ------------------------------------------------------------------------
+void Shader::setVec3(UniformHandle uniform, float value1, float value2, float value3) const
+{
+    float value[3] = { value1, value2, value3 };
+    if (updateShadow(uniform, value, sizeof(value)))
+        glUniform3f(uniforms[uniform.index].location, value1, value2, value3);
+}
+// ------------------------------------------------------------------------
+void Shader::setVec3(UniformHandle uniform, glm::vec3 value) const
+{
+    setVec3(uniform, value.x, value.y, value.z);
 }
 
+// The name based setters resolve through the uniform table built at link time
 void Shader::setBool(const std::string &name, bool value) const
 {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+    setBool(GetUniform(name), value);
 }
 // ------------------------------------------------------------------------
 void Shader::setInt(const std::string &name, int value) const
 {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+    setInt(GetUniform(name), value);
 }
 // ------------------------------------------------------------------------
 void Shader::setFloat(const std::string &name, float value) const
 { 
-    glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+    setFloat(GetUniform(name), value);
 }
 // ------------------------------------------------------------------------
 void Shader::setMat4(const std::string &name, glm::mat4 value) const
 {
-    glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+    setMat4(GetUniform(name), value);
 }
 // ------------------------------------------------------------------------
 void Shader::setVec3(const std::string &name, float value1, float value2, float value3) const
 {
-    glUniform3f(glGetUniformLocation(ID, name.c_str()), value1, value2, value3);
+    setVec3(GetUniform(name), value1, value2, value3);
 }
 // ------------------------------------------------------------------------
 void Shader::setVec3(const std::string &name, glm::vec3 value) const
 {
-    glUniform3f(glGetUniformLocation(ID, name.c_str()), value.x, value.y, value.z);
+    setVec3(GetUniform(name), value);
 }
@@ -0,0 +1,56 @@
+#ifndef TEXTURECOMPRESSOR_HPP
+#define TEXTURECOMPRESSOR_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+using namespace std;
+// --------------------- Texture Compressor --------------------- //
+/*
+    CPU encoders for the block compressed formats texbake writes. Every
+    format cuts the image into 4x4 texel blocks (edge blocks repeat the last
+    row / column) and stores each block in a fixed number of bytes, which the
+    GPU samples without ever decompressing the texture in memory.
+
+        BC1   8 bytes  RGB: two 565 endpoints and a 2-bit index per texel
+                       into the four colors on the line between them.
+                       Endpoints come from the block's principal axis and
+                       are refined once by least squares.
+        BC3  16 bytes  RGBA: a BC4 block for alpha, then a BC1 color block.
+        BC5  16 bytes  RG: two BC4 blocks, for tangent space normal maps
+                       (the shader rebuilds z).
+        ETC2  8 bytes  RGB: two 2x4 or 4x2 sub-blocks, each a base color
+                       plus one of eight modifier tables. Only the ETC1
+                       compatible individual and differential modes are
+                       searched; the output is valid ETC2.
+
+    BC4 (the alpha/channel block) stores two 8-bit endpoints and a 3-bit
+    index per texel into the eight values between them.
+
+    Input is always 8-bit RGBA; formats without alpha ignore it.
+*/
+
+enum class BlockFormat {
+    BC1,
+    BC3,
+    BC5,
+    ETC2
+};
+
+class TextureCompressor {
+    public:
+        // Bytes per 4x4 block
+        static size_t BlockBytes(BlockFormat format);
+        // Bytes of a width x height image in format
+        static size_t LevelBytes(BlockFormat format, int width, int height);
+        // Encodes width x height RGBA pixels, blocks in row order
+        static vector<uint8_t> Encode(BlockFormat format, const uint8_t *rgba, int width, int height);
+
+    private:
+        static void encodeBC1(const uint8_t *block, uint8_t *out);
+        static void encodeBC4(const uint8_t *block, int channel, uint8_t *out);
+        static void encodeETC(const uint8_t *block, uint8_t *out);
+};
+
+#endif /* TextureCompressor_hpp */
@@ -0,0 +1,71 @@
+#ifndef TEXTUREUPLOADER_HPP
+#define TEXTUREUPLOADER_HPP
+
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "FrameCounter.hpp"
+
+using namespace std;
+// --------------------- Texture Uploader --------------------- //
+/*
+    Stages texture uploads through a ring of GL_PIXEL_UNPACK_BUFFER objects.
+    glTexImage2D then sources its pixels from a buffer the driver can DMA from,
+    instead of copying out of client memory on the spot, so our memcpy into the
+    next slot overlaps with the GPU still working on the previous upload.
+
+    Each slot carries a fence; the CPU only waits when it laps the ring and the
+    transfer out of that slot has not finished yet. That wait is what the
+    blocked counters measure.
+*/
+
+// Bytes staged and time spent waiting on a slot, over a frame
+struct TextureUploadStats {
+    size_t bytes = 0;
+    double blockedMs = 0.0;
+};
+
+struct TextureUploadTotals {
+    unsigned int uploads = 0;
+    size_t bytes = 0;
+    double blockedMs = 0.0;
+    // the busiest frame so far
+    size_t peakBytesPerFrame = 0;
+    double peakBlockedMsPerFrame = 0.0;
+};
+
+class TextureUploader {
+    public:
+        static TextureUploader &Instance();
+
+        // Uploads tightly packed 8-bit pixels with components (1-4) channels into a mip level of texture
+        // through the next staging buffer (texture is left bound)
+        void Upload(GLuint texture, int components, int width, int height, const unsigned char *pixels,
+                    GLint level = 0);
+        // GL_RED, GL_RG, GL_RGB or GL_RGBA for 1-4 channels
+        static GLenum PixelFormat(int components);
+        // Counts of the last frame closed by FrameCounters::EndFrame, and since startup
+        const TextureUploadStats &Stats() const { return frame.LastFrame(); }
+        const TextureUploadTotals &Totals() const { return totals; }
+        void PrintStats() const;
+        // Deletes the staging buffers and fences
+        void Delete();
+
+    private:
+        struct Slot {
+            GLuint buffer = 0;
+            GLsync fence = 0;
+            size_t capacity = 0;
+        };
+        static const unsigned int RING_SIZE = 4;
+
+        vector<Slot> ring;
+        unsigned int next = 0;
+        FrameCounter<TextureUploadStats> frame;
+        TextureUploadTotals totals;
+
+        TextureUploader() {}
+};
+
+#endif /* TextureUploader_hpp */
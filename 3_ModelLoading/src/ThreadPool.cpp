@@ -0,0 +1,46 @@
+#include "ThreadPool.hpp"
+
+ThreadPool::ThreadPool(unsigned int threadCount)
+{
+    if (threadCount == 0)
+        threadCount = 1;
+    for (unsigned int i = 0; i < threadCount; i++)
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        lock_guard<mutex> lock(queueMutex);
+        stopping = true;
+    }
+    wakeUp.notify_all();
+    for (thread &worker : workers)
+        worker.join();
+}
+
+ThreadPool &ThreadPool::Shared()
+{
+    // leave one core for the render thread (hardware_concurrency may report 0 when unknown)
+    static unsigned int cores = thread::hardware_concurrency();
+    static ThreadPool pool(cores > 1 ? cores - 1 : 1);
+    return pool;
+}
+
+void ThreadPool::workerLoop()
+{
+    while (true)
+    {
+        function<void()> task;
+        {
+            unique_lock<mutex> lock(queueMutex);
+            wakeUp.wait(lock, [this]() { return stopping || !tasks.empty(); });
+            // finish whatever is queued before shutting down
+            if (stopping && tasks.empty())
+                return;
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+        task();
+    }
+}
@@ -10,7 +10,15 @@
 // Wrapper classes
 #include "Shader.hpp"
 #include "Camera.hpp"
+#include "Frustum.hpp"
+#include "GLState.hpp"
+#include "MeshletBuilder.hpp"
 #include "Model.hpp"
+#include "RenderQueue.hpp"
+#include "SceneBVH.hpp"
+#include "TextureArrays.hpp"
+#include "TextureCache.hpp"
+#include "TextureUploader.hpp"
 
 // GLM
 #include <glm/glm.hpp>
@@ -25,8 +33,10 @@ using namespace std;
 void processInput(GLFWwindow *window);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
 
 const GLint WIDTH = 800, HEIGHT = 800;
+const double UPLOAD_BUDGET_MS = 2.0; // GPU upload time allowed per frame while models stream in
 
 float deltaTime = 0.0f;    // Time between current frame and last frame
 float lastFrame = 0.0f; // Time of last frame
@@ -37,6 +47,35 @@ float lastX = WIDTH / 2.0f;
 float lastY = HEIGHT / 2.0f;
 bool firstMouse = true;
 
+// --------------------- Scene --------------------- //
+/*
+    A backpack at each of BACKPACK_POSITIONS, drawn through a SceneBVH: one
+    tree over the meshes of every placement culls the whole scene, and the
+    meshes it keeps are drawn at their LOD with their meshlets culled. The
+    placements are added right away and join the tree once the model has
+    streamed in.
+*/
+const glm::vec3 BACKPACK_POSITIONS[] = {
+    glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(5.0f, 0.0f, -3.0f), glm::vec3(-5.0f, 0.0f, -3.0f),
+    glm::vec3(10.0f, 0.0f, -8.0f), glm::vec3(-10.0f, 0.0f, -8.0f)
+};
+
+// --------------------- Vertex Format --------------------- //
+/*
+    Once the float backpack is in, it is loaded a second time with the compact
+    vertex layout (16 instead of 32 bytes per vertex). V switches between the
+    two. The timings of both, and of the other building blocks, come from
+    the bench tool of 4_AdvancedOpenGL (tools/bench.cpp).
+*/
+bool compactVertices = false;
+
+// --------------------- Indirect Draws --------------------- //
+/*
+    I prints the render queue's draw calls and submit time for the last frame,
+    then switches between glMultiDrawElementsIndirect and the direct
+    multi-draw path, so pressing it twice compares the two.
+*/
+bool indirectToggleRequested = false;
 
 int main() {
     // --------------------- Initialization --------------------- //
@@ -66,6 +105,7 @@ int main() {
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
+    glfwSetKeyCallback(window, key_callback);
     
     lastX = WIDTH;
     lastY = HEIGHT;
@@ -87,8 +127,19 @@ int main() {
     
     // Shader Compilation
     Shader lightingShader("phongLighting.vert", "phongLighting.frag");
+    Shader compactShader("phongLightingCompact.vert", "phongLighting.frag");
 
-    Model ourModel("backpack.obj");
+    // Stream the model in while the render loop keeps running
+    shared_ptr<Model> ourModel = Model::LoadAsync("backpack.obj");
+    shared_ptr<Model> compactModel;
+    // one scene per vertex layout, each placing its model at every position
+    SceneBVH floatScene, compactScene;
+    for (const glm::vec3 &position : BACKPACK_POSITIONS)
+        floatScene.Add(*ourModel, glm::translate(glm::mat4(1.0f), position));
+    bool modelReported = false;
+    bool compactReported = false;
+    // Meshes are queued and drawn sorted by program, textures and VAO
+    RenderQueue renderQueue;
     // --------------------- Render Loop --------------------- //
     while(!glfwWindowShouldClose(window))
     {
@@ -98,30 +149,77 @@ int main() {
         lastFrame = currentFrame;
         
         processInput(window);
+        if (indirectToggleRequested)
+        {
+            renderQueue.PrintStats();
+            if (RenderQueue::IndirectSupported())
+            {
+                RenderQueue::SetIndirect(!RenderQueue::IndirectActive());
+                cout << (RenderQueue::IndirectActive() ? "Indirect" : "Direct") << " draws" << endl;
+            }
+            else
+                cout << "Indirect draws need GL 4.3 or ARB_multi_draw_indirect" << endl;
+            indirectToggleRequested = false;
+        }
         
+        Model::UploadPending(UPLOAD_BUDGET_MS);
+        if (!modelReported && ourModel->IsLoaded())
+        {
+            TextureCache::Instance().PrintStats();
+            TextureUploader::Instance().PrintStats();
+            modelReported = true;
+            // started only now so it reads the mesh cache the first load wrote instead of racing it
+            compactModel = Model::LoadAsync("backpack.obj", VertexFormat::Compact);
+            for (const glm::vec3 &position : BACKPACK_POSITIONS)
+                compactScene.Add(*compactModel, glm::translate(glm::mat4(1.0f), position));
+        }
+        bool compactLoaded = compactModel && compactModel->IsLoaded();
+        if (!compactReported && compactLoaded)
+        {
+            cout << "Vertex buffers: float " << ourModel->VertexBufferBytes() / 1024 << " KB, compact "
+                 << compactModel->VertexBufferBytes() / 1024 << " KB" << endl;
+            compactReported = true;
+        }
+        bool useCompact = compactVertices && compactLoaded;
+        Shader &shader = useCompact ? compactShader : lightingShader;
+        SceneBVH &scene = useCompact ? compactScene : floatScene;
         
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         
         // --------------------- Cameras --------------------- //
         glm::mat4 view = camera.GetViewMatrix();
         glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)screenWidth / (float)screenHeight, 0.1f, 100.0f);
-        glm::mat4 model = glm::mat4(1.0f);
         
-        model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f)); // translate it down so it's at the center of the scene
-        model = glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f));    // it's a bit too big for our scene, so scale it down
+        shader.Activate();
+        shader.setMat4("view", view);
+        shader.setMat4("projection", projection);
         
-        lightingShader.Activate();
-        lightingShader.setMat4("model", model);
-        lightingShader.setMat4("view", view);
-        lightingShader.setMat4("projection", projection);
-        
-        ourModel.Draw(lightingShader);
+        // meshes outside the view never reach the queue, the rest is drawn at the LOD their size on screen allows
+        Frustum frustum = camera.GetFrustum(projection);
+        LodView lod = camera.GetLodView((float)screenHeight);
+        renderQueue.Begin(view);
+        scene.Submit(renderQueue, shader, frustum, lod);
+        renderQueue.Flush();
         glfwSwapBuffers(window);
         
         glfwPollEvents();
+        // closes the per-frame stats of every subsystem
+        FrameCounters::EndFrame();
     }
     // --------------------- Clean up --------------------- //
+    Shader::PrintUniformStats();
+    renderQueue.PrintStats();
+    FrustumCuller::PrintStats();
+    MeshletBuilder::PrintStats();
+    GLState::Instance().PrintStats();
+    ourModel->Delete();
+    if (compactModel)
+        compactModel->Delete();
+    TextureUploader::Instance().Delete();
+    TextureArrays::Instance().Delete();
+    renderQueue.Delete();
     lightingShader.Delete();
+    compactShader.Delete();
     glfwDestroyWindow(window);
     glfwTerminate();
     
@@ -167,3 +265,14 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
     camera.ProcessMouseScroll(static_cast<float>(yoffset));
 }
+
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+    if (action == GLFW_PRESS && key == GLFW_KEY_V)
+    {
+        compactVertices = !compactVertices;
+        cout << (compactVertices ? "Compact" : "Float") << " vertex layout" << endl;
+    }
+    if (action == GLFW_PRESS && key == GLFW_KEY_I)
+        indirectToggleRequested = true;
+}
@@ -0,0 +1,75 @@
+#ifndef BVH_HPP
+#define BVH_HPP
+
+#include <stdint.h>
+#include <vector>
+
+#include "Bounds.hpp"
+#include "Frustum.hpp"
+
+using namespace std;
+// --------------------- Bounding Volume Hierarchy --------------------- //
+/*
+    Binary tree of bounds over a static set of items (the meshes of a model or
+    of a whole scene), built once at load with a binned surface area
+    heuristic. Culling walks it from the root:
+
+        - a node outside one plane is dropped with everything below it
+        - a node inside a plane stops testing that plane for its children
+        - a node inside all six planes makes its whole subtree visible
+          without visiting it
+
+    Build reorders the items so every subtree covers one contiguous range of
+    the order array; that is what lets a fully visible subtree be accepted in
+    one loop.
+*/
+
+struct BVHNode {
+    Bounds bounds;
+    uint32_t left = 0;   // first child, the second one follows it. 0 for leaves.
+    uint32_t first = 0;  // the subtree's items are order[first, first + count)
+    uint32_t count = 0;
+};
+
+// Cost of the last traversal
+struct BVHTraversal {
+    unsigned long nodesVisited = 0;
+    unsigned long planeTests = 0;
+};
+
+class BVH {
+    public:
+        static const uint32_t LEAF_SIZE = 4;
+
+        // Builds the tree over items. Cull reports visibility by index into the same vector.
+        void Build(const vector<Bounds> &items);
+        // Re-fits every node around new bounds of the same items, keeping the tree shape.
+        // Cheaper than Build when items moved a little (animated sub-parts).
+        void Refit(const vector<Bounds> &items);
+        void Clear();
+        bool Empty() const { return nodes.empty(); }
+
+        // Sets visible[i] for every item and returns how many are visible.
+        // The frustum has to be in the space of the bounds given to Build.
+        size_t Cull(const Frustum &frustum, vector<uint8_t> &visible);
+
+        size_t NodeCount() const { return nodes.size(); }
+        double BuildMs() const { return buildMs; }
+        const BVHTraversal &LastTraversal() const { return traversal; }
+
+    private:
+        vector<BVHNode> nodes;
+        vector<uint32_t> order;
+        vector<Bounds> items;
+        double buildMs = 0.0;
+        BVHTraversal traversal;
+
+        // Box around order[first, first + count) and the sphere around its center holding theirs
+        Bounds enclose(uint32_t first, uint32_t count) const;
+        // Fills nodes[index] for order[first, first + count) and builds its children
+        void buildNode(uint32_t index, uint32_t first, uint32_t count);
+        // Partitions order[first, first + count) and returns the size of the left part
+        uint32_t split(uint32_t first, uint32_t count);
+};
+
+#endif /* BVH_hpp */
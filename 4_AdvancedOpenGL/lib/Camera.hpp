@@ -5,6 +5,9 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "Frustum.hpp"
+#include "LodView.hpp"
+
 /* This was written by Joey de Vries on his tutorial for learnOpenGL */
 
 // Defines several possible options for camera movement. Used as abstraction to stay away from window-system specific input methods
@@ -66,6 +69,22 @@ public:
         return glm::lookAt(Position, Position + Front, Up);
     }
 
+    // returns the world space frustum planes seen through the given projection matrix
+    Frustum GetFrustum(const glm::mat4 &projection)
+    {
+        return Frustum::FromMatrix(projection * GetViewMatrix());
+    }
+
+    // returns what LOD selection needs for a perspective projection of Zoom degrees onto viewportHeight pixels
+    LodView GetLodView(float viewportHeight, float pixelError = 1.0f)
+    {
+        LodView view;
+        view.position = Position;
+        view.projectionScale = viewportHeight / (2.0f * tanf(glm::radians(Zoom) * 0.5f));
+        view.pixelError = pixelError;
+        return view;
+    }
+
     // processes input received from any keyboard-like input system. Accepts input parameter in the form of camera defined ENUM (to abstract it from windowing systems)
     void ProcessKeyboard(Camera_Movement direction, float deltaTime)
     {
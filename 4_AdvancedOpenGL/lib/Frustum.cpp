@@ -0,0 +1,179 @@
+#include "Frustum.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define FRUSTUM_USE_SSE 1
+#endif
+
+FrameCounter<CullStats> FrustumCuller::stats;
+
+// Scales the plane so its normal has unit length and w is a true distance
+static glm::vec4 normalizePlane(const glm::vec4 &plane)
+{
+    float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+    return length > 0.0f ? plane / length : plane;
+}
+
+// Gribb/Hartmann: each clip plane is the last row of the matrix plus or minus one of the others
+Frustum Frustum::FromMatrix(const glm::mat4 &viewProjection)
+{
+    const glm::mat4 &m = viewProjection;
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++)
+        rows[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+
+    Frustum frustum;
+    frustum.planes[0] = normalizePlane(rows[3] + rows[0]);
+    frustum.planes[1] = normalizePlane(rows[3] - rows[0]);
+    frustum.planes[2] = normalizePlane(rows[3] + rows[1]);
+    frustum.planes[3] = normalizePlane(rows[3] - rows[1]);
+    frustum.planes[4] = normalizePlane(rows[3] + rows[2]);
+    frustum.planes[5] = normalizePlane(rows[3] - rows[2]);
+    return frustum;
+}
+
+// A point p of the object lands at model * p, so the plane seen from the object is transpose(model) * plane.
+// Affine maps keep half spaces intact, so testing local bounds against it is exact even under non-uniform scale.
+Frustum Frustum::Transformed(const glm::mat4 &model) const
+{
+    glm::mat4 transposed = glm::transpose(model);
+    Frustum frustum;
+    for (int i = 0; i < PLANE_COUNT; i++)
+        frustum.planes[i] = normalizePlane(transposed * planes[i]);
+    return frustum;
+}
+
+bool Frustum::Intersects(const Bounds &bounds) const
+{
+    glm::vec3 extents = bounds.Extents();
+    for (const glm::vec4 &plane : planes)
+    {
+        float distance = plane.x * bounds.center.x + plane.y * bounds.center.y + plane.z * bounds.center.z + plane.w;
+        float boxRadius = std::fabs(plane.x) * extents.x + std::fabs(plane.y) * extents.y +
+                          std::fabs(plane.z) * extents.z;
+        if (distance < -std::min(bounds.radius, boxRadius))
+            return false;
+    }
+    return true;
+}
+
+size_t FrustumCuller::Add(const Bounds &bounds)
+{
+    size_t padded = (count + 4) & ~size_t(3);
+    for (vector<float> *column : { &centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ, &radius })
+        column->resize(padded, 0.0f);
+
+    Set(count, bounds);
+    return count++;
+}
+
+void FrustumCuller::Set(size_t index, const Bounds &bounds)
+{
+    glm::vec3 extents = bounds.Extents();
+    centerX[index] = bounds.center.x;
+    centerY[index] = bounds.center.y;
+    centerZ[index] = bounds.center.z;
+    extentX[index] = extents.x;
+    extentY[index] = extents.y;
+    extentZ[index] = extents.z;
+    radius[index] = bounds.radius;
+}
+
+void FrustumCuller::Clear()
+{
+    for (vector<float> *column : { &centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ, &radius })
+        column->clear();
+    count = 0;
+}
+
+size_t FrustumCuller::Cull(const Frustum &frustum, vector<uint8_t> &visible) const
+{
+    auto start = chrono::steady_clock::now();
+    visible.resize(count);
+    size_t visibleCount = 0;
+    size_t i = 0;
+
+#ifdef FRUSTUM_USE_SSE
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    __m128 planeX[Frustum::PLANE_COUNT], planeY[Frustum::PLANE_COUNT];
+    __m128 planeZ[Frustum::PLANE_COUNT], planeW[Frustum::PLANE_COUNT];
+    __m128 planeAbsX[Frustum::PLANE_COUNT], planeAbsY[Frustum::PLANE_COUNT], planeAbsZ[Frustum::PLANE_COUNT];
+    for (int p = 0; p < Frustum::PLANE_COUNT; p++)
+    {
+        planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+        planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+        planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+        planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+        planeAbsX[p] = _mm_andnot_ps(signMask, planeX[p]);
+        planeAbsY[p] = _mm_andnot_ps(signMask, planeY[p]);
+        planeAbsZ[p] = _mm_andnot_ps(signMask, planeZ[p]);
+    }
+
+    for (; i < count; i += 4)
+    {
+        __m128 cx = _mm_loadu_ps(&centerX[i]);
+        __m128 cy = _mm_loadu_ps(&centerY[i]);
+        __m128 cz = _mm_loadu_ps(&centerZ[i]);
+        __m128 ex = _mm_loadu_ps(&extentX[i]);
+        __m128 ey = _mm_loadu_ps(&extentY[i]);
+        __m128 ez = _mm_loadu_ps(&extentZ[i]);
+        __m128 r = _mm_loadu_ps(&radius[i]);
+
+        __m128 outside = zero;
+        for (int p = 0; p < Frustum::PLANE_COUNT; p++)
+        {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], cx), _mm_mul_ps(planeY[p], cy)),
+                                         _mm_add_ps(_mm_mul_ps(planeZ[p], cz), planeW[p]));
+            __m128 boxRadius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeAbsX[p], ex), _mm_mul_ps(planeAbsY[p], ey)),
+                                          _mm_mul_ps(planeAbsZ[p], ez));
+            __m128 reach = _mm_min_ps(r, boxRadius);
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, reach), zero));
+        }
+
+        int outsideMask = _mm_movemask_ps(outside);
+        for (size_t lane = 0; lane < 4 && i + lane < count; lane++)
+        {
+            uint8_t inside = (outsideMask >> lane) & 1 ? 0 : 1;
+            visible[i + lane] = inside;
+            visibleCount += inside;
+        }
+    }
+#endif
+
+    for (; i < count; i++)
+    {
+        Bounds bounds;
+        glm::vec3 extents(extentX[i], extentY[i], extentZ[i]);
+        bounds.center = glm::vec3(centerX[i], centerY[i], centerZ[i]);
+        bounds.min = bounds.center - extents;
+        bounds.max = bounds.center + extents;
+        bounds.radius = radius[i];
+        visible[i] = frustum.Intersects(bounds) ? 1 : 0;
+        visibleCount += visible[i];
+    }
+
+    Record(visibleCount, count - visibleCount,
+           chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+    return visibleCount;
+}
+
+void FrustumCuller::Record(size_t visible, size_t culled, double ms)
+{
+    CullStats &thisFrame = stats.ThisFrame();
+    thisFrame.visible += visible;
+    thisFrame.culled += culled;
+    thisFrame.cullMs += ms;
+}
+
+void FrustumCuller::PrintStats()
+{
+    const CullStats &lastFrame = stats.LastFrame();
+    cout << "FrustumCuller: last frame " << lastFrame.visible << " visible, " << lastFrame.culled
+         << " culled in " << lastFrame.cullMs << " ms" << endl;
+}
@@ -0,0 +1,77 @@
+#ifndef FRUSTUM_HPP
+#define FRUSTUM_HPP
+
+#include <stdint.h>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Bounds.hpp"
+#include "FrameCounter.hpp"
+
+using namespace std;
+// --------------------- Frustum Culling --------------------- //
+/*
+    A frustum is six planes (xyz = inward normal, w = distance) pulled out of a
+    projection * view matrix. Anything entirely behind one of them is off
+    screen.
+
+    FrustumCuller keeps the bounds of a set of objects in structure of arrays
+    form and tests them four at a time with SSE (scalar elsewhere). Each object
+    is tested with its sphere and its box at once: per plane, the object is
+    outside when the center lies further behind the plane than the smaller of
+    the sphere radius and the box's projected half size.
+
+    Culled and visible counts of every Cull call in a frame are summed into
+    process-wide stats, closed by FrameCounters::EndFrame.
+*/
+
+struct Frustum {
+    static const int PLANE_COUNT = 6;
+    // left, right, bottom, top, near, far
+    glm::vec4 planes[PLANE_COUNT];
+
+    // Planes of the clip volume of viewProjection, in the space the matrix maps from
+    static Frustum FromMatrix(const glm::mat4 &viewProjection);
+    // The same frustum in the local space of an object drawn with model
+    Frustum Transformed(const glm::mat4 &model) const;
+
+    bool Intersects(const Bounds &bounds) const;
+};
+
+struct CullStats {
+    unsigned long visible = 0;
+    unsigned long culled = 0;
+    double cullMs = 0.0;
+};
+
+class FrustumCuller {
+    public:
+        // Appends an object and returns its index
+        size_t Add(const Bounds &bounds);
+        // Replaces the bounds of an object already added
+        void Set(size_t index, const Bounds &bounds);
+        size_t Size() const { return count; }
+        void Clear();
+
+        // Sets visible[i] for every object and returns how many are visible.
+        // The frustum has to be in the same space as the bounds (see Frustum::Transformed).
+        size_t Cull(const Frustum &frustum, vector<uint8_t> &visible) const;
+
+        // Adds the result of a cull done elsewhere (BVH) to the frame's counts
+        static void Record(size_t visible, size_t culled, double ms);
+        // Counts of the last frame closed by FrameCounters::EndFrame
+        static const CullStats &Stats() { return stats.LastFrame(); }
+        static void PrintStats();
+
+    private:
+        // padded to a multiple of four so the SIMD loop never reads past the end
+        vector<float> centerX, centerY, centerZ;
+        vector<float> extentX, extentY, extentZ;
+        vector<float> radius;
+        size_t count = 0;
+
+        static FrameCounter<CullStats> stats;
+};
+
+#endif /* Frustum_hpp */
@@ -0,0 +1,81 @@
+#ifndef GLSTATE_HPP
+#define GLSTATE_HPP
+
+#include <GL/glew.h>
+
+#include "FrameCounter.hpp"
+
+// --------------------- GL State Tracker --------------------- //
+/*
+    Shadow copy of the binding state the wrappers touch: current program,
+    vertex array, buffer per target, active texture unit and the texture bound
+    to each unit. A bind that would not change anything returns without
+    calling GL.
+
+    Everything that binds these objects has to go through here, otherwise the
+    shadow no longer matches the driver. Code that issues raw GL binds (setup
+    code in main, third party code) must call Invalidate afterwards, which
+    makes the next bind of every kind go through unconditionally.
+
+    The element array buffer binding belongs to the bound vertex array, so it
+    is forgotten whenever the vertex array changes.
+*/
+
+// Binds that reached GL and binds skipped, over a frame or in total
+struct GLStateStats {
+    unsigned long issued = 0;
+    unsigned long elided = 0;
+};
+
+class GLState {
+    public:
+        static GLState &Instance();
+
+        void UseProgram(GLuint program);
+        void BindVertexArray(GLuint vertexArray);
+        void BindBuffer(GLenum target, GLuint buffer);
+        // Always issued (indexed bindings are not shadowed), but it also binds the generic target
+        void BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+        void ActiveTexture(GLenum unit);
+        // Binds texture to the active unit
+        void BindTexture(GLenum target, GLuint texture);
+        // ActiveTexture(GL_TEXTURE0 + unit) followed by BindTexture
+        void BindTextureUnit(GLuint unit, GLenum target, GLuint texture);
+
+        // Tell the tracker an object is gone: GL drops deleted objects from their binding points
+        void ProgramDeleted(GLuint program);
+        void VertexArrayDeleted(GLuint vertexArray);
+        void BufferDeleted(GLuint buffer);
+        void TextureDeleted(GLuint texture);
+
+        // Forgets the whole shadow after raw GL binds
+        void Invalidate();
+
+        // Counts of the last frame closed by FrameCounters::EndFrame, and since startup
+        const GLStateStats &Stats() const { return frame.LastFrame(); }
+        const GLStateStats &Totals() const { return total; }
+        void PrintStats() const;
+
+    private:
+        static const GLuint UNKNOWN = ~0u;
+        static const int MAX_TEXTURE_UNITS = 32;
+        // buffer targets and texture targets we shadow; others are always issued
+        static const int BUFFER_TARGETS = 5;
+        static const int TEXTURE_TARGETS = 3;
+
+        GLuint program = UNKNOWN;
+        GLuint vertexArray = UNKNOWN;
+        GLuint buffers[BUFFER_TARGETS];
+        GLenum activeUnit = UNKNOWN;
+        GLuint textures[MAX_TEXTURE_UNITS][TEXTURE_TARGETS];
+        FrameCounter<GLStateStats> frame;
+        GLStateStats total;
+
+        GLState() { Invalidate(); }
+        static int bufferSlot(GLenum target);
+        static int textureSlot(GLenum target);
+        // Counts the call, returns true when it has to reach GL
+        bool update(GLuint &shadow, GLuint value);
+};
+
+#endif /* GLState_hpp */
@@ -0,0 +1,33 @@
+#ifndef LODVIEW_HPP
+#define LODVIEW_HPP
+
+#include <glm/glm.hpp>
+
+#include "Bounds.hpp"
+
+// --------------------- LOD View --------------------- //
+/*
+    What picking a level of detail needs to know about the view. A sphere of
+    radius r at distance d covers about r * projectionScale / d pixels of
+    screen height, with projectionScale = viewport height / (2 tan(fovY / 2)),
+    so a level whose error is e (relative to the radius) moves the image by
+    e * r * projectionScale / d pixels. The coarsest level that stays under
+    pixelError is drawn.
+*/
+struct LodView {
+    glm::vec3 position = glm::vec3(0.0f);
+    float projectionScale = 0.0f;  // 0 turns selection off: always the full mesh
+    float pixelError = 1.0f;
+
+    // Screen space radius in pixels of bounds (in world space), measured from its nearest point.
+    // Negative when selection is off or the eye is inside the bounds.
+    float ProjectedRadius(const Bounds &bounds) const
+    {
+        float distance = glm::length(bounds.center - position) - bounds.radius;
+        if (projectionScale <= 0.0f || distance <= 0.0f)
+            return -1.0f;
+        return bounds.radius * projectionScale / distance;
+    }
+};
+
+#endif /* LodView_hpp */
@@ -1,13 +1,29 @@
 #ifndef MESH_HPP
 #define MESH_HPP
 
+#include <stdint.h>
 #include <stdio.h>
 #include <glm/glm.hpp>
 #include <vector>
 
+#include "Bounds.hpp"
+#include "Frustum.hpp"
+#include "LodView.hpp"
+#include "RenderQueue.hpp"
 #include "Shader.hpp"
+#include "TextureArrays.hpp"
 
 using namespace std;
+class GeometryBuffer;
+
+// Where a mesh's data landed in a GeometryBuffer
+struct GeometryRange {
+    GLint baseVertex = 0;
+    size_t indexOffset = 0;  // in bytes
+    // what the range holds, for giving it back: vertices, and index bytes rounded up to 4
+    size_t vertexCount = 0;
+    size_t indexBytes = 0;
+};
 // --------------------- Models & Meshes --------------------- //
 struct Vertex {
     glm::vec3 Position;
@@ -15,25 +31,187 @@ struct Vertex {
     glm::vec2 TexCoords;
 };
 
+// Layout a mesh's vertex buffer is stored in on the GPU
+enum class VertexFormat {
+    Float,    // Vertex as is, 32 bytes
+    Compact   // CompactVertex, 16 bytes
+};
+
+// Quantized Vertex. Positions are 16-bit unorm inside a box around the mesh, its own or
+// one shared by a whole model (the shader gets them back through the model matrix, see
+// Mesh::PositionDecode), normals are octahedral encoded 16-bit snorm pairs and texture
+// coordinates are half floats.
+struct CompactVertex {
+    uint16_t Position[3];
+    uint16_t Padding;
+    int16_t  Normal[2];
+    uint16_t TexCoords[2];
+};
+static_assert(sizeof(CompactVertex) == 16, "CompactVertex must stay tightly packed");
+
 struct Texture {
     unsigned int id;
     string type;
     string path;  // we store the path of the texture to compare with other textures
 };
 
+// A texture a mesh uses, before it is loaded into a Texture
+struct TextureRef {
+    string type;
+    string path;
+};
+
+// A simplified index buffer over the same vertices as the full mesh
+struct MeshLod {
+    vector<unsigned int> indices;
+    // how far the level moved the surface, relative to the mesh's bounding radius: the root of the
+    // area weighted mean squared plane distance (quadric error) of its costliest collapse. An
+    // estimate, not a bound on the distance to the full surface.
+    float error = 0.0f;
+};
+
+// A cluster of the full mesh's triangles: a contiguous range of its index buffer that
+// touches at most MeshletBuilder::MAX_VERTICES vertices (see MeshletBuilder)
+struct Meshlet {
+    uint32_t firstIndex;
+    uint32_t triangleCount;
+    Bounds   bounds;
+    // every triangle normal is within the cone around coneAxis (coneCutoff: see MeshletBuilder)
+    glm::vec3 coneAxis;
+    float     coneCutoff;
+};
+
+// CPU-side contents of a mesh, built off the GL thread and uploaded later by Model
+struct MeshData {
+    vector<Vertex>       vertices;
+    vector<unsigned int> indices;
+    vector<TextureRef>   textures;
+    Bounds               bounds;
+    // coarser levels, finest first (see MeshSimplifier)
+    vector<MeshLod>      lods;
+    // clusters of indices, built after the indices are in their final order
+    vector<Meshlet>      meshlets;
+};
+
 class Mesh {
     public:
-        // mesh data
+        // mesh data. vertices, indices and lods are empty after ReleaseCpuData.
         vector<Vertex>       vertices;
         vector<unsigned int> indices;
+        vector<MeshLod>      lods;
         vector<Texture>      textures;
+        // box and sphere around the vertices, in model space
+        Bounds               bounds;
+        // clusters of the full mesh, kept after ReleaseCpuData since culling them is per frame
+        vector<Meshlet>      meshlets;
+
+        // With a geometry buffer the mesh is appended to it and draws from its shared vertex array
+        // instead of creating its own; geometry has to be in the same format and outlive the mesh.
+        // The arrays are moved into the mesh: pass them with move() to avoid copying them.
+        // Every level of lods goes into the index buffer right after the full mesh.
+        // A Compact mesh quantizes its positions inside positionBox when given, which has to hold
+        // every vertex: meshes sharing one box share one PositionDecode, so their draws can merge.
+        Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures,
+             VertexFormat format = VertexFormat::Float, GeometryBuffer *geometry = nullptr,
+             vector<MeshLod> lods = {}, const Bounds *positionBox = nullptr);
+        // Move-only: a copy would share the GL objects and delete them twice. The moved-from mesh
+        // owns nothing afterwards; moving onto a mesh deletes what it owned.
+        Mesh(const Mesh &) = delete;
+        Mesh &operator=(const Mesh &) = delete;
+        Mesh(Mesh &&other) noexcept;
+        Mesh &operator=(Mesh &&other) noexcept;
+        // Draws with a layer of texture arrays instead of textures, which lets the render queue merge
+        // the mesh's draws with those of meshes on other layers. The shader must sample sampler2DArrays
+        // at the layer in attribute RenderQueue::LAYER_ATTRIBUTE.
+        void UseTextureArrays(const ArrayMaterial &material);
+        bool UsesTextureArrays() const { return layered; }
+        // level 0 is the full mesh, 1 and up the LODs
+        void Draw(Shader &shader, unsigned int level = 0);
+        // Queues the mesh for a sorted draw instead of drawing it right away
+        void Submit(RenderQueue &queue, Shader &shader, const glm::mat4 &model, unsigned int level = 0);
+        // Queues the full mesh's meshlets that are inside frustum and, with an eye, not facing away
+        // from it. frustum and eye are in the mesh's model space; runs of visible meshlets go out as
+        // one draw each, which the queue merges into a multi-draw.
+        void SubmitMeshlets(RenderQueue &queue, Shader &shader, const glm::mat4 &model, const Frustum &frustum,
+                            const glm::vec3 *eye);
+        // Coarsest level that stays within view's pixel error for the mesh placed at worldBounds
+        unsigned int SelectLevel(const LodView &view, const Bounds &worldBounds) const;
+        unsigned int LevelCount() const { return (unsigned int)levels.size(); }
+        size_t LevelIndexCount(unsigned int level) const { return levels[level].indexCount; }
+        // Releases the mesh's material and deletes its vertex array and buffers. A mesh in a geometry
+        // buffer gives its range back instead; one moved from has nothing left to delete.
+        void Delete();
+        // Frees vertices, indices and lods once they are on the GPU. Drawing only needs the counts.
+        void ReleaseCpuData();
+        // Memory held by vertices, indices and lods
+        size_t CpuBytes() const;
+        size_t VertexCount() const { return vertexCount; }
+        // Indices of the full mesh
+        size_t IndexCount() const { return levels[0].indexCount; }
+
+        VertexFormat Format() const { return format; }
+        // Maps the vertex buffer's positions to model space: identity for Float, the quantization box for Compact.
+        // Whoever sets the "model" uniform for Draw multiplies it in; Submit does it itself.
+        const glm::mat4 &PositionDecode() const { return positionDecode; }
+        // Size of the vertex buffer on the GPU
+        size_t VertexBufferBytes() const;
+        // GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT or GL_UNSIGNED_INT, whichever is the smallest
+        // that can address every vertex; picked at upload
+        GLenum IndexType() const { return indexType; }
+        // Size of the index buffer on the GPU (every level), and what it would be with 32-bit indices
+        size_t IndexBufferBytes() const { return totalIndexCount * IndexSize(indexType); }
+        size_t IndexBufferBytes32() const { return totalIndexCount * sizeof(unsigned int); }
+
+        // "material.texture_diffuseN" style sampler name of each texture type, numbered per type
+        static vector<string> SamplerNames(const vector<string> &types);
+        static GLenum IndexTypeFor(size_t vertexCount);
+        static size_t IndexSize(GLenum indexType);
 
-        Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures);
-        void Draw(Shader &shader);
+        // Where the mesh's vertices and indices start in the buffers VertexArray draws from
+        unsigned int VertexArray() const { return VAO; }
+        GLint BaseVertex() const { return baseVertex; }
+        size_t IndexOffset(unsigned int level = 0) const { return levels[level].indexOffset; }
+        // Enables attributes 0-2 of the bound vertex array and points them at the bound array buffer
+        static void SetVertexAttributes(VertexFormat format);
     private:
         //  render data
-        unsigned int VAO, VBO, EBO;
+        unsigned int VAO = 0, VBO = 0, EBO = 0;
+        VertexFormat format;
+        GeometryBuffer *geometry = nullptr;
+        // where the mesh sits in geometry, given back by Delete
+        GeometryRange geometryRange;
+        size_t vertexCount, totalIndexCount;
+        GLint baseVertex = 0;
+        // where each level's indices are in the element buffer, in bytes
+        struct Level {
+            size_t indexOffset;
+            size_t indexCount;
+            float error;
+        };
+        vector<Level> levels;
+        glm::mat4 positionDecode = glm::mat4(1.0f);
+        GLenum indexType = GL_UNSIGNED_INT;
+        // "material.texture_diffuseN" style sampler name of each texture, built once
+        vector<string> samplerNames;
+        // samplerNames resolved against the program they were last drawn with
+        vector<UniformHandle> samplerUniforms;
+        GLuint samplerProgram = 0;
+        // textures + sampler names as registered with the render queue, or the mesh's texture array pool
+        unsigned int materialId;
+        // whether materialId is the mesh's own registration, released by Delete
+        bool ownsMaterial = false;
+        bool layered = false;
+        unsigned int layer = 0;
+        // result of the last meshlet cull
+        vector<uint8_t> visibleMeshlets;
 
-        void setupMesh();
+        void setupMesh(const Bounds *positionBox);
+        // Takes every member of other, leaving it without GL objects
+        void moveFrom(Mesh &other);
+        // Quantizes the vertices into CompactVertex inside positionBox, or their own box without one,
+        // and sets positionDecode
+        vector<CompactVertex> packCompact(const Bounds *positionBox);
+        // The indices of every level narrowed to indexType, one after the other; fills levels
+        vector<uint8_t> packIndices();
 }; 
 #endif /* Mesh_hpp */
@@ -0,0 +1,82 @@
+#ifndef MESHCACHE_HPP
+#define MESHCACHE_HPP
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "Mesh.hpp"
+#include "SceneGraph.hpp"
+
+using namespace std;
+// --------------------- Binary Mesh Cache --------------------- //
+/*
+    Versioned on-disk copy of everything Model builds out of an Assimp import:
+    vertices in the exact Vertex layout, indices, LOD index buffers, meshlets and
+    the texture references of each mesh, followed by the node hierarchy that places them. It is written next to the source file ("backpack.obj.meshcache")
+    after the first import and memory-mapped on later launches, so a warm start
+    never touches Assimp.
+
+    The cache is only used when the source file size, mtime and content hash,
+    the importer flags, the LOD error bound, the Vertex layout and the cache
+    version all match.
+*/
+
+// Read-only view of one LOD index buffer inside the mapped cache file
+struct CachedLodView {
+    const unsigned int *indices;
+    uint32_t            indexCount;
+    float               error;
+};
+
+// Read-only view of one mesh inside the mapped cache file
+struct CachedMeshView {
+    const Vertex          *vertices;
+    uint32_t               vertexCount;
+    const unsigned int    *indices;
+    uint32_t               indexCount;
+    vector<CachedLodView>  lods;
+    const Meshlet         *meshlets;
+    uint32_t               meshletCount;
+    vector<TextureRef>     textures;
+};
+
+class MeshCache {
+    public:
+        MeshCache(const string &sourcePath, unsigned int importFlags, float lodErrorBound);
+        ~MeshCache();
+
+        // Maps the cache file and validates it against the source. Returns false on any mismatch.
+        bool Read();
+        // Writes the imported meshes and nodes to the cache file. coldImportMs is kept for the warm start report.
+        bool Write(const vector<MeshData> &meshes, const SceneGraph &graph, double coldImportMs);
+
+        const vector<CachedMeshView> &Meshes() const { return meshes; }
+        const SceneGraph &Graph() const { return graph; }
+        // Time the Assimp import took when the cache was written
+        double ColdImportMs() const { return coldImportMs; }
+        const string &CachePath() const { return cachePath; }
+
+    private:
+        string sourcePath;
+        string cachePath;
+        unsigned int importFlags;
+        float lodErrorBound;
+
+        // mapped cache file
+        void  *mapping = nullptr;
+        size_t mappingSize = 0;
+        vector<char> fallbackBuffer;  // used where mmap is not available
+
+        vector<CachedMeshView> meshes;
+        SceneGraph graph;
+        double coldImportMs = 0.0;
+
+        bool mapFile();
+        void unmapFile();
+        bool sourceKey(uint64_t &size, int64_t &mtime, uint64_t &hash) const;
+
+        MeshCache(const MeshCache &) = delete;
+        MeshCache &operator=(const MeshCache &) = delete;
+};
+#endif /* MeshCache_hpp */
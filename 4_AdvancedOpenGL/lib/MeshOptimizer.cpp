@@ -0,0 +1,230 @@
+#include "MeshOptimizer.hpp"
+#include "Hash.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+// Vertices are compared as raw bytes: welding must never merge vertices that differ in any attribute
+struct VertexBytesHash {
+    size_t operator()(const Vertex &vertex) const { return (size_t)fnv1a(&vertex, sizeof(Vertex)); }
+};
+struct VertexBytesEqual {
+    bool operator()(const Vertex &a, const Vertex &b) const { return memcmp(&a, &b, sizeof(Vertex)) == 0; }
+};
+
+MeshOptimizeReport MeshOptimizer::Optimize(MeshData &mesh)
+{
+    auto start = chrono::steady_clock::now();
+    MeshOptimizeReport report;
+    report.verticesBefore = mesh.vertices.size();
+    report.acmrBefore = ACMR(mesh.indices, mesh.vertices.size());
+    report.atvrBefore = ATVR(mesh.indices, mesh.vertices.size());
+
+    WeldVertices(mesh);
+    OptimizeVertexCache(mesh.indices, mesh.vertices.size());
+    OptimizeVertexFetch(mesh);
+
+    report.verticesAfter = mesh.vertices.size();
+    report.acmrAfter = ACMR(mesh.indices, mesh.vertices.size());
+    report.atvrAfter = ATVR(mesh.indices, mesh.vertices.size());
+    report.ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    return report;
+}
+
+void MeshOptimizer::WeldVertices(MeshData &mesh)
+{
+    unordered_map<Vertex, unsigned int, VertexBytesHash, VertexBytesEqual> unique;
+    unique.reserve(mesh.vertices.size());
+    vector<Vertex> welded;
+    vector<unsigned int> remap(mesh.vertices.size());
+    for (size_t i = 0; i < mesh.vertices.size(); i++)
+    {
+        auto inserted = unique.emplace(mesh.vertices[i], (unsigned int)welded.size());
+        if (inserted.second)
+            welded.push_back(mesh.vertices[i]);
+        remap[i] = inserted.first->second;
+    }
+    for (unsigned int &index : mesh.indices)
+        index = remap[index];
+    mesh.vertices.swap(welded);
+}
+
+// --------------------- Forsyth vertex cache optimization --------------------- //
+/*
+    Greedy: always emit the triangle with the highest score, where a
+    triangle scores the sum of its vertices. A vertex scores higher the more
+    recently it was used (it is probably still in the cache) and the fewer
+    triangles it has left (finish it off before it gets evicted). Only the
+    triangles of vertices in the simulated cache are rescored after each
+    step, which keeps the whole pass linear.
+*/
+static const float CACHE_DECAY_POWER = 1.5f;
+static const float LAST_TRIANGLE_SCORE = 0.75f;
+static const float VALENCE_BOOST_SCALE = 2.0f;
+static const float VALENCE_BOOST_POWER = 0.5f;
+
+static float vertexScore(int cachePosition, unsigned int remainingTriangles)
+{
+    if (remainingTriangles == 0)
+        return -1.0f;
+    float score = 0.0f;
+    if (cachePosition >= 0)
+    {
+        // the three vertices of the last triangle get a fixed score so it is not reused right away
+        if (cachePosition < 3)
+            score = LAST_TRIANGLE_SCORE;
+        else
+        {
+            float scale = 1.0f / (MeshOptimizer::CACHE_SIZE - 3);
+            score = powf(1.0f - (cachePosition - 3) * scale, CACHE_DECAY_POWER);
+        }
+    }
+    return score + VALENCE_BOOST_SCALE * powf((float)remainingTriangles, -VALENCE_BOOST_POWER);
+}
+
+void MeshOptimizer::OptimizeVertexCache(vector<unsigned int> &indices, size_t vertexCount)
+{
+    size_t triangleCount = indices.size() / 3;
+    // only triangle lists: anything else would run the scan past the last triangle
+    if (triangleCount == 0 || indices.size() % 3 != 0)
+        return;
+
+    // triangles of each vertex: adjacency[offsets[v], offsets[v] + remaining[v])
+    vector<unsigned int> remaining(vertexCount, 0);
+    for (unsigned int index : indices)
+        remaining[index]++;
+    vector<unsigned int> offsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+        offsets[v + 1] = offsets[v] + remaining[v];
+    vector<unsigned int> adjacency(triangleCount * 3);
+    vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t t = 0; t < triangleCount; t++)
+        for (int corner = 0; corner < 3; corner++)
+            adjacency[fill[indices[t * 3 + corner]]++] = (unsigned int)t;
+
+    vector<int> cachePosition(vertexCount, -1);
+    vector<float> scores(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        scores[v] = vertexScore(-1, remaining[v]);
+    vector<float> triangleScores(triangleCount);
+    vector<uint8_t> emitted(triangleCount, 0);
+    int best = 0;
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        triangleScores[t] = scores[indices[t * 3]] + scores[indices[t * 3 + 1]] + scores[indices[t * 3 + 2]];
+        if (triangleScores[t] > triangleScores[best])
+            best = (int)t;
+    }
+
+    vector<unsigned int> output;
+    output.reserve(indices.size());
+    vector<unsigned int> cache, nextCache;
+    size_t scanCursor = 0;
+    while (output.size() < indices.size())
+    {
+        if (best < 0)
+        {
+            // nothing in the cache has triangles left: continue with the next one in file order
+            while (emitted[scanCursor])
+                scanCursor++;
+            best = (int)scanCursor;
+        }
+
+        emitted[best] = 1;
+        nextCache.clear();
+        for (int corner = 0; corner < 3; corner++)
+        {
+            unsigned int v = indices[best * 3 + corner];
+            output.push_back(v);
+            nextCache.push_back(v);
+            // drop the triangle from the vertex's list
+            unsigned int *list = &adjacency[offsets[v]];
+            for (unsigned int i = 0; i < remaining[v]; i++)
+            {
+                if (list[i] == (unsigned int)best)
+                {
+                    list[i] = list[remaining[v] - 1];
+                    break;
+                }
+            }
+            remaining[v]--;
+        }
+        for (unsigned int v : cache)
+            if (v != nextCache[0] && v != nextCache[1] && v != nextCache[2])
+                nextCache.push_back(v);
+        cache.swap(nextCache);
+
+        // rescore everything that was or still is in the cache
+        best = -1;
+        float bestScore = -1.0f;
+        for (size_t i = 0; i < cache.size(); i++)
+        {
+            unsigned int v = cache[i];
+            cachePosition[v] = i < CACHE_SIZE ? (int)i : -1;
+            float score = vertexScore(cachePosition[v], remaining[v]);
+            float delta = score - scores[v];
+            scores[v] = score;
+            for (unsigned int j = 0; j < remaining[v]; j++)
+            {
+                unsigned int t = adjacency[offsets[v] + j];
+                triangleScores[t] += delta;
+                if (triangleScores[t] > bestScore)
+                {
+                    best = (int)t;
+                    bestScore = triangleScores[t];
+                }
+            }
+        }
+        if (cache.size() > CACHE_SIZE)
+            cache.resize(CACHE_SIZE);
+    }
+    indices.swap(output);
+}
+
+void MeshOptimizer::OptimizeVertexFetch(MeshData &mesh)
+{
+    const unsigned int UNUSED = ~0u;
+    vector<unsigned int> remap(mesh.vertices.size(), UNUSED);
+    vector<Vertex> ordered;
+    ordered.reserve(mesh.vertices.size());
+    for (unsigned int &index : mesh.indices)
+    {
+        if (remap[index] == UNUSED)
+        {
+            remap[index] = (unsigned int)ordered.size();
+            ordered.push_back(mesh.vertices[index]);
+        }
+        index = remap[index];
+    }
+    // vertices no triangle uses are dropped
+    mesh.vertices.swap(ordered);
+}
+
+size_t MeshOptimizer::cacheMisses(const vector<unsigned int> &indices, size_t vertexCount)
+{
+    // FIFO, like most hardware: a hit does not move the vertex
+    vector<size_t> insertedAt(vertexCount, 0);
+    size_t misses = 0;
+    for (unsigned int index : indices)
+    {
+        if (insertedAt[index] == 0 || misses - insertedAt[index] >= CACHE_SIZE)
+        {
+            misses++;
+            insertedAt[index] = misses;
+        }
+    }
+    return misses;
+}
+
+float MeshOptimizer::ACMR(const vector<unsigned int> &indices, size_t vertexCount)
+{
+    size_t triangles = indices.size() / 3;
+    return triangles ? (float)cacheMisses(indices, vertexCount) / triangles : 0.0f;
+}
+
+float MeshOptimizer::ATVR(const vector<unsigned int> &indices, size_t vertexCount)
+{
+    return vertexCount ? (float)cacheMisses(indices, vertexCount) / vertexCount : 0.0f;
+}
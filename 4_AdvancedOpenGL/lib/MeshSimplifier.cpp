@@ -0,0 +1,214 @@
+#include "MeshSimplifier.hpp"
+#include "MeshOptimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_set>
+
+// Levels stop once one keeps more than this share of the triangles of the level before
+const float LOD_MIN_REDUCTION = 0.75f;
+// No level below this many triangles
+const size_t LOD_MIN_TRIANGLES = 16;
+
+// Symmetric 4x4 matrix summing squared distances to planes, weighted by triangle area
+struct Quadric {
+    double xx = 0, xy = 0, xz = 0, xw = 0, yy = 0, yz = 0, yw = 0, zz = 0, zw = 0, ww = 0;
+    double weight = 0;
+
+    void AddPlane(const glm::vec3 &normal, float d, double area)
+    {
+        double a = normal.x, b = normal.y, c = normal.z;
+        xx += area * a * a; xy += area * a * b; xz += area * a * c; xw += area * a * d;
+        yy += area * b * b; yz += area * b * c; yw += area * b * d;
+        zz += area * c * c; zw += area * c * d;
+        ww += area * d * d;
+        weight += area;
+    }
+
+    void Add(const Quadric &other)
+    {
+        xx += other.xx; xy += other.xy; xz += other.xz; xw += other.xw;
+        yy += other.yy; yz += other.yz; yw += other.yw;
+        zz += other.zz; zw += other.zw;
+        ww += other.ww;
+        weight += other.weight;
+    }
+
+    // Area weighted mean squared distance of p to the planes
+    double Error(const glm::vec3 &p) const
+    {
+        double x = p.x, y = p.y, z = p.z;
+        double sum = xx * x * x + 2 * xy * x * y + 2 * xz * x * z + 2 * xw * x
+                   + yy * y * y + 2 * yz * y * z + 2 * yw * y
+                   + zz * z * z + 2 * zw * z
+                   + ww;
+        return weight > 0 ? fabs(sum) / weight : 0.0;
+    }
+};
+
+struct Collapse {
+    unsigned int from;
+    unsigned int to;
+    double cost;
+};
+
+vector<MeshLod> MeshSimplifier::BuildLods(const MeshData &mesh, float errorBound)
+{
+    vector<MeshLod> lods;
+    size_t previousCount = mesh.indices.size();
+    for (unsigned int level = 0; level < MAX_LODS; level++)
+    {
+        size_t target = previousCount / 2 / 3 * 3;
+        if (target < LOD_MIN_TRIANGLES * 3)
+            break;
+        MeshLod lod;
+        lod.indices = Simplify(mesh.vertices, mesh.indices, target, errorBound, mesh.bounds.radius, lod.error);
+        if (lod.indices.size() > previousCount * LOD_MIN_REDUCTION)
+            break;
+        MeshOptimizer::OptimizeVertexCache(lod.indices, mesh.vertices.size());
+        previousCount = lod.indices.size();
+        lods.push_back(std::move(lod));
+    }
+    return lods;
+}
+
+vector<unsigned int> MeshSimplifier::Simplify(const vector<Vertex> &vertices, const vector<unsigned int> &indices,
+                                              size_t targetIndexCount, float errorBound, float radius, float &error)
+{
+    error = 0.0f;
+    vector<unsigned int> result = indices;
+    size_t vertexCount = vertices.size();
+    if (radius <= 0.0f)
+        return result;
+
+    // an edge without its reverse is a border or a seam: lock both ends
+    vector<uint8_t> locked(vertexCount, 0);
+    unordered_set<uint64_t> edges;
+    edges.reserve(indices.size());
+    auto edgeKey = [](unsigned int a, unsigned int b) { return ((uint64_t)a << 32) | b; };
+    for (size_t i = 0; i < indices.size(); i += 3)
+        for (int corner = 0; corner < 3; corner++)
+            edges.insert(edgeKey(indices[i + corner], indices[i + (corner + 1) % 3]));
+    for (size_t i = 0; i < indices.size(); i += 3)
+    {
+        for (int corner = 0; corner < 3; corner++)
+        {
+            unsigned int a = indices[i + corner], b = indices[i + (corner + 1) % 3];
+            if (!edges.count(edgeKey(b, a)))
+                locked[a] = locked[b] = 1;
+        }
+    }
+
+    vector<Quadric> quadrics(vertexCount);
+    for (size_t i = 0; i < indices.size(); i += 3)
+    {
+        glm::vec3 p0 = vertices[indices[i]].Position;
+        glm::vec3 p1 = vertices[indices[i + 1]].Position;
+        glm::vec3 p2 = vertices[indices[i + 2]].Position;
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float length = glm::length(normal);
+        if (length == 0.0f)
+            continue;
+        normal /= length;
+        for (int corner = 0; corner < 3; corner++)
+            quadrics[indices[i + corner]].AddPlane(normal, -glm::dot(normal, p0), length * 0.5);
+    }
+
+    double maxCost = (double)errorBound * radius * errorBound * radius;
+    double worstCost = 0.0;
+    vector<unsigned int> offsets, adjacency, remap(vertexCount);
+    vector<uint8_t> touched(vertexCount);
+    vector<Collapse> candidates;
+    while (result.size() > targetIndexCount)
+    {
+        // triangles of each vertex: adjacency[offsets[v], offsets[v + 1])
+        offsets.assign(vertexCount + 1, 0);
+        for (unsigned int index : result)
+            offsets[index + 1]++;
+        for (size_t v = 0; v < vertexCount; v++)
+            offsets[v + 1] += offsets[v];
+        adjacency.resize(result.size());
+        vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < result.size(); i++)
+            adjacency[fill[result[i]]++] = (unsigned int)(i / 3);
+
+        candidates.clear();
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            for (int corner = 0; corner < 3; corner++)
+            {
+                unsigned int a = result[i + corner], b = result[i + (corner + 1) % 3];
+                if (!locked[a])
+                    candidates.push_back({ a, b, quadrics[a].Error(vertices[b].Position) });
+                if (!locked[b])
+                    candidates.push_back({ b, a, quadrics[b].Error(vertices[a].Position) });
+            }
+        }
+        sort(candidates.begin(), candidates.end(),
+             [](const Collapse &x, const Collapse &y) { return x.cost < y.cost; });
+
+        for (size_t v = 0; v < vertexCount; v++)
+            remap[v] = (unsigned int)v;
+        fill_n(touched.begin(), vertexCount, 0);
+        size_t removedTriangles = 0;
+        size_t trianglesToRemove = (result.size() - targetIndexCount + 2) / 3;
+        for (const Collapse &collapse : candidates)
+        {
+            if (collapse.cost > maxCost || removedTriangles >= trianglesToRemove)
+                break;
+            unsigned int a = collapse.from, b = collapse.to;
+            if (touched[a] || touched[b])
+                continue;
+
+            // moving a onto b must not flip any triangle that survives the collapse
+            bool flips = false;
+            size_t collapsing = 0;
+            glm::vec3 target = vertices[b].Position;
+            for (unsigned int j = offsets[a]; j < offsets[a + 1] && !flips; j++)
+            {
+                const unsigned int *triangle = &result[adjacency[j] * 3];
+                if (triangle[0] == b || triangle[1] == b || triangle[2] == b)
+                {
+                    collapsing++;
+                    continue;
+                }
+                glm::vec3 before[3], after[3];
+                for (int corner = 0; corner < 3; corner++)
+                {
+                    before[corner] = vertices[triangle[corner]].Position;
+                    after[corner] = triangle[corner] == a ? target : before[corner];
+                }
+                glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+                glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+                flips = glm::dot(normalBefore, normalAfter) <= 0.0f;
+            }
+            if (flips || collapsing == 0)
+                continue;
+
+            remap[a] = b;
+            quadrics[b].Add(quadrics[a]);
+            // everything around a changed shape: leave it alone until the next pass
+            for (unsigned int j = offsets[a]; j < offsets[a + 1]; j++)
+                for (int corner = 0; corner < 3; corner++)
+                    touched[result[adjacency[j] * 3 + corner]] = 1;
+            removedTriangles += collapsing;
+            worstCost = max(worstCost, collapse.cost);
+        }
+        if (removedTriangles == 0)
+            break;
+
+        size_t kept = 0;
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            unsigned int v0 = remap[result[i]], v1 = remap[result[i + 1]], v2 = remap[result[i + 2]];
+            if (v0 == v1 || v1 == v2 || v0 == v2)
+                continue;
+            result[kept++] = v0;
+            result[kept++] = v1;
+            result[kept++] = v2;
+        }
+        result.resize(kept);
+    }
+    error = (float)(sqrt(worstCost) / radius);
+    return result;
+}
@@ -0,0 +1,44 @@
+#ifndef MESHSIMPLIFIER_HPP
+#define MESHSIMPLIFIER_HPP
+
+#include <vector>
+
+#include "Mesh.hpp"
+
+using namespace std;
+// --------------------- Mesh Simplifier --------------------- //
+/*
+    Builds the LOD chain of a mesh at import: index buffers with fewer
+    triangles over the mesh's own vertices, so every level draws from the same
+    vertex buffer and only the index range changes.
+
+    Simplification is quadric error edge collapse (Garland & Heckbert) where a
+    vertex always collapses onto a neighbour instead of a new position. Every
+    vertex sums the planes of its triangles into a quadric; collapsing a onto
+    b costs a's quadric evaluated at b, i.e. how far b is from the surface a
+    stood for. Each pass sorts the candidate edges by cost and collapses the
+    cheapest ones that do not touch a vertex collapsed this pass and do not
+    flip a triangle.
+
+    Vertices on open borders and attribute seams (edges whose two triangles
+    do not share both vertices, because normals or uvs differ) are locked, so
+    silhouettes and texture seams never tear. Errors are relative to the
+    mesh's bounding radius.
+*/
+
+class MeshSimplifier {
+    public:
+        // Levels generated below the full mesh
+        static const unsigned int MAX_LODS = 4;
+
+        // Halves the triangle count per level, each simplified from the full mesh, until a level
+        // would move the surface by more than errorBound or stops getting noticeably smaller.
+        static vector<MeshLod> BuildLods(const MeshData &mesh, float errorBound);
+
+        // Collapses edges until at most targetIndexCount indices are left or the next collapse
+        // costs more than errorBound. error gets the root quadric error of the costliest collapse.
+        static vector<unsigned int> Simplify(const vector<Vertex> &vertices, const vector<unsigned int> &indices,
+                                             size_t targetIndexCount, float errorBound, float radius, float &error);
+};
+
+#endif /* MeshSimplifier_hpp */
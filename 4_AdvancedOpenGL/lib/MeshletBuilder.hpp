@@ -0,0 +1,75 @@
+#ifndef MESHLETBUILDER_HPP
+#define MESHLETBUILDER_HPP
+
+#include <stdint.h>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Frustum.hpp"
+#include "Mesh.hpp"
+
+using namespace std;
+// --------------------- Meshlets --------------------- //
+/*
+    Splits the full mesh of every imported mesh into clusters small enough
+    that a whole one is often off screen or facing away, so dense meshes can
+    be culled in pieces instead of all or nothing.
+
+    Clusters are cut greedily along the index buffer as the vertex cache
+    optimizer left it: a cluster ends when the next triangle would bring it
+    over MAX_VERTICES distinct vertices or MAX_TRIANGLES triangles. The
+    optimized order already walks the surface in small patches, and since
+    the indices are not moved every cluster is a contiguous index range and
+    the cache friendly order is kept.
+
+    Every cluster gets bounds for the frustum test and a normal cone for the
+    backface test: the axis is the mean triangle normal and the cutoff is the
+    sine of the widest angle between it and any triangle normal. A cluster is
+    facing away from eye when
+
+        dot(center - eye, axis) >= cutoff * |center - eye| + radius
+
+    i.e. when every triangle of it would be back-facing from every point of
+    its bounding sphere. Clusters whose normals spread over more than about
+    84 degrees get a cutoff of 1 and are never rejected this way.
+*/
+
+// Clusters tested and rejected over a frame
+struct MeshletStats {
+    unsigned long meshlets = 0;
+    unsigned long frustumCulled = 0;
+    unsigned long coneCulled = 0;
+    unsigned long triangles = 0;
+    unsigned long trianglesCulled = 0;
+    double cullMs = 0.0;
+};
+
+class MeshletBuilder {
+    public:
+        // Cluster limits, the usual mesh shader sizes
+        static const unsigned int MAX_VERTICES = 64;
+        static const unsigned int MAX_TRIANGLES = 124;
+
+        // Clusters covering indices in order; none unless indices are a triangle list
+        static vector<Meshlet> Build(const vector<Vertex> &vertices, const vector<unsigned int> &indices);
+
+        // Sets visible[i] for every meshlet inside frustum and, when eye is given, not facing away
+        // from it. frustum and eye are in the meshlets' space. Returns the number of visible meshlets
+        // and adds the result to the frame's stats.
+        static size_t Cull(const vector<Meshlet> &meshlets, const Frustum &frustum, const glm::vec3 *eye,
+                           vector<uint8_t> &visible);
+        static bool FacesAway(const Meshlet &meshlet, const glm::vec3 &eye);
+
+        // Counts of the last frame closed by FrameCounters::EndFrame
+        static const MeshletStats &Stats() { return stats.LastFrame(); }
+        // Prints last frame's counts and the share of triangles culled
+        static void PrintStats();
+
+    private:
+        static FrameCounter<MeshletStats> stats;
+        static Meshlet finish(const vector<Vertex> &vertices, const vector<unsigned int> &indices,
+                              uint32_t firstIndex, uint32_t triangleCount);
+};
+
+#endif /* MeshletBuilder_hpp */
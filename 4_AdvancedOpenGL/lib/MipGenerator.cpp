@@ -0,0 +1,346 @@
+#include "MipGenerator.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <immintrin.h>
+#define MIPS_USE_SSE 1
+// The AVX2 loops are compiled for AVX2 on their own, whatever the rest of the file is built for,
+// and only run once the CPU says it has it
+#if defined(__GNUC__) || defined(__clang__)
+#define MIPS_USE_AVX2 1
+#define MIPS_AVX2 __attribute__((target("avx2")))
+#elif defined(_MSC_VER)
+#include <intrin.h>
+#define MIPS_USE_AVX2 1
+#define MIPS_AVX2
+#endif
+#endif
+
+const float PI = 3.14159265358979f;
+const int KAISER_TAPS = 6;
+const float KAISER_ALPHA = 4.0f;
+const float KAISER_WIDTH = 1.5f;     // half width of the window, in pixels of the smaller level
+// Linear values are encoded back to sRGB through a table this big, fine enough near black
+const int LINEAR_TO_SRGB_SIZE = 16384;
+
+#ifdef MIPS_USE_AVX2
+static bool cpuHasAvx2()
+{
+#if defined(__AVX2__)
+    return true;
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    // the OS has to save the 256 bit registers too
+    __cpuid(info, 1);
+    if (!(info[2] & (1 << 27)) || (_xgetbv(0) & 6) != 6)
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+static bool useAvx2()
+{
+    static const bool supported = cpuHasAvx2();
+    return supported;
+}
+#endif
+
+const char *MipGenerator::InstructionSet()
+{
+#if defined(MIPS_USE_AVX2)
+    if (useAvx2())
+        return "AVX2";
+#endif
+#if defined(MIPS_USE_SSE)
+    return "SSE";
+#else
+    return "scalar";
+#endif
+}
+
+// The tables are built once, on whichever decoding thread gets here first; static initialization is thread-safe
+static const float *srgbToLinear()
+{
+    static const array<float, 256> table = []() {
+        array<float, 256> values;
+        for (int i = 0; i < 256; i++)
+        {
+            float s = i / 255.0f;
+            values[i] = s <= 0.04045f ? s / 12.92f : powf((s + 0.055f) / 1.055f, 2.4f);
+        }
+        return values;
+    }();
+    return table.data();
+}
+
+static const float *unormToFloat()
+{
+    static const array<float, 256> table = []() {
+        array<float, 256> values;
+        for (int i = 0; i < 256; i++)
+            values[i] = i / 255.0f;
+        return values;
+    }();
+    return table.data();
+}
+
+static const uint8_t *linearToSrgb()
+{
+    static const array<uint8_t, LINEAR_TO_SRGB_SIZE> table = []() {
+        array<uint8_t, LINEAR_TO_SRGB_SIZE> values;
+        for (int i = 0; i < LINEAR_TO_SRGB_SIZE; i++)
+        {
+            float l = (float)i / (LINEAR_TO_SRGB_SIZE - 1);
+            float s = l <= 0.0031308f ? l * 12.92f : 1.055f * powf(l, 1.0f / 2.4f) - 0.055f;
+            values[i] = (uint8_t)lroundf(s * 255.0f);
+        }
+        return values;
+    }();
+    return table.data();
+}
+
+// Taps around the two source texels under every destination texel: texel 2x + first + k gets weights[k]
+struct Kernel {
+    int first;
+    vector<float> weights;
+};
+
+static float besselI0(float x)
+{
+    // power series, converges quickly for the alphas used here
+    float sum = 1.0f, term = 1.0f;
+    for (int k = 1; k < 20; k++)
+    {
+        term *= (x / (2.0f * k)) * (x / (2.0f * k));
+        sum += term;
+    }
+    return sum;
+}
+
+static Kernel makeKernel(MipFilter filter)
+{
+    Kernel kernel;
+    if (filter == MipFilter::Box)
+    {
+        kernel.first = 0;
+        kernel.weights = { 0.5f, 0.5f };
+        return kernel;
+    }
+    kernel.first = 1 - KAISER_TAPS / 2;
+    float sum = 0.0f;
+    for (int k = 0; k < KAISER_TAPS; k++)
+    {
+        // distance from the destination texel's center, in destination texels
+        float t = (kernel.first + k + 0.5f - 1.0f) * 0.5f;
+        float sinc = t == 0.0f ? 1.0f : sinf(PI * t) / (PI * t);
+        float ratio = t / KAISER_WIDTH;
+        float window = besselI0(KAISER_ALPHA * sqrtf(max(1.0f - ratio * ratio, 0.0f))) / besselI0(KAISER_ALPHA);
+        kernel.weights.push_back(sinc * window);
+        sum += sinc * window;
+    }
+    for (float &weight : kernel.weights)
+        weight /= sum;
+    return kernel;
+}
+
+#ifdef MIPS_USE_AVX2
+// filterVertical's 8 floats at a time loop; returns how many it filtered
+MIPS_AVX2 static size_t filterVerticalAvx2(const float *const *rows, const vector<float> &weights, float *out,
+                                           size_t count)
+{
+    size_t i = 0;
+    size_t taps = weights.size();
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 sum = _mm256_mul_ps(_mm256_set1_ps(weights[0]), _mm256_loadu_ps(rows[0] + i));
+        for (size_t k = 1; k < taps; k++)
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(weights[k]), _mm256_loadu_ps(rows[k] + i)));
+        _mm256_storeu_ps(out + i, sum);
+    }
+    return i;
+}
+#endif
+
+// out[i] = sum of weights[k] * rows[k][i]
+static void filterVertical(const float *const *rows, const vector<float> &weights, float *out, size_t count,
+                           bool scalar)
+{
+    size_t i = 0;
+    size_t taps = weights.size();
+#ifdef MIPS_USE_AVX2
+    if (!scalar && useAvx2())
+        i = filterVerticalAvx2(rows, weights, out, count);
+#endif
+#ifdef MIPS_USE_SSE
+    if (!scalar)
+    {
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 sum = _mm_mul_ps(_mm_set1_ps(weights[0]), _mm_loadu_ps(rows[0] + i));
+            for (size_t k = 1; k < taps; k++)
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(rows[k] + i)));
+            _mm_storeu_ps(out + i, sum);
+        }
+    }
+#endif
+    for (; i < count; i++)
+    {
+        float sum = 0.0f;
+        for (size_t k = 0; k < taps; k++)
+            sum += weights[k] * rows[k][i];
+        out[i] = sum;
+    }
+}
+
+#ifdef MIPS_USE_AVX2
+// filterHorizontal's two texels at a time loop, for 3 and 4 channels; returns how many texels it wrote
+MIPS_AVX2 static int filterHorizontalAvx2(const float *in, int width, int channels, const Kernel &kernel,
+                                          float *out, int newWidth)
+{
+    int taps = (int)kernel.weights.size();
+    int x = 0;
+    for (; x + 2 <= newWidth; x += 2)
+    {
+        __m256 sum = _mm256_setzero_ps();
+        for (int k = 0; k < taps; k++)
+        {
+            int left = min(max(2 * x + kernel.first + k, 0), width - 1);
+            int right = min(max(2 * x + 2 + kernel.first + k, 0), width - 1);
+            __m256 texels = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(in + left * channels)),
+                                                 _mm_loadu_ps(in + right * channels), 1);
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(kernel.weights[k]), texels));
+        }
+        _mm_storeu_ps(out + x * channels, _mm256_castps256_ps128(sum));
+        _mm_storeu_ps(out + (x + 1) * channels, _mm256_extractf128_ps(sum, 1));
+    }
+    return x;
+}
+#endif
+
+// Halves one row of width texels. With 3 or 4 channels a texel fits one SSE register: 3 channel
+// texels are loaded and stored 4 floats at a time, so in and out need one float of padding past
+// the row, and the fourth lane a store writes is overwritten by the next texel's.
+static void filterHorizontal(const float *in, int width, int channels, const Kernel &kernel, float *out,
+                             int newWidth, bool scalar)
+{
+    int taps = (int)kernel.weights.size();
+    int x = 0;
+#ifdef MIPS_USE_AVX2
+    if (!scalar && channels >= 3 && useAvx2())
+        x = filterHorizontalAvx2(in, width, channels, kernel, out, newWidth);
+#endif
+#ifdef MIPS_USE_SSE
+    if (!scalar && channels >= 3)
+    {
+        for (; x < newWidth; x++)
+        {
+            __m128 sum = _mm_setzero_ps();
+            for (int k = 0; k < taps; k++)
+            {
+                int source = min(max(2 * x + kernel.first + k, 0), width - 1);
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(kernel.weights[k]),
+                                                 _mm_loadu_ps(in + source * channels)));
+            }
+            _mm_storeu_ps(out + x * channels, sum);
+        }
+    }
+#endif
+    for (; x < newWidth; x++)
+    {
+        for (int c = 0; c < channels; c++)
+        {
+            float sum = 0.0f;
+            for (int k = 0; k < taps; k++)
+                sum += kernel.weights[k] * in[min(max(2 * x + kernel.first + k, 0), width - 1) * channels + c];
+            out[x * channels + c] = sum;
+        }
+    }
+}
+
+MipLevel MipGenerator::Downsample(const uint8_t *pixels, int width, int height, int channels, MipFilter filter,
+                                  bool srgb, bool scalar)
+{
+    MipLevel level;
+    level.width = max(width / 2, 1);
+    level.height = max(height / 2, 1);
+    level.pixels.resize((size_t)level.width * level.height * channels);
+
+    // which channels go through the sRGB curve: all but alpha
+    bool encoded[4];
+    const float *toFloat[4];
+    for (int c = 0; c < channels; c++)
+    {
+        encoded[c] = srgb && !((channels == 2 || channels == 4) && c == channels - 1);
+        toFloat[c] = encoded[c] ? srgbToLinear() : unormToFloat();
+    }
+    const uint8_t *toSrgb = linearToSrgb();
+
+    Kernel kernel = makeKernel(filter);
+    int taps = (int)kernel.weights.size();
+    size_t rowFloats = (size_t)width * channels;
+    // the rows one output row needs are a sliding window: keep the last few converted
+    int slots = taps + 2;
+    vector<float> ring((size_t)slots * rowFloats);
+    vector<int> rowInSlot(slots, -1);
+    vector<const float *> rows(taps);
+    // one float of padding for filterHorizontal's 3 channel loads and stores
+    vector<float> filtered(rowFloats + 1), outRow((size_t)level.width * channels + 1);
+
+    for (int y = 0; y < level.height; y++)
+    {
+        for (int k = 0; k < taps; k++)
+        {
+            int source = min(max(2 * y + kernel.first + k, 0), height - 1);
+            int slot = source % slots;
+            float *row = &ring[(size_t)slot * rowFloats];
+            if (rowInSlot[slot] != source)
+            {
+                const uint8_t *in = pixels + (size_t)source * rowFloats;
+                for (size_t i = 0; i < rowFloats; i += channels)
+                    for (int c = 0; c < channels; c++)
+                        row[i + c] = toFloat[c][in[i + c]];
+                rowInSlot[slot] = source;
+            }
+            rows[k] = row;
+        }
+        filterVertical(rows.data(), kernel.weights, filtered.data(), rowFloats, scalar);
+        filterHorizontal(filtered.data(), width, channels, kernel, outRow.data(), level.width, scalar);
+
+        uint8_t *out = &level.pixels[(size_t)y * level.width * channels];
+        for (size_t i = 0; i < (size_t)level.width * channels; i += channels)
+        {
+            for (int c = 0; c < channels; c++)
+            {
+                // Kaiser rings past the ends of the range
+                float value = min(max(outRow[i + c], 0.0f), 1.0f);
+                out[i + c] = encoded[c] ? toSrgb[(int)(value * (LINEAR_TO_SRGB_SIZE - 1) + 0.5f)]
+                                        : (uint8_t)(value * 255.0f + 0.5f);
+            }
+        }
+    }
+    return level;
+}
+
+vector<MipLevel> MipGenerator::Generate(const uint8_t *pixels, int width, int height, int channels,
+                                        MipFilter filter, bool srgb, bool scalar)
+{
+    vector<MipLevel> levels;
+    while (width > 1 || height > 1)
+    {
+        levels.push_back(Downsample(pixels, width, height, channels, filter, srgb, scalar));
+        pixels = levels.back().pixels.data();
+        width = levels.back().width;
+        height = levels.back().height;
+    }
+    return levels;
+}
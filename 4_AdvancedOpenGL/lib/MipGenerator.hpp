@@ -0,0 +1,62 @@
+#ifndef MIPGENERATOR_HPP
+#define MIPGENERATOR_HPP
+
+#include <stdint.h>
+#include <vector>
+
+using namespace std;
+// --------------------- Mip Generator --------------------- //
+/*
+    Builds mip chains on the CPU, so they can be made on a worker thread and
+    uploaded level by level (TextureCache) or baked into KTX2 files
+    (texbake) instead of leaving it to glGenerateMipmap.
+
+    Color is averaged in linear light: with srgb set, the color channels go
+    through the sRGB curve into linear floats, are filtered, and are encoded
+    back, while alpha is filtered as is. glGenerateMipmap on a texture that
+    is not GL_SRGB8 averages the encoded values, which darkens every level.
+
+    Filters, both separable and both halving the image:
+        Box     2x2 average.
+        Kaiser  6 taps per axis of a sinc windowed by a Kaiser window
+                (alpha 4); keeps more detail in the smaller levels at the
+                cost of a little ringing, which is clamped.
+
+    Each output row filters its source rows vertically into one float row,
+    then filters that horizontally. The vertical loop runs on 8 floats at a
+    time with AVX2, 4 with SSE, or one at a time otherwise. The AVX2 loops are
+    built into every x86 binary and picked at run time when the CPU has AVX2. The horizontal one runs on two texels at a time with AVX2
+    and one with SSE for 3 and 4 channel images; 1 and 2 channel images run
+    it scalar. Source rows are converted to linear floats once each, in a small
+    ring, so a 4K level never needs a float copy of the whole image.
+*/
+
+enum class MipFilter {
+    Box,
+    Kaiser
+};
+
+// One level of a mip chain, tightly packed 8-bit texels
+struct MipLevel {
+    int width = 0;
+    int height = 0;
+    vector<uint8_t> pixels;
+};
+
+class MipGenerator {
+    public:
+        // Levels 1 and down of a width x height image with channels 1-4, each half the size
+        // of the one before, down to 1x1. The last channel of 2 and 4 channel images is alpha.
+        // scalar runs the scalar loops even where SIMD ones were built, for comparisons.
+        // Safe to call from several threads at once.
+        static vector<MipLevel> Generate(const uint8_t *pixels, int width, int height, int channels,
+                                         MipFilter filter, bool srgb, bool scalar = false);
+        // The level below a width x height image
+        static MipLevel Downsample(const uint8_t *pixels, int width, int height, int channels,
+                                   MipFilter filter, bool srgb, bool scalar = false);
+
+        // "AVX2", "SSE" or "scalar": what the filter loops run with on this CPU
+        static const char *InstructionSet();
+};
+
+#endif /* MipGenerator_hpp */
@@ -0,0 +1,413 @@
+#include "RenderQueue.hpp"
+#include "GLState.hpp"
+#include "Mesh.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+vector<RenderQueue::Material> RenderQueue::materials;
+unordered_map<string, unsigned int> RenderQueue::materialIds;
+vector<unsigned int> RenderQueue::freeMaterialIds;
+bool RenderQueue::indirectEnabled = true;
+
+// Field widths of the sort key, most significant first
+const int KEY_PASS_BITS     = 2;
+const int KEY_SHADER_BITS   = 10;
+const int KEY_MATERIAL_BITS = 16;
+const int KEY_VAO_BITS      = 16;
+const int KEY_DEPTH_BITS    = 20;
+static_assert(KEY_PASS_BITS + KEY_SHADER_BITS + KEY_MATERIAL_BITS + KEY_VAO_BITS + KEY_DEPTH_BITS == 64,
+              "sort key fields must fill 64 bits");
+
+static string materialSignature(const vector<unsigned int> &textures, const vector<string> &samplers, GLenum target)
+{
+    string signature = to_string(target) + "|";
+    for (size_t i = 0; i < textures.size(); i++)
+        signature += to_string(textures[i]) + ":" + (i < samplers.size() ? samplers[i] : string()) + ";";
+    return signature;
+}
+
+unsigned int RenderQueue::RegisterMaterial(const vector<unsigned int> &textures, const vector<string> &samplers,
+                                           GLenum target)
+{
+    string signature = materialSignature(textures, samplers, target);
+    auto it = materialIds.find(signature);
+    if (it != materialIds.end())
+    {
+        materials[it->second].references++;
+        return it->second;
+    }
+
+    Material material;
+    material.textures = textures;
+    material.samplers = samplers;
+    material.target = target;
+    material.references = 1;
+    unsigned int id;
+    if (!freeMaterialIds.empty())
+    {
+        id = freeMaterialIds.back();
+        freeMaterialIds.pop_back();
+        materials[id] = material;
+    }
+    else
+    {
+        id = (unsigned int)materials.size();
+        materials.push_back(material);
+    }
+    if (id >= (1u << KEY_MATERIAL_BITS))
+        cout << "ERROR::RENDERQUEUE::TOO_MANY_MATERIALS: " << id + 1 << " live materials, draws of some will not sort apart" << endl;
+    materialIds[signature] = id;
+    return id;
+}
+
+void RenderQueue::ReleaseMaterial(unsigned int materialId)
+{
+    if (materialId >= materials.size() || materials[materialId].references == 0)
+        return;
+    Material &material = materials[materialId];
+    if (--material.references > 0)
+        return;
+    materialIds.erase(materialSignature(material.textures, material.samplers, material.target));
+    material = Material();
+    freeMaterialIds.push_back(materialId);
+}
+
+void RenderQueue::ReplaceTextures(unsigned int materialId, const vector<unsigned int> &textures)
+{
+    if (materialId >= materials.size())
+        return;
+    Material &material = materials[materialId];
+    materialIds.erase(materialSignature(material.textures, material.samplers, material.target));
+    material.textures = textures;
+    materialIds[materialSignature(material.textures, material.samplers, material.target)] = materialId;
+}
+
+void RenderQueue::Begin(const glm::mat4 &view, float depthRange)
+{
+    this->view = view;
+    this->depthRange = depthRange;
+    items.clear();
+    keys.clear();
+}
+
+void RenderQueue::Submit(Shader &shader, unsigned int vao, unsigned int materialId, const glm::mat4 &model,
+                         GLenum mode, GLsizei count, GLenum indexType, bool transparent,
+                         size_t indexOffset, GLint baseVertex, unsigned int layer)
+{
+    DrawItem item;
+    item.shader = &shader;
+    item.vao = vao;
+    item.materialId = materialId;
+    item.mode = mode;
+    item.count = count;
+    item.indexType = indexType;
+    item.indexOffset = indexOffset;
+    item.baseVertex = baseVertex;
+    item.layer = layer;
+    item.model = model;
+    keys.push_back(makeKey(item, transparent));
+    items.push_back(item);
+    if (mode == GL_TRIANGLES)
+        frame.ThisFrame().triangles += count / 3;
+    if (layered(item))
+        frame.ThisFrame().layeredDraws++;
+}
+
+uint64_t RenderQueue::makeKey(const DrawItem &item, bool transparent) const
+{
+    // view space depth of the draw's origin, quantized into the low bits
+    glm::vec4 position = view * item.model[3];
+    float depth = glm::clamp(-position.z / depthRange, 0.0f, 1.0f);
+    uint64_t maxDepth = (1ull << KEY_DEPTH_BITS) - 1;
+    uint64_t depthBits = (uint64_t)(depth * maxDepth);
+    if (transparent)
+        depthBits = maxDepth - depthBits;  // back to front
+
+    uint64_t key = transparent ? 1 : 0;
+    key = (key << KEY_SHADER_BITS) | (item.shader->ID & ((1u << KEY_SHADER_BITS) - 1));
+    key = (key << KEY_MATERIAL_BITS) | (item.materialId & ((1u << KEY_MATERIAL_BITS) - 1));
+    key = (key << KEY_VAO_BITS) | (item.vao & ((1u << KEY_VAO_BITS) - 1));
+    key = (key << KEY_DEPTH_BITS) | depthBits;
+    return key;
+}
+
+// LSD radix sort of the keys, one byte per pass. Passes where every key has the
+// same byte are skipped, which drops most of them for typical scenes.
+void RenderQueue::radixSort()
+{
+    size_t count = keys.size();
+    sortKeys = keys;
+    order.resize(count);
+    for (uint32_t i = 0; i < count; i++)
+        order[i] = i;
+    sortScratchKeys.resize(count);
+    scratchOrder.resize(count);
+
+    for (int shift = 0; shift < 64; shift += 8)
+    {
+        size_t histogram[256] = { 0 };
+        for (size_t i = 0; i < count; i++)
+            histogram[(sortKeys[i] >> shift) & 0xFF]++;
+        if (histogram[(sortKeys[0] >> shift) & 0xFF] == count)
+            continue;
+
+        size_t offset = 0;
+        for (size_t &bucket : histogram)
+        {
+            size_t size = bucket;
+            bucket = offset;
+            offset += size;
+        }
+        for (size_t i = 0; i < count; i++)
+        {
+            size_t destination = histogram[(sortKeys[i] >> shift) & 0xFF]++;
+            sortScratchKeys[destination] = sortKeys[i];
+            scratchOrder[destination] = order[i];
+        }
+        sortKeys.swap(sortScratchKeys);
+        order.swap(scratchOrder);
+    }
+}
+
+void RenderQueue::countStateChanges(const vector<uint32_t> &sequence, int slot)
+{
+    RenderQueueStats &thisFrame = frame.ThisFrame();
+    const DrawItem *previous = nullptr;
+    for (uint32_t index : sequence)
+    {
+        const DrawItem &item = items[index];
+        bool shaderChanged = !previous || previous->shader != item.shader;
+        if (shaderChanged)
+            thisFrame.shaderChanges[slot]++;
+        // a new program needs its samplers set again, so it counts as a material change too
+        if (shaderChanged || previous->materialId != item.materialId)
+            thisFrame.materialChanges[slot]++;
+        if (!previous || previous->vao != item.vao)
+            thisFrame.vaoChanges[slot]++;
+        previous = &item;
+    }
+}
+
+void RenderQueue::BindMaterial(Shader &shader, unsigned int materialId)
+{
+    if (materialId >= materials.size())
+        return;
+    const Material &material = materials[materialId];
+    for (unsigned int i = 0; i < material.textures.size(); i++)
+    {
+        GLState::Instance().BindTextureUnit(i, material.target, material.textures[i]);
+        if (i < material.samplers.size())
+            shader.setInt(shader.GetUniform(material.samplers[i]), i);
+    }
+}
+
+bool RenderQueue::IndirectSupported()
+{
+    return GLEW_VERSION_4_3 || GLEW_ARB_multi_draw_indirect;
+}
+
+void RenderQueue::SetIndirect(bool enabled)
+{
+    indirectEnabled = enabled;
+}
+
+bool RenderQueue::IndirectActive()
+{
+    return indirectEnabled && IndirectSupported();
+}
+
+bool RenderQueue::LayerMergingActive()
+{
+    return IndirectActive() && (GLEW_VERSION_4_2 || GLEW_ARB_base_instance);
+}
+
+bool RenderQueue::layered(const DrawItem &item)
+{
+    return item.materialId < materials.size() && materials[item.materialId].target == GL_TEXTURE_2D_ARRAY;
+}
+
+bool RenderQueue::mergeable(const DrawItem &a, const DrawItem &b, bool mergeLayers)
+{
+    return a.indexType && a.shader == b.shader && a.materialId == b.materialId && a.vao == b.vao &&
+           a.mode == b.mode && a.indexType == b.indexType && (mergeLayers || a.layer == b.layer) &&
+           memcmp(&a.model, &b.model, sizeof(a.model)) == 0;
+}
+
+void RenderQueue::Flush()
+{
+    if (items.empty())
+        return;
+
+    // submission order, for the report
+    order.resize(items.size());
+    for (uint32_t i = 0; i < items.size(); i++)
+        order[i] = i;
+    countStateChanges(order, 0);
+
+    radixSort();
+    countStateChanges(order, 1);
+    frame.ThisFrame().draws += (unsigned int)items.size();
+
+    auto submitStart = chrono::steady_clock::now();
+    bool indirect = IndirectActive();
+    bool anyLayered = false;
+    for (const DrawItem &item : items)
+        anyLayered = anyLayered || layered(item);
+    // with base instances every command reads its own layer; without, a layer is one constant per draw call
+    bool perCommandLayers = anyLayered && indirect && LayerMergingActive();
+    // runs of draws that go out as one call
+    runs.clear();
+    for (uint32_t i = 0; i < order.size(); )
+    {
+        uint32_t end = i + 1;
+        while (end < order.size() && mergeable(items[order[i]], items[order[end]], perCommandLayers))
+            end++;
+        runs.push_back({ i, end });
+        i = end;
+    }
+    if (indirect)
+        uploadCommands(perCommandLayers);
+
+    const DrawItem *previous = nullptr;
+    UniformHandle modelUniform;
+    size_t command = 0;
+    // whether the bound vertex array reads LAYER_ATTRIBUTE from the layer buffer, and the constant value otherwise
+    bool layerArrayEnabled = false;
+    GLuint layerValue = ~0u;
+    for (const Run &run : runs)
+    {
+        const DrawItem &item = items[order[run.first]];
+        bool shaderChanged = !previous || previous->shader != item.shader;
+        if (shaderChanged)
+        {
+            item.shader->Activate();
+            modelUniform = item.shader->GetUniform("model");
+        }
+        if (shaderChanged || previous->materialId != item.materialId)
+            BindMaterial(*item.shader, item.materialId);
+        if (!previous || previous->vao != item.vao)
+        {
+            // the attribute array is state of the vertex array: turn it off before leaving it
+            if (layerArrayEnabled)
+                glDisableVertexAttribArray(LAYER_ATTRIBUTE);
+            layerArrayEnabled = false;
+            GLState::Instance().BindVertexArray(item.vao);
+        }
+        if (layered(item) && perCommandLayers && !layerArrayEnabled)
+        {
+            GLState::Instance().BindBuffer(GL_ARRAY_BUFFER, layerBuffer);
+            glVertexAttribIPointer(LAYER_ATTRIBUTE, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+            glVertexAttribDivisor(LAYER_ATTRIBUTE, 1);
+            glEnableVertexAttribArray(LAYER_ATTRIBUTE);
+            layerArrayEnabled = true;
+        }
+        else if (layered(item) && !perCommandLayers && item.layer != layerValue)
+        {
+            glVertexAttribI1ui(LAYER_ATTRIBUTE, item.layer);
+            layerValue = item.layer;
+        }
+
+        item.shader->setMat4(modelUniform, item.model);
+        GLsizei drawCount = (GLsizei)(run.end - run.first);
+        if (!item.indexType)
+            glDrawArrays(item.mode, 0, item.count);
+        else if (indirect)
+        {
+            glMultiDrawElementsIndirect(item.mode, item.indexType,
+                                        (void*)(command * sizeof(DrawElementsIndirectCommand)), drawCount, 0);
+            command += drawCount;
+        }
+        else if (drawCount == 1)
+            glDrawElementsBaseVertex(item.mode, item.count, item.indexType, (void*)item.indexOffset, item.baseVertex);
+        else
+        {
+            batchCounts.clear();
+            batchOffsets.clear();
+            batchBaseVertices.clear();
+            for (uint32_t j = run.first; j < run.end; j++)
+            {
+                const DrawItem &merged = items[order[j]];
+                batchCounts.push_back(merged.count);
+                batchOffsets.push_back((const void *)merged.indexOffset);
+                batchBaseVertices.push_back(merged.baseVertex);
+            }
+            glMultiDrawElementsBaseVertex(item.mode, batchCounts.data(), item.indexType, batchOffsets.data(),
+                                          drawCount, batchBaseVertices.data());
+        }
+        frame.ThisFrame().drawCalls++;
+        previous = &item;
+    }
+    if (layerArrayEnabled)
+        glDisableVertexAttribArray(LAYER_ATTRIBUTE);
+    frame.ThisFrame().submitMs += chrono::duration<double, milli>(chrono::steady_clock::now() - submitStart).count();
+    frame.ThisFrame().indirect = indirect;
+
+    items.clear();
+    keys.clear();
+}
+
+void RenderQueue::uploadCommands(bool perCommandLayers)
+{
+    commands.clear();
+    commandLayers.clear();
+    for (const Run &run : runs)
+    {
+        if (!items[order[run.first]].indexType)
+            continue;
+        for (uint32_t j = run.first; j < run.end; j++)
+        {
+            const DrawItem &item = items[order[j]];
+            DrawElementsIndirectCommand command;
+            command.count = (GLuint)item.count;
+            command.instanceCount = 1;
+            // counted in indices, not bytes; index ranges are aligned to their index size
+            command.firstIndex = (GLuint)(item.indexOffset / Mesh::IndexSize(item.indexType));
+            command.baseVertex = item.baseVertex;
+            // the base instance only offsets instanced attributes: for layered draws, the layer buffer
+            command.baseInstance = perCommandLayers && layered(item) ? (GLuint)commands.size() : 0;
+            commands.push_back(command);
+            commandLayers.push_back(item.layer);
+        }
+    }
+    if (commands.empty())
+        return;
+    if (indirectBuffer == 0)
+        glGenBuffers(1, &indirectBuffer);
+    GLState::Instance().BindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+    // respecified every flush so the driver can hand out fresh storage instead of waiting on the last frame's
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand),
+                 commands.data(), GL_STREAM_DRAW);
+    if (!perCommandLayers)
+        return;
+    if (layerBuffer == 0)
+        glGenBuffers(1, &layerBuffer);
+    GLState::Instance().BindBuffer(GL_ARRAY_BUFFER, layerBuffer);
+    glBufferData(GL_ARRAY_BUFFER, commandLayers.size() * sizeof(GLuint), commandLayers.data(), GL_STREAM_DRAW);
+}
+
+void RenderQueue::Delete()
+{
+    for (GLuint *buffer : { &indirectBuffer, &layerBuffer })
+    {
+        if (*buffer == 0)
+            continue;
+        glDeleteBuffers(1, buffer);
+        GLState::Instance().BufferDeleted(*buffer);
+        *buffer = 0;
+    }
+}
+
+void RenderQueue::PrintStats() const
+{
+    const RenderQueueStats &lastFrame = frame.LastFrame();
+    cout << "RenderQueue: " << lastFrame.draws << " draws (" << lastFrame.triangles << " triangles) in " << lastFrame.drawCalls
+         << (lastFrame.indirect ? " indirect" : "") << " draw calls, " << lastFrame.submitMs << " ms to submit; program/material/VAO changes "
+         << lastFrame.shaderChanges[0] << "/" << lastFrame.materialChanges[0] << "/" << lastFrame.vaoChanges[0]
+         << " in submission order, " << lastFrame.shaderChanges[1] << "/" << lastFrame.materialChanges[1] << "/"
+         << lastFrame.vaoChanges[1] << " sorted" << endl;
+    if (lastFrame.layeredDraws > 0)
+        cout << "RenderQueue: " << lastFrame.layeredDraws << " draws from texture array layers, "
+             << (LayerMergingActive() ? "merged across layers" : "merged per layer") << endl;
+}
@@ -0,0 +1,114 @@
+#include "SceneGraph.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+uint32_t SceneGraph::AddNode(uint32_t parent, const glm::mat4 &local, const string &name)
+{
+    uint32_t node = (uint32_t)parents.size();
+    if (parent != NO_NODE && parent >= node)
+    {
+        cout << "ERROR::SCENEGRAPH::Parent " << parent << " of node " << name << " does not exist yet" << endl;
+        parent = NO_NODE;
+    }
+    parents.push_back(parent);
+    subtreeEnds.push_back(node + 1);
+    locals.push_back(local);
+    worlds.push_back(local);
+    names.push_back(name);
+    firstMeshes.push_back((uint32_t)meshRefs.size());
+    meshCounts.push_back(0);
+
+    dirtyNodes.push_back(node);
+    subtreesValid = false;
+    return node;
+}
+
+void SceneGraph::AddMesh(uint32_t node, uint32_t mesh)
+{
+    if (node + 1 != parents.size())
+    {
+        cout << "ERROR::SCENEGRAPH::Meshes can only be added to the last node, not " << node << endl;
+        return;
+    }
+    meshRefs.push_back(mesh);
+    meshCounts[node]++;
+}
+
+void SceneGraph::Clear()
+{
+    parents.clear();
+    subtreeEnds.clear();
+    locals.clear();
+    worlds.clear();
+    names.clear();
+    firstMeshes.clear();
+    meshCounts.clear();
+    meshRefs.clear();
+    dirtyNodes.clear();
+    updatedRanges.clear();
+    subtreesValid = true;
+}
+
+uint32_t SceneGraph::Find(const string &name) const
+{
+    for (uint32_t node = 0; node < names.size(); node++)
+        if (names[node] == name)
+            return node;
+    return NO_NODE;
+}
+
+void SceneGraph::SetLocal(uint32_t node, const glm::mat4 &local)
+{
+    locals[node] = local;
+    dirtyNodes.push_back(node);
+}
+
+// Children come after their parent, so one backwards pass pushes every subtree's end up to its root
+void SceneGraph::computeSubtreeEnds()
+{
+    for (uint32_t node = 0; node < parents.size(); node++)
+        subtreeEnds[node] = node + 1;
+    for (uint32_t node = (uint32_t)parents.size(); node-- > 0;)
+        if (parents[node] != NO_NODE)
+            subtreeEnds[parents[node]] = max(subtreeEnds[parents[node]], subtreeEnds[node]);
+    subtreesValid = true;
+}
+
+size_t SceneGraph::Update()
+{
+    auto start = chrono::steady_clock::now();
+    updatedRanges.clear();
+    if (dirtyNodes.empty())
+    {
+        lastUpdate = SceneGraphUpdate();
+        return 0;
+    }
+    if (!subtreesValid)
+        computeSubtreeEnds();
+
+    // in node order a dirty node inside an already updated range has been handled with it
+    sort(dirtyNodes.begin(), dirtyNodes.end());
+    size_t updated = 0;
+    uint32_t coveredEnd = 0;
+    for (uint32_t dirty : dirtyNodes)
+    {
+        if (dirty < coveredEnd)
+            continue;
+        uint32_t end = subtreeEnds[dirty];
+        for (uint32_t node = dirty; node < end; node++)
+        {
+            uint32_t parent = parents[node];
+            worlds[node] = parent == NO_NODE ? locals[node] : worlds[parent] * locals[node];
+        }
+        updatedRanges.push_back({ dirty, end });
+        updated += end - dirty;
+        coveredEnd = end;
+    }
+    dirtyNodes.clear();
+
+    lastUpdate.nodesUpdated = updated;
+    lastUpdate.ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    return updated;
+}
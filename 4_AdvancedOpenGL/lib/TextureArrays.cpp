@@ -0,0 +1,301 @@
+#include "TextureArrays.hpp"
+#include "GLState.hpp"
+#include "RenderQueue.hpp"
+#include "TextureUploader.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+#include "stb_image.h"
+
+TextureArrays &TextureArrays::Instance()
+{
+    static TextureArrays arrays;
+    return arrays;
+}
+
+bool TextureArrays::Acquire(const vector<string> &paths, const vector<bool> &srgb, const vector<string> &samplers,
+                            ArrayMaterial &material)
+{
+    string key;
+    for (const string &path : paths)
+        key += path + ";";
+    auto found = entries.find(key);
+    if (found != entries.end())
+    {
+        found->second.refCount++;
+        material.materialId = pools[found->second.pool].materialId;
+        material.layer = found->second.layer;
+        return true;
+    }
+
+    vector<DecodedImage> images;
+    bool loaded = true;
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        images.push_back(TextureCache::Instance().Decode(paths[i], i < srgb.size() && srgb[i]));
+        if (!images.back().pixels)
+        {
+            cout << "ERROR::TEXTUREARRAYS::Could not load " << paths[i] << endl;
+            loaded = false;
+            break;
+        }
+    }
+    bool acquired = loaded && Acquire(key, images, samplers, material);
+    for (DecodedImage &image : images)
+        stbi_image_free(image.pixels);
+    return acquired;
+}
+
+bool TextureArrays::Acquire(const string &key, const vector<DecodedImage> &images, const vector<string> &samplers,
+                            ArrayMaterial &material)
+{
+    auto found = entries.find(key);
+    if (found != entries.end())
+    {
+        found->second.refCount++;
+        material.materialId = pools[found->second.pool].materialId;
+        material.layer = found->second.layer;
+        return true;
+    }
+    if (images.empty())
+        return false;
+
+    string shape;
+    vector<Slot> slots;
+    for (size_t i = 0; i < images.size(); i++)
+    {
+        const DecodedImage &image = images[i];
+        if (!image.pixels)
+            return false;
+        Slot slot;
+        slot.width = image.width;
+        slot.height = image.height;
+        slot.components = image.components;
+        slot.levels = 1;
+        for (int width = image.width, height = image.height; width > 1 || height > 1; slot.levels++)
+        {
+            width = max(width / 2, 1);
+            height = max(height / 2, 1);
+        }
+        slots.push_back(slot);
+        shape += (i < samplers.size() ? samplers[i] : string()) + ":" + to_string(slot.width) + "x" +
+                 to_string(slot.height) + "x" + to_string(slot.components) + ";";
+    }
+
+    size_t poolIndex;
+    auto shaped = poolByShape.find(shape);
+    if (shaped != poolByShape.end())
+        poolIndex = shaped->second;
+    else
+    {
+        poolIndex = pools.size();
+        pools.emplace_back();
+        Pool &created = pools.back();
+        created.slots = slots;
+        grow(created);
+        vector<unsigned int> arrays;
+        for (const Slot &slot : created.slots)
+            arrays.push_back(slot.array);
+        created.materialId = RenderQueue::RegisterMaterial(arrays, samplers, GL_TEXTURE_2D_ARRAY);
+        poolByShape[shape] = poolIndex;
+        stats.pools++;
+    }
+    Pool &pool = pools[poolIndex];
+
+    unsigned int layer;
+    if (!pool.freeLayers.empty())
+    {
+        layer = pool.freeLayers.back();
+        pool.freeLayers.pop_back();
+    }
+    else
+    {
+        if (pool.used == pool.capacity)
+            grow(pool);
+        layer = pool.used++;
+    }
+
+    for (size_t i = 0; i < images.size(); i++)
+    {
+        uploadLayer(pool.slots[i], layer, images[i]);
+        stats.usedBytes += layerBytes(pool.slots[i]);
+    }
+    entries[key] = { poolIndex, layer, 1 };
+    stats.materials++;
+    material.materialId = pool.materialId;
+    material.layer = layer;
+    return true;
+}
+
+void TextureArrays::Release(const ArrayMaterial &material)
+{
+    // only ever a handful of materials; a reverse map is not worth keeping up to date
+    for (auto it = entries.begin(); it != entries.end(); ++it)
+    {
+        Pool &pool = pools[it->second.pool];
+        if (pool.materialId != material.materialId || it->second.layer != material.layer)
+            continue;
+        if (--it->second.refCount > 0)
+            return;
+        pool.freeLayers.push_back(it->second.layer);
+        for (const Slot &slot : pool.slots)
+            stats.usedBytes -= layerBytes(slot);
+        stats.materials--;
+        entries.erase(it);
+        return;
+    }
+}
+
+size_t TextureArrays::layerBytes(const Slot &slot)
+{
+    size_t bytes = 0;
+    int width = slot.width, height = slot.height;
+    for (int level = 0; level < slot.levels; level++)
+    {
+        bytes += (size_t)width * height * slot.components;
+        width = max(width / 2, 1);
+        height = max(height / 2, 1);
+    }
+    return bytes;
+}
+
+GLuint TextureArrays::allocate(const Slot &slot, unsigned int layers)
+{
+    GLuint array;
+    glGenTextures(1, &array);
+    GLState::Instance().BindTexture(GL_TEXTURE_2D_ARRAY, array);
+    GLenum format = TextureUploader::PixelFormat(slot.components);
+    int width = slot.width, height = slot.height;
+    for (int level = 0; level < slot.levels; level++)
+    {
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, level, format, width, height, layers, 0, format, GL_UNSIGNED_BYTE, NULL);
+        width = max(width / 2, 1);
+        height = max(height / 2, 1);
+    }
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    return array;
+}
+
+void TextureArrays::copyLayers(const Slot &slot, GLuint from, GLuint to, unsigned int layers)
+{
+    if (GLEW_VERSION_4_3 || GLEW_ARB_copy_image)
+    {
+        int width = slot.width, height = slot.height;
+        for (int level = 0; level < slot.levels; level++)
+        {
+            glCopyImageSubData(from, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0, to, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0,
+                               width, height, layers);
+            width = max(width / 2, 1);
+            height = max(height / 2, 1);
+        }
+        return;
+    }
+
+    // attach each old layer and level as the read buffer and copy it into the bound new array
+    GLint previousFramebuffer;
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previousFramebuffer);
+    if (copyFramebuffer == 0)
+        glGenFramebuffers(1, &copyFramebuffer);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, copyFramebuffer);
+    GLState::Instance().BindTexture(GL_TEXTURE_2D_ARRAY, to);
+    for (unsigned int layer = 0; layer < layers; layer++)
+    {
+        int width = slot.width, height = slot.height;
+        for (int level = 0; level < slot.levels; level++)
+        {
+            glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, from, level, layer);
+            glCopyTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, 0, 0, width, height);
+            width = max(width / 2, 1);
+            height = max(height / 2, 1);
+        }
+    }
+    glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, 0, 0, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, previousFramebuffer);
+}
+
+void TextureArrays::grow(Pool &pool)
+{
+    unsigned int capacity = pool.capacity ? pool.capacity * 2 : INITIAL_LAYERS;
+    vector<unsigned int> arrays;
+    for (Slot &slot : pool.slots)
+    {
+        GLuint array = allocate(slot, capacity);
+        if (slot.array)
+        {
+            copyLayers(slot, slot.array, array, pool.used);
+            glDeleteTextures(1, &slot.array);
+            GLState::Instance().TextureDeleted(slot.array);
+        }
+        stats.bytes += layerBytes(slot) * (capacity - pool.capacity);
+        slot.array = array;
+        arrays.push_back(array);
+    }
+    if (pool.capacity)
+    {
+        // meshes keep the material id they got; it now binds the new arrays
+        RenderQueue::ReplaceTextures(pool.materialId, arrays);
+        stats.grows++;
+    }
+    pool.capacity = capacity;
+}
+
+void TextureArrays::uploadLayer(const Slot &slot, unsigned int layer, const DecodedImage &image)
+{
+    // TextureCache leaves the mips to glGenerateMipmap when CPU mips are off; make them here instead
+    vector<MipLevel> generated;
+    const vector<MipLevel> *mips = &image.mips;
+    if (mips->empty() && slot.levels > 1)
+    {
+        generated = MipGenerator::Generate(image.pixels, image.width, image.height, image.components,
+                                           MipFilter::Box, image.srgb && image.components >= 3);
+        mips = &generated;
+    }
+
+    GLState &state = GLState::Instance();
+    state.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    state.BindTexture(GL_TEXTURE_2D_ARRAY, slot.array);
+    GLenum format = TextureUploader::PixelFormat(slot.components);
+    // rows of RGB and single channel images are not 4-byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, slot.width, slot.height, 1, format, GL_UNSIGNED_BYTE,
+                    image.pixels);
+    for (size_t level = 0; level < mips->size(); level++)
+    {
+        const MipLevel &mip = (*mips)[level];
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, (GLint)level + 1, 0, 0, layer, mip.width, mip.height, 1, format,
+                        GL_UNSIGNED_BYTE, mip.pixels.data());
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+void TextureArrays::PrintStats() const
+{
+    cout << "TextureArrays: " << stats.materials << " materials in " << stats.pools << " pools, "
+         << stats.usedBytes / 1024 << " of " << stats.bytes / 1024 << " KB in use, grown " << stats.grows
+         << " times" << endl;
+}
+
+void TextureArrays::Delete()
+{
+    GLState &state = GLState::Instance();
+    for (Pool &pool : pools)
+    {
+        for (Slot &slot : pool.slots)
+        {
+            glDeleteTextures(1, &slot.array);
+            state.TextureDeleted(slot.array);
+        }
+        RenderQueue::ReleaseMaterial(pool.materialId);
+    }
+    if (copyFramebuffer)
+        glDeleteFramebuffers(1, &copyFramebuffer);
+    copyFramebuffer = 0;
+    pools.clear();
+    poolByShape.clear();
+    entries.clear();
+    stats = TextureArrayStats();
+}
@@ -0,0 +1,108 @@
+#ifndef TEXTUREARRAYS_HPP
+#define TEXTUREARRAYS_HPP
+
+#include <stddef.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "TextureCache.hpp"
+
+using namespace std;
+// --------------------- Texture Arrays --------------------- //
+/*
+    Packs material textures into GL_TEXTURE_2D_ARRAY pools so that meshes
+    with different materials can be drawn by one call. A pool holds every
+    material whose images have the same sizes and channel counts, sampler
+    by sampler: one array per sampler, and each material takes the same
+    layer in all of them. The pool's arrays are a single render queue
+    material, so its meshes only differ in the layer they pass with each
+    draw (see RenderQueue).
+
+    Pools start at INITIAL_LAYERS layers and double when full. Growing
+    copies the layers already in use on the GPU, with glCopyImageSubData
+    where GL 4.3 or ARB_copy_image has it and through a read framebuffer
+    otherwise. Layers given back are reused; pools never shrink.
+
+    Images are decoded through TextureCache (so a Prefetch of them is used)
+    and always uploaded uncompressed, with their CPU made mip chain: baked
+    KTX2 files are left to TextureCache's 2D textures.
+*/
+
+// Where a material landed: the render queue material of its pool, and its layer in there
+struct ArrayMaterial {
+    unsigned int materialId = 0;
+    unsigned int layer = 0;
+};
+
+struct TextureArrayStats {
+    unsigned int pools = 0;
+    unsigned int materials = 0;     // currently acquired
+    unsigned int grows = 0;
+    size_t bytes = 0;               // GPU memory of every pool, used layers or not
+    size_t usedBytes = 0;           // of the layers in use
+};
+
+class TextureArrays {
+    public:
+        static TextureArrays &Instance();
+
+        // Puts the images at paths (one per sampler) into a layer of the matching pool, or finds the
+        // layer they already have. srgb marks the color images among them, as for TextureCache.
+        // False, with nothing acquired, when any image fails to load.
+        bool Acquire(const vector<string> &paths, const vector<bool> &srgb, const vector<string> &samplers,
+                     ArrayMaterial &material);
+        // Same for images already in memory (made rather than loaded). key tells materials apart for
+        // sharing; images stay the caller's. Mips are made for images without, as their srgb says.
+        bool Acquire(const string &key, const vector<DecodedImage> &images, const vector<string> &samplers,
+                     ArrayMaterial &material);
+        // Drops one reference taken by Acquire; the layer is free for reuse after the last one
+        void Release(const ArrayMaterial &material);
+
+        const TextureArrayStats &Stats() const { return stats; }
+        void PrintStats() const;
+        // Deletes every pool's arrays. Materials acquired before are invalid after this.
+        void Delete();
+
+    private:
+        static const unsigned int INITIAL_LAYERS = 4;
+
+        // One array of a pool: the size and channels every layer of it has
+        struct Slot {
+            int width;
+            int height;
+            int components;
+            int levels;
+            GLuint array = 0;
+        };
+        struct Pool {
+            vector<Slot> slots;
+            unsigned int materialId = 0;
+            unsigned int capacity = 0;
+            unsigned int used = 0;
+            vector<unsigned int> freeLayers;
+        };
+        struct Entry {
+            size_t pool;
+            unsigned int layer;
+            unsigned int refCount;
+        };
+
+        vector<Pool> pools;
+        unordered_map<string, size_t> poolByShape;  // samplers, sizes and channels -> pool
+        unordered_map<string, Entry> entries;       // paths or key -> layer
+        GLuint copyFramebuffer = 0;
+        TextureArrayStats stats;
+
+        TextureArrays() {}
+        // Reallocates the pool's arrays with twice the layers, keeping the used ones
+        void grow(Pool &pool);
+        static GLuint allocate(const Slot &slot, unsigned int layers);
+        void copyLayers(const Slot &slot, GLuint from, GLuint to, unsigned int layers);
+        static void uploadLayer(const Slot &slot, unsigned int layer, const DecodedImage &image);
+        static size_t layerBytes(const Slot &slot);
+};
+
+#endif /* TextureArrays_hpp */
@@ -0,0 +1,348 @@
+#include "TextureCache.hpp"
+#include "Hash.hpp"
+#include "GLState.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#include "TextureUploader.hpp"
+#include "ThreadPool.hpp"
+
+#include "stb_image.h"
+
+TextureCache &TextureCache::Instance()
+{
+    static TextureCache cache;
+    return cache;
+}
+
+TextureCache::Entry *TextureCache::find(const string &key)
+{
+    auto it = entries.find(key);
+    if (it != entries.end())
+        return &it->second;
+    auto alias = aliases.find(key);
+    if (alias != aliases.end())
+    {
+        it = entries.find(alias->second);
+        if (it != entries.end())
+            return &it->second;
+    }
+    return nullptr;
+}
+
+string TextureCache::canonicalKey(const string &path)
+{
+    std::error_code ec;
+    string key = std::filesystem::weakly_canonical(path, ec).string();
+    return ec ? path : key;
+}
+
+unsigned int TextureCache::Acquire(const string &path, bool srgb)
+{
+    string key = canonicalKey(path);
+
+    if (Entry *entry = find(key))
+    {
+        entry->refCount++;
+        stats.hits++;
+        stats.bytesSaved += entry->bytes;
+        return entry->id;
+    }
+
+    auto start = chrono::steady_clock::now();
+    DecodedImage image;
+    auto prefetched = pending.find(key);
+    if (prefetched != pending.end())
+    {
+        image = prefetched->second.get();
+        pending.erase(prefetched);
+    }
+    else
+        image = decode(path, contentHashing, bakedTextures, mipSettings, srgb);
+    stats.decodeWaitMs += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    stats.decodeMs += image.decodeMs;
+    stats.mipMs += image.mipMs;
+    if (!image.baked.levels.empty())
+    {
+        stats.bakedLoads++;
+        stats.bakedLoadMs += image.decodeMs;
+    }
+    else
+    {
+        stats.imageDecodes++;
+        stats.imageDecodeMs += image.decodeMs;
+    }
+
+    // Same bytes under another name? Share the texture that is already resident.
+    if (image.contentHash)
+    {
+        auto original = pathByHash.find(image.contentHash);
+        if (original != pathByHash.end())
+        {
+            stbi_image_free(image.pixels);
+            Entry &entry = entries[original->second];
+            aliases[key] = original->second;
+            entry.refCount++;
+            stats.hits++;
+            stats.bytesSaved += entry.bytes;
+            return entry.id;
+        }
+    }
+
+    stats.misses++;
+    Entry entry;
+    entry.id = upload(image, path, entry.bytes);
+    stbi_image_free(image.pixels);
+    entry.refCount = 1;
+    entry.contentHash = image.contentHash;
+    stats.bytesUploaded += entry.bytes;
+    if (!image.baked.levels.empty())
+    {
+        stats.bakedBytes += entry.bytes;
+        stats.bakedBytesAsRGBA8 += (size_t)image.baked.width * image.baked.height * 4 * 4 / 3;
+    }
+
+    entries[key] = entry;
+    pathById[entry.id] = key;
+    if (entry.contentHash)
+        pathByHash[entry.contentHash] = key;
+    return entry.id;
+}
+
+void TextureCache::Release(unsigned int id)
+{
+    auto byId = pathById.find(id);
+    if (byId == pathById.end())
+        return;
+    string key = byId->second;
+    Entry &entry = entries[key];
+    if (--entry.refCount > 0)
+        return;
+
+    glDeleteTextures(1, &entry.id);
+    GLState::Instance().TextureDeleted(entry.id);
+    if (entry.contentHash)
+        pathByHash.erase(entry.contentHash);
+    for (auto it = aliases.begin(); it != aliases.end();)
+    {
+        if (it->second == key)
+            it = aliases.erase(it);
+        else
+            ++it;
+    }
+    entries.erase(key);
+    pathById.erase(byId);
+}
+
+void TextureCache::Prefetch(const vector<string> &paths, bool srgb)
+{
+    for (const string &path : paths)
+    {
+        string key = canonicalKey(path);
+        if (find(key) || pending.count(key))
+            continue;
+        bool hashContent = contentHashing, useBaked = bakedTextures;
+        MipSettings mips = mipSettings;
+        pending[key] = ThreadPool::Shared().Submit([path, hashContent, useBaked, mips, srgb]() {
+            return decode(path, hashContent, useBaked, mips, srgb);
+        });
+    }
+}
+
+bool TextureCache::IsReady(const string &path)
+{
+    auto prefetched = pending.find(canonicalKey(path));
+    return prefetched == pending.end() ||
+           prefetched->second.wait_for(chrono::seconds(0)) == future_status::ready;
+}
+
+void TextureCache::CancelPrefetch(const vector<string> &paths)
+{
+    for (const string &path : paths)
+    {
+        auto prefetched = pending.find(canonicalKey(path));
+        if (prefetched == pending.end())
+            continue;
+        stbi_image_free(prefetched->second.get().pixels);
+        pending.erase(prefetched);
+    }
+}
+
+DecodedImage TextureCache::Decode(const string &path, bool srgb)
+{
+    auto start = chrono::steady_clock::now();
+    DecodedImage image;
+    auto prefetched = pending.find(canonicalKey(path));
+    if (prefetched != pending.end())
+    {
+        image = prefetched->second.get();
+        pending.erase(prefetched);
+    }
+    // block compressed levels cannot be turned back into pixels
+    if (!image.pixels)
+        image = decode(path, false, false, mipSettings, srgb);
+    stats.decodeWaitMs += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    stats.decodeMs += image.decodeMs;
+    stats.mipMs += image.mipMs;
+    return image;
+}
+
+void TextureCache::PrintStats() const
+{
+    cout << "TextureCache: " << entries.size() << " textures, " << stats.hits << " hits, "
+         << stats.misses << " misses, " << stats.bytesUploaded / 1024 << " KB uploaded, "
+         << stats.bytesSaved / 1024 << " KB saved" << endl;
+    if (stats.decodeWaitMs > 0.0)
+        cout << "TextureCache: " << stats.decodeMs << " ms of decoding cost the GL thread "
+             << stats.decodeWaitMs << " ms (" << stats.decodeMs / stats.decodeWaitMs << "x)" << endl;
+    if (stats.mipMs > 0.0)
+        cout << "TextureCache: " << stats.mipMs << " ms of CPU mip generation (" << MipGenerator::InstructionSet()
+             << "), included in the decoding time" << endl;
+    if (stats.bakedLoads > 0)
+        cout << "TextureCache: " << stats.bakedLoads << " baked textures read in " << stats.bakedLoadMs / stats.bakedLoads
+             << " ms each, " << stats.imageDecodes << " images decoded in "
+             << (stats.imageDecodes ? stats.imageDecodeMs / stats.imageDecodes : 0.0) << " ms each; baked textures take "
+             << stats.bakedBytes / 1024 << " KB instead of " << stats.bakedBytesAsRGBA8 / 1024 << " KB as RGBA8" << endl;
+}
+
+// Runs on any thread: stb_image only reads the global flip flag set at startup.
+// The file is read once and, when asked, hashed from the same buffer it is decoded from.
+DecodedImage TextureCache::decode(const string &path, bool hashContent, bool useBaked, const MipSettings &mips,
+                                  bool srgb)
+{
+    auto start = chrono::steady_clock::now();
+    DecodedImage image;
+    image.srgb = srgb;
+    if (useBaked && readBaked(path, hashContent, image))
+    {
+        image.decodeMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        return image;
+    }
+
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (in)
+    {
+        vector<unsigned char> file((size_t)in.tellg());
+        in.seekg(0, std::ios::beg);
+        in.read((char *)file.data(), file.size());
+        if (hashContent)
+            image.contentHash = fnv1a(file.data(), file.size());
+        image.pixels = stbi_load_from_memory(file.data(), (int)file.size(), &image.width, &image.height,
+                                             &image.components, 0);
+    }
+    if (image.pixels && mips.cpu)
+    {
+        auto mipStart = chrono::steady_clock::now();
+        image.mips = MipGenerator::Generate(image.pixels, image.width, image.height, image.components, mips.filter,
+                                            mips.srgb && image.srgb && image.components >= 3);
+        image.mipMs = chrono::duration<double, milli>(chrono::steady_clock::now() - mipStart).count();
+    }
+    image.decodeMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    return image;
+}
+
+bool TextureCache::readBaked(const string &path, bool hashContent, DecodedImage &image)
+{
+    string bakedPath = path + ".ktx2";
+    std::error_code ec;
+    auto bakedTime = std::filesystem::last_write_time(bakedPath, ec);
+    if (ec)
+        return false;
+    auto sourceTime = std::filesystem::last_write_time(path, ec);
+    if (!ec && sourceTime > bakedTime)
+    {
+        cout << "ERROR::TEXTURECACHE::" << bakedPath << " is older than the image, run texbake again" << endl;
+        return false;
+    }
+
+    std::ifstream in(bakedPath, std::ios::binary | std::ios::ate);
+    if (!in)
+        return false;
+    vector<uint8_t> file((size_t)in.tellg());
+    in.seekg(0, std::ios::beg);
+    in.read((char *)file.data(), file.size());
+    uint64_t hash = hashContent ? fnv1a(file.data(), file.size()) : 0;
+    if (!Ktx2::Parse(std::move(file), image.baked))
+    {
+        cout << "ERROR::TEXTURECACHE::" << bakedPath << " is not a KTX2 file this loader can use" << endl;
+        return false;
+    }
+    if (!Ktx2::Supported(image.baked.vkFormat))
+    {
+        cout << "ERROR::TEXTURECACHE::No support for the format of " << bakedPath << ", decoding the image" << endl;
+        image.baked = Ktx2Texture();
+        return false;
+    }
+    image.width = image.baked.width;
+    image.height = image.baked.height;
+    image.contentHash = hash;
+    return true;
+}
+
+// Uploads every level of a baked texture as it is stored. Compressed uploads skip the staging ring:
+// they are a fraction of the size and there is no conversion for the driver to overlap.
+void TextureCache::uploadBaked(const Ktx2Texture &baked, size_t &bytes)
+{
+    GLenum format = Ktx2::GLFormat(baked.vkFormat);
+    for (size_t level = 0; level < baked.levels.size(); level++)
+    {
+        int width = max(baked.width >> level, 1), height = max(baked.height >> level, 1);
+        glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)level, format, width, height, 0,
+                               (GLsizei)baked.levels[level].size, baked.LevelData(level));
+        bytes += baked.levels[level].size;
+    }
+    // a chain that stops early must say so, or the texture is incomplete
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)baked.levels.size() - 1);
+}
+
+// Uploads a decoded image with a full mip chain, its own or one the GL makes. bytes receives the GPU footprint.
+unsigned int TextureCache::upload(const DecodedImage &image, const string &path, size_t &bytes)
+{
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    bytes = 0;
+
+    if (!image.baked.levels.empty())
+    {
+        GLState::Instance().BindTexture(GL_TEXTURE_2D, textureID);
+        uploadBaked(image.baked, bytes);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+    else if (image.pixels)
+    {
+        // staged through a pixel buffer object, leaves the texture bound
+        TextureUploader &uploader = TextureUploader::Instance();
+        uploader.Upload(textureID, image.components, image.width, image.height, image.pixels);
+        bytes = (size_t)image.width * image.height * image.components;
+        for (size_t level = 0; level < image.mips.size(); level++)
+        {
+            const MipLevel &mip = image.mips[level];
+            uploader.Upload(textureID, image.components, mip.width, mip.height, mip.pixels.data(), (GLint)level + 1);
+            bytes += mip.pixels.size();
+        }
+        if (image.mips.empty())
+        {
+            glGenerateMipmap(GL_TEXTURE_2D);
+            // the mip chain adds roughly a third on top of the base level
+            bytes = bytes * 4 / 3;
+        }
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+    else
+    {
+        std::cout << "Texture failed to load at path: " << path << std::endl;
+    }
+
+    return textureID;
+}
@@ -0,0 +1,146 @@
+#ifndef TEXTURECACHE_HPP
+#define TEXTURECACHE_HPP
+
+#include <stdint.h>
+#include <future>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "Ktx2.hpp"
+#include "MipGenerator.hpp"
+
+using namespace std;
+// --------------------- Texture Cache --------------------- //
+/*
+    Process-wide cache of GL textures loaded from image files. Entries are keyed
+    by canonical path, so every Model (and the standalone loadTexture helper)
+    shares one decode + upload per image. With content hashing enabled, two
+    different paths holding the same bytes also share one texture.
+
+    Every Acquire takes a reference that must be given back with Release; the
+    texture is deleted once the last reference is released.
+
+    Prefetch starts decoding a batch of images on the shared thread pool. The
+    GL thread picks the finished pixel buffers up in Acquire and only does the
+    upload itself.
+
+    An image baked by texbake ("container.jpg" -> "container.jpg.ktx2") is
+    loaded from the KTX2 file instead, as long as it is not older than the
+    image and the context supports its format: the file is read as is and
+    its block compressed levels go straight to glCompressedTexImage2D, with
+    no decode and no glGenerateMipmap.
+
+    Decoded images get their mip chain from MipGenerator on the thread that
+    decoded them, so a prefetched texture arrives with every level ready and
+    the GL thread only uploads them, one staged upload per level. Images the
+    caller marks as sRGB color (diffuse maps) are filtered in linear light;
+    everything else (specular, normal and height maps) is filtered as stored.
+    An image keeps the mips of whichever use decoded it first.
+    glGenerateMipmap is still there to compare.
+*/
+
+// CPU-side pixels of a decoded image, ready to be uploaded on the GL thread
+struct DecodedImage {
+    unsigned char *pixels = nullptr;
+    int width = 0;
+    int height = 0;
+    int components = 0;
+    uint64_t contentHash = 0;  // 0 when content hashing is off
+    double decodeMs = 0.0;
+    // levels stays empty unless the image came from a baked KTX2 file (pixels is null then)
+    Ktx2Texture baked;
+    // levels 1 and down, empty when the GL makes them
+    vector<MipLevel> mips;
+    double mipMs = 0.0;
+    bool srgb = false;         // holds sRGB encoded color, so mips are filtered in linear light
+};
+
+// How the mip chains of decoded images are made
+struct MipSettings {
+    bool cpu = true;                    // MipGenerator while decoding, otherwise glGenerateMipmap after the upload
+    MipFilter filter = MipFilter::Box;
+    bool srgb = true;                   // filter sRGB color images in linear light; data images never are
+};
+
+struct TextureCacheStats {
+    unsigned int hits = 0;
+    unsigned int misses = 0;
+    size_t bytesUploaded = 0;  // GPU bytes actually uploaded (including mips)
+    size_t bytesSaved = 0;     // GPU bytes a cache hit did not have to upload again
+    double decodeMs = 0.0;     // summed decode time of every image, on whichever thread decoded it
+    double decodeWaitMs = 0.0; // time the GL thread spent decoding or waiting for a decode
+    // images loaded from KTX2 files and decoded from image files, and the time each took in total
+    unsigned int bakedLoads = 0;
+    unsigned int imageDecodes = 0;
+    double bakedLoadMs = 0.0;
+    double imageDecodeMs = 0.0;
+    size_t bakedBytes = 0;           // GPU bytes of the baked textures
+    size_t bakedBytesAsRGBA8 = 0;    // what they would take uncompressed with mips
+    double mipMs = 0.0;              // CPU mip generation, on whichever thread decoded the image
+};
+
+class TextureCache {
+    public:
+        static TextureCache &Instance();
+
+        // Returns the texture for the image at path, decoding and uploading it on first use.
+        // srgb says the image is color rather than data, for its mips.
+        unsigned int Acquire(const string &path, bool srgb = false);
+        // Drops one reference taken by Acquire
+        void Release(unsigned int id);
+
+        // Starts decoding the images at paths on the thread pool, ahead of their Acquire
+        void Prefetch(const vector<string> &paths, bool srgb = false);
+        // False while path is still being decoded by a Prefetch, i.e. Acquire would block
+        bool IsReady(const string &path);
+        // Waits for and frees the prefetched images of paths that were never acquired.
+        // Prefetches of other paths keep running.
+        void CancelPrefetch(const vector<string> &paths);
+        // Pixels and mips of the image at path, for callers that upload them themselves (TextureArrays):
+        // takes over its Prefetch if there is one, otherwise decodes it on the spot. Never a baked file.
+        // The caller frees pixels with stbi_image_free.
+        DecodedImage Decode(const string &path, bool srgb = false);
+
+        // Also dedup different paths that contain identical bytes (hashes each decoded file)
+        void SetContentHashing(bool enabled) { contentHashing = enabled; }
+        // Prefer baked KTX2 files next to the images (on by default)
+        void SetBakedTextures(bool enabled) { bakedTextures = enabled; }
+        // Applies to images decoded from now on
+        void SetMipSettings(const MipSettings &settings) { mipSettings = settings; }
+
+        const TextureCacheStats &Stats() const { return stats; }
+        void PrintStats() const;
+
+    private:
+        struct Entry {
+            unsigned int id;
+            unsigned int refCount;
+            size_t bytes;
+            uint64_t contentHash;
+        };
+
+        unordered_map<string, Entry> entries;           // canonical path -> texture
+        unordered_map<string, string> aliases;          // path with duplicate content -> canonical path of the original
+        unordered_map<uint64_t, string> pathByHash;     // content hash -> canonical path
+        unordered_map<unsigned int, string> pathById;   // texture ID -> canonical path
+        unordered_map<string, future<DecodedImage>> pending; // canonical path -> decode in flight
+        bool contentHashing = true;
+        bool bakedTextures = true;
+        MipSettings mipSettings;
+        TextureCacheStats stats;
+
+        TextureCache() {}
+        Entry *find(const string &key);
+        static string canonicalKey(const string &path);
+        static DecodedImage decode(const string &path, bool hashContent, bool useBaked, const MipSettings &mips,
+                                   bool srgb);
+        // Fills image from path's KTX2 file when there is a usable one
+        static bool readBaked(const string &path, bool hashContent, DecodedImage &image);
+        static unsigned int upload(const DecodedImage &image, const string &path, size_t &bytes);
+        static void uploadBaked(const Ktx2Texture &baked, size_t &bytes);
+};
+
+#endif /* TextureCache_hpp */
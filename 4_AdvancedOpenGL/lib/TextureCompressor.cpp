@@ -0,0 +1,373 @@
+#include "TextureCompressor.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// ETC1 modifier tables: a sub-block adds +small, +large, -small or -large to its base color
+static const int ETC_MODIFIERS[8][2] = {
+    { 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 }, { 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 }
+};
+
+size_t TextureCompressor::BlockBytes(BlockFormat format)
+{
+    return format == BlockFormat::BC1 || format == BlockFormat::ETC2 ? 8 : 16;
+}
+
+size_t TextureCompressor::LevelBytes(BlockFormat format, int width, int height)
+{
+    size_t blocksX = max((width + 3) / 4, 1), blocksY = max((height + 3) / 4, 1);
+    return blocksX * blocksY * BlockBytes(format);
+}
+
+vector<uint8_t> TextureCompressor::Encode(BlockFormat format, const uint8_t *rgba, int width, int height)
+{
+    vector<uint8_t> out(LevelBytes(format, width, height));
+    uint8_t *cursor = out.data();
+    uint8_t block[64];
+    for (int by = 0; by < height; by += 4)
+    {
+        for (int bx = 0; bx < width; bx += 4)
+        {
+            for (int y = 0; y < 4; y++)
+            {
+                int sy = min(by + y, height - 1);
+                for (int x = 0; x < 4; x++)
+                {
+                    int sx = min(bx + x, width - 1);
+                    memcpy(&block[(y * 4 + x) * 4], &rgba[((size_t)sy * width + sx) * 4], 4);
+                }
+            }
+            switch (format)
+            {
+                case BlockFormat::BC1:
+                    encodeBC1(block, cursor);
+                    break;
+                case BlockFormat::BC3:
+                    encodeBC4(block, 3, cursor);
+                    encodeBC1(block, cursor + 8);
+                    break;
+                case BlockFormat::BC5:
+                    encodeBC4(block, 0, cursor);
+                    encodeBC4(block, 1, cursor + 8);
+                    break;
+                case BlockFormat::ETC2:
+                    encodeETC(block, cursor);
+                    break;
+            }
+            cursor += BlockBytes(format);
+        }
+    }
+    return out;
+}
+
+// --------------------- BC1 --------------------- //
+static uint16_t pack565(const float color[3])
+{
+    int r = (int)lroundf(min(max(color[0], 0.0f), 255.0f) * 31.0f / 255.0f);
+    int g = (int)lroundf(min(max(color[1], 0.0f), 255.0f) * 63.0f / 255.0f);
+    int b = (int)lroundf(min(max(color[2], 0.0f), 255.0f) * 31.0f / 255.0f);
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static void unpack565(uint16_t packed, int color[3])
+{
+    int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+// Picks the nearest of the four 4-color mode palette entries for every texel; returns the summed error
+static int pickBC1Indices(const uint8_t *block, uint16_t c0, uint16_t c1, uint8_t indices[16])
+{
+    int palette[4][3];
+    unpack565(c0, palette[0]);
+    unpack565(c1, palette[1]);
+    for (int c = 0; c < 3; c++)
+    {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+    int total = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        int best = 0, bestError = INT32_MAX;
+        for (int p = 0; p < 4; p++)
+        {
+            int dr = block[i * 4] - palette[p][0], dg = block[i * 4 + 1] - palette[p][1], db = block[i * 4 + 2] - palette[p][2];
+            int error = dr * dr + dg * dg + db * db;
+            if (error < bestError)
+            {
+                best = p;
+                bestError = error;
+            }
+        }
+        indices[i] = (uint8_t)best;
+        total += bestError;
+    }
+    return total;
+}
+
+void TextureCompressor::encodeBC1(const uint8_t *block, uint8_t *out)
+{
+    float mean[3] = { 0, 0, 0 };
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 3; c++)
+            mean[c] += block[i * 4 + c] / 16.0f;
+    float covariance[6] = { 0, 0, 0, 0, 0, 0 };  // xx xy xz yy yz zz
+    for (int i = 0; i < 16; i++)
+    {
+        float d[3] = { block[i * 4] - mean[0], block[i * 4 + 1] - mean[1], block[i * 4 + 2] - mean[2] };
+        covariance[0] += d[0] * d[0]; covariance[1] += d[0] * d[1]; covariance[2] += d[0] * d[2];
+        covariance[3] += d[1] * d[1]; covariance[4] += d[1] * d[2]; covariance[5] += d[2] * d[2];
+    }
+    // principal axis by power iteration
+    float axis[3] = { 1.0f, 1.0f, 1.0f };
+    for (int iteration = 0; iteration < 8; iteration++)
+    {
+        float next[3] = {
+            covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+            covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+            covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2]
+        };
+        float length = sqrtf(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+        if (length < 1e-6f)
+            break;
+        for (int c = 0; c < 3; c++)
+            axis[c] = next[c] / length;
+    }
+    float minT = 0.0f, maxT = 0.0f;
+    for (int i = 0; i < 16; i++)
+    {
+        float t = (block[i * 4] - mean[0]) * axis[0] + (block[i * 4 + 1] - mean[1]) * axis[1] +
+                  (block[i * 4 + 2] - mean[2]) * axis[2];
+        minT = min(minT, t);
+        maxT = max(maxT, t);
+    }
+    float end0[3], end1[3];
+    for (int c = 0; c < 3; c++)
+    {
+        end0[c] = mean[c] + axis[c] * maxT;
+        end1[c] = mean[c] + axis[c] * minT;
+    }
+    uint16_t c0 = pack565(end0), c1 = pack565(end1);
+    uint8_t indices[16];
+    int error = pickBC1Indices(block, c0, c1, indices);
+
+    // least squares endpoints for the indices just picked: texel ~ a * end0 + b * end1
+    static const float WEIGHTS[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+    float aa = 0, ab = 0, bb = 0, ax[3] = { 0, 0, 0 }, bx[3] = { 0, 0, 0 };
+    for (int i = 0; i < 16; i++)
+    {
+        float a = WEIGHTS[indices[i]], b = 1.0f - a;
+        aa += a * a; ab += a * b; bb += b * b;
+        for (int c = 0; c < 3; c++)
+        {
+            ax[c] += a * block[i * 4 + c];
+            bx[c] += b * block[i * 4 + c];
+        }
+    }
+    float determinant = aa * bb - ab * ab;
+    if (fabsf(determinant) > 1e-6f)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            end0[c] = (ax[c] * bb - bx[c] * ab) / determinant;
+            end1[c] = (bx[c] * aa - ax[c] * ab) / determinant;
+        }
+        uint16_t refined0 = pack565(end0), refined1 = pack565(end1);
+        uint8_t refinedIndices[16];
+        int refinedError = pickBC1Indices(block, refined0, refined1, refinedIndices);
+        if (refinedError < error)
+        {
+            c0 = refined0;
+            c1 = refined1;
+            memcpy(indices, refinedIndices, sizeof(indices));
+        }
+    }
+
+    // c0 > c1 selects the 4-color mode; equal endpoints would select the 3-color one with transparent black
+    if (c0 < c1)
+    {
+        swap(c0, c1);
+        // 0 <-> 1 and 2 <-> 3
+        for (uint8_t &index : indices)
+            index ^= 1;
+    }
+    else if (c0 == c1)
+        memset(indices, 0, sizeof(indices));
+
+    uint32_t bits = 0;
+    for (int i = 0; i < 16; i++)
+        bits |= (uint32_t)indices[i] << (i * 2);
+    out[0] = (uint8_t)c0; out[1] = (uint8_t)(c0 >> 8);
+    out[2] = (uint8_t)c1; out[3] = (uint8_t)(c1 >> 8);
+    for (int i = 0; i < 4; i++)
+        out[4 + i] = (uint8_t)(bits >> (i * 8));
+}
+
+// --------------------- BC4 --------------------- //
+void TextureCompressor::encodeBC4(const uint8_t *block, int channel, uint8_t *out)
+{
+    int low = 255, high = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        low = min(low, (int)block[i * 4 + channel]);
+        high = max(high, (int)block[i * 4 + channel]);
+    }
+    // high > low selects the 8-value mode; equal endpoints only ever need index 0
+    int palette[8] = { high, low };
+    for (int k = 1; k < 7; k++)
+        palette[k + 1] = ((7 - k) * high + k * low) / 7;
+
+    uint64_t bits = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        int value = block[i * 4 + channel];
+        int best = 0, bestError = 256;
+        for (int p = 0; p < (high > low ? 8 : 1); p++)
+        {
+            int error = abs(value - palette[p]);
+            if (error < bestError)
+            {
+                best = p;
+                bestError = error;
+            }
+        }
+        bits |= (uint64_t)best << (i * 3);
+    }
+    out[0] = (uint8_t)high;
+    out[1] = (uint8_t)low;
+    for (int i = 0; i < 6; i++)
+        out[2 + i] = (uint8_t)(bits >> (i * 8));
+}
+
+// --------------------- ETC --------------------- //
+static int clampByte(int value)
+{
+    return value < 0 ? 0 : value > 255 ? 255 : value;
+}
+
+// Best modifier table for the texels of one sub-block around base; fills their 2-bit indices
+static int fitETCSubBlock(const uint8_t *block, const int base[3], bool flip, int half, int &table,
+                          uint8_t indices[16])
+{
+    int bestError = INT32_MAX;
+    uint8_t tableIndices[16];
+    for (int t = 0; t < 8; t++)
+    {
+        int modifiers[4] = { ETC_MODIFIERS[t][0], ETC_MODIFIERS[t][1], -ETC_MODIFIERS[t][0], -ETC_MODIFIERS[t][1] };
+        int error = 0;
+        for (int y = 0; y < 4; y++)
+        {
+            for (int x = 0; x < 4; x++)
+            {
+                if ((flip ? y : x) / 2 != half)
+                    continue;
+                const uint8_t *texel = &block[(y * 4 + x) * 4];
+                int best = 0, bestTexelError = INT32_MAX;
+                for (int m = 0; m < 4; m++)
+                {
+                    int dr = texel[0] - clampByte(base[0] + modifiers[m]);
+                    int dg = texel[1] - clampByte(base[1] + modifiers[m]);
+                    int db = texel[2] - clampByte(base[2] + modifiers[m]);
+                    int texelError = dr * dr + dg * dg + db * db;
+                    if (texelError < bestTexelError)
+                    {
+                        best = m;
+                        bestTexelError = texelError;
+                    }
+                }
+                tableIndices[y * 4 + x] = (uint8_t)best;
+                error += bestTexelError;
+            }
+        }
+        if (error < bestError)
+        {
+            bestError = error;
+            table = t;
+            for (int i = 0; i < 16; i++)
+                if ((flip ? i / 4 : i % 4) / 2 == half)
+                    indices[i] = tableIndices[i];
+        }
+    }
+    return bestError;
+}
+
+void TextureCompressor::encodeETC(const uint8_t *block, uint8_t *out)
+{
+    uint64_t bestWord = 0;
+    int bestError = INT32_MAX;
+    for (int flip = 0; flip < 2; flip++)
+    {
+        // flip 0: left and right 2x4 halves, flip 1: top and bottom 4x2 halves
+        float average[2][3] = { { 0, 0, 0 }, { 0, 0, 0 } };
+        for (int y = 0; y < 4; y++)
+            for (int x = 0; x < 4; x++)
+                for (int c = 0; c < 3; c++)
+                    average[(flip ? y : x) / 2][c] += block[(y * 4 + x) * 4 + c] / 8.0f;
+
+        for (int differential = 0; differential < 2; differential++)
+        {
+            int quantized[2][3], base[2][3];
+            bool fits = true;
+            for (int half = 0; half < 2; half++)
+            {
+                for (int c = 0; c < 3; c++)
+                {
+                    if (differential)
+                    {
+                        quantized[half][c] = (int)lroundf(average[half][c] * 31.0f / 255.0f);
+                        base[half][c] = (quantized[half][c] << 3) | (quantized[half][c] >> 2);
+                    }
+                    else
+                    {
+                        quantized[half][c] = (int)lroundf(average[half][c] * 15.0f / 255.0f);
+                        base[half][c] = quantized[half][c] * 17;
+                    }
+                }
+            }
+            // the second color is stored as a 3-bit signed delta from the first
+            if (differential)
+                for (int c = 0; c < 3; c++)
+                    fits = fits && quantized[1][c] - quantized[0][c] >= -4 && quantized[1][c] - quantized[0][c] <= 3;
+            if (!fits)
+                continue;
+
+            int tables[2];
+            uint8_t indices[16];
+            int error = fitETCSubBlock(block, base[0], flip, 0, tables[0], indices) +
+                        fitETCSubBlock(block, base[1], flip, 1, tables[1], indices);
+            if (error >= bestError)
+                continue;
+            bestError = error;
+
+            uint64_t word = 0;
+            for (int c = 0; c < 3; c++)
+            {
+                int shift = 59 - c * 8;
+                if (differential)
+                    word |= (uint64_t)quantized[0][c] << shift | (uint64_t)((quantized[1][c] - quantized[0][c]) & 7) << (shift - 3);
+                else
+                    word |= (uint64_t)quantized[0][c] << (shift + 1) | (uint64_t)quantized[1][c] << (shift - 3);
+            }
+            word |= (uint64_t)tables[0] << 37 | (uint64_t)tables[1] << 34;
+            word |= (uint64_t)differential << 33 | (uint64_t)flip << 32;
+            // texel indices go in column order, low bits in the low half and high bits above them.
+            // Index 0-3 is +small, +large, -small, -large, which is the order ETC numbers them in.
+            for (int x = 0; x < 4; x++)
+            {
+                for (int y = 0; y < 4; y++)
+                {
+                    int code = indices[y * 4 + x], bit = x * 4 + y;
+                    word |= (uint64_t)(code & 1) << bit | (uint64_t)(code >> 1) << (bit + 16);
+                }
+            }
+            bestWord = word;
+        }
+    }
+    // ETC blocks are big endian
+    for (int i = 0; i < 8; i++)
+        out[i] = (uint8_t)(bestWord >> (56 - i * 8));
+}
@@ -0,0 +1,110 @@
+#include "TextureUploader.hpp"
+#include "GLState.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+TextureUploader &TextureUploader::Instance()
+{
+    static TextureUploader uploader;
+    return uploader;
+}
+
+GLenum TextureUploader::PixelFormat(int components)
+{
+    if (components == 1)
+        return GL_RED;
+    if (components == 2)
+        return GL_RG;
+    if (components == 3)
+        return GL_RGB;
+    return GL_RGBA;
+}
+
+void TextureUploader::Upload(GLuint texture, int components, int width, int height, const unsigned char *pixels,
+                             GLint level)
+{
+    if (ring.empty())
+    {
+        ring.resize(RING_SIZE);
+        for (Slot &slot : ring)
+            glGenBuffers(1, &slot.buffer);
+    }
+
+    GLenum format = PixelFormat(components);
+    size_t size = (size_t)width * height * components;
+    Slot &slot = ring[next];
+    next = (next + 1) % RING_SIZE;
+
+    // wait until the GPU has pulled the last upload out of this slot
+    auto start = chrono::steady_clock::now();
+    if (slot.fence)
+    {
+        glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        glDeleteSync(slot.fence);
+        slot.fence = 0;
+    }
+
+    GLState &state = GLState::Instance();
+    state.BindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+    if (size > slot.capacity)
+    {
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+        slot.capacity = size;
+    }
+    // the fence above already guarantees the slot is idle, so the driver need not synchronize again
+    void *staging = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+                                     GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    double blockedMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    state.BindTexture(GL_TEXTURE_2D, texture);
+    // rows of 1-3 channel images are not 4-byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (staging)
+    {
+        std::memcpy(staging, pixels, size);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        // with an unpack buffer bound the data pointer is an offset into it
+        glTexImage2D(GL_TEXTURE_2D, level, format, width, height, 0, format, GL_UNSIGNED_BYTE, (void *)0);
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        state.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    else
+    {
+        // mapping failed: fall back to the plain client memory upload
+        state.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glTexImage2D(GL_TEXTURE_2D, level, format, width, height, 0, format, GL_UNSIGNED_BYTE, pixels);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    TextureUploadStats &thisFrame = frame.ThisFrame();
+    thisFrame.bytes += size;
+    thisFrame.blockedMs += blockedMs;
+    totals.uploads++;
+    totals.bytes += size;
+    totals.blockedMs += blockedMs;
+    totals.peakBytesPerFrame = max(totals.peakBytesPerFrame, thisFrame.bytes);
+    totals.peakBlockedMsPerFrame = max(totals.peakBlockedMsPerFrame, thisFrame.blockedMs);
+}
+
+void TextureUploader::PrintStats() const
+{
+    cout << "TextureUploader: " << totals.uploads << " uploads, " << totals.bytes / 1024 << " KB staged, "
+         << totals.blockedMs << " ms blocked; peak frame " << totals.peakBytesPerFrame / 1024 << " KB, "
+         << totals.peakBlockedMsPerFrame << " ms blocked" << endl;
+}
+
+void TextureUploader::Delete()
+{
+    for (Slot &slot : ring)
+    {
+        if (slot.fence)
+            glDeleteSync(slot.fence);
+        glDeleteBuffers(1, &slot.buffer);
+        GLState::Instance().BufferDeleted(slot.buffer);
+    }
+    ring.clear();
+    next = 0;
+}
@@ -0,0 +1,54 @@
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+using namespace std;
+// --------------------- Thread Pool --------------------- //
+// Fixed set of worker threads for CPU-only work (image decoding, mesh import).
+// Nothing submitted here may touch OpenGL: the context belongs to the main thread.
+class ThreadPool {
+    public:
+        explicit ThreadPool(unsigned int threadCount);
+        ~ThreadPool();
+
+        // Pool sized to the machine, shared by the loaders
+        static ThreadPool &Shared();
+
+        // Queues task and returns a future for its result
+        template <class F>
+        auto Submit(F task) -> future<decltype(task())>
+        {
+            using Result = decltype(task());
+            auto packaged = make_shared<packaged_task<Result()>>(std::move(task));
+            future<Result> result = packaged->get_future();
+            {
+                lock_guard<mutex> lock(queueMutex);
+                tasks.push([packaged]() { (*packaged)(); });
+            }
+            wakeUp.notify_one();
+            return result;
+        }
+
+        unsigned int Size() const { return (unsigned int)workers.size(); }
+
+    private:
+        vector<thread> workers;
+        queue<function<void()>> tasks;
+        mutex queueMutex;
+        condition_variable wakeUp;
+        bool stopping = false;
+
+        void workerLoop();
+
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+};
+#endif /* ThreadPool_hpp */
@@ -12,6 +12,10 @@
 #include "Camera.hpp"
 #include "Model.hpp"
 #include "Shader.hpp"
+#include "GLState.hpp"
+#include "RenderQueue.hpp"
+#include "TextureCache.hpp"
+#include "TextureUploader.hpp"
 
 // GLM
 #include <glm/glm.hpp>
@@ -243,6 +247,8 @@ int main() {
 
   unsigned int cubeTexture = loadTexture("../resources/textures/container.jpg");
   unsigned int floorTexture = loadTexture("../resources/textures/metal.png");
+  TextureCache::Instance().PrintStats();
+  TextureUploader::Instance().PrintStats();
 
   lightingShader.Activate();
   lightingShader.setInt("texture1", 0);
@@ -250,6 +256,40 @@ int main() {
   screenQuadShader.setInt("screenTexture", 0);
 
   glEnable(GL_DEPTH_TEST);
+  // the setup above bound objects directly, start the loop with a clean shadow
+  GLState::Instance().Invalidate();
+
+  // The rear view and the main view draw the same scene, queued and sorted so
+  // draws sharing a texture and VAO go out back to back
+  RenderQueue renderQueue;
+  unsigned int floorMaterial =
+      RenderQueue::RegisterMaterial({floorTexture}, {"texture1"});
+  unsigned int cubeMaterial =
+      RenderQueue::RegisterMaterial({cubeTexture}, {"texture1"});
+  auto drawScene = [&](const glm::mat4 &view, const glm::mat4 &projection) {
+    lightingShader.Activate();
+    lightingShader.setMat4("view", view);
+    lightingShader.setMat4("projection", projection);
+    renderQueue.Begin(view);
+
+    // FLOOR //
+    renderQueue.Submit(lightingShader, planeVAO, floorMaterial, glm::mat4(1.0f),
+                       GL_TRIANGLES, 6);
+
+    // CUBE 1 //
+    glm::mat4 model = glm::mat4(1.0f);
+    model = glm::translate(model, glm::vec3(-1.0f, 1.0f, -1.0f));
+    renderQueue.Submit(lightingShader, cubeVAO, cubeMaterial, model,
+                       GL_TRIANGLES, 36);
+
+    // CUBE 2 //
+    model = glm::mat4(1.0f);
+    model = glm::translate(model, glm::vec3(2.0f, 1.0f, 0.0f));
+    renderQueue.Submit(lightingShader, cubeVAO, cubeMaterial, model,
+                       GL_TRIANGLES, 36);
+
+    renderQueue.Flush();
+  };
 
   while (!glfwWindowShouldClose(window)) {
     // Calculate delta time so that device frame rate doesn't affect the
@@ -269,7 +309,6 @@ int main() {
     glm::mat4 projection = glm::perspective(
         glm::radians(camera.Zoom), (float)screenWidth / (float)screenHeight,
         0.1f, 100.0f);
-    glm::mat4 model = glm::mat4(1.0f);
 
     glBindFramebuffer(GL_FRAMEBUFFER, FBO);
     glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
@@ -277,81 +316,25 @@ int main() {
             GL_DEPTH_BUFFER_BIT); // we're not using the stencil buffer now
     glEnable(GL_DEPTH_TEST);
 
-    lightingShader.Activate();
-    lightingShader.setMat4("view", view);
-    lightingShader.setMat4("projection", projection);
-
-    // FLOOR //
-
-    glBindVertexArray(planeVAO);
-    glBindTexture(GL_TEXTURE_2D, floorTexture);
-
-    lightingShader.setMat4("model", glm::mat4(1.0f));
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-
-    // CUBE 1 //
-
-    glActiveTexture(GL_TEXTURE0);
-
-    glBindVertexArray(cubeVAO);
-    glBindTexture(GL_TEXTURE_2D, cubeTexture);
-
-    model = glm::mat4(1.0f);
-    model = glm::translate(model, glm::vec3(-1.0f, 1.0f, -1.0f));
-    lightingShader.setMat4("model", model);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
-
-    // CUBE 2 //
-    glBindTexture(GL_TEXTURE_2D, cubeTexture);
-    model = glm::mat4(1.0f);
-    model = glm::translate(model, glm::vec3(2.0f, 1.0f, 0.0f));
-    lightingShader.setMat4("model", model);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
-    glBindVertexArray(0);
+    drawScene(view, projection);
 
     glBindFramebuffer(GL_FRAMEBUFFER, 0); // back to default
     glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    lightingShader.Activate();
-
-     view = camera.GetViewMatrix();
-    lightingShader.setMat4("view", view);
-    lightingShader.setMat4("projection", projection);
-
-    // FLOOR //
-
-    glBindVertexArray(planeVAO);
-    glBindTexture(GL_TEXTURE_2D, floorTexture);
-
-    lightingShader.setMat4("model", glm::mat4(1.0f));
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-
-    // CUBE 1 //
-    glBindVertexArray(cubeVAO);
-    glBindTexture(GL_TEXTURE_2D, cubeTexture);
-
-    model = glm::mat4(1.0f);
-    model = glm::translate(model, glm::vec3(-1.0f, 1.0f, -1.0f));
-    lightingShader.setMat4("model", model);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
-
-    // CUBE 2 //
-    glBindTexture(GL_TEXTURE_2D, cubeTexture);
-    model = glm::mat4(1.0f);
-    model = glm::translate(model, glm::vec3(2.0f, 1.0f, 0.0f));
-    lightingShader.setMat4("model", model);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
-    glBindVertexArray(0);
+    view = camera.GetViewMatrix();
+    drawScene(view, projection);
 
     glDisable(GL_DEPTH_TEST);
     screenQuadShader.Activate();
-    glBindVertexArray(quadVAO);
-    glBindTexture(GL_TEXTURE_2D, colorTexture);
+    GLState::Instance().BindVertexArray(quadVAO);
+    GLState::Instance().BindTextureUnit(0, GL_TEXTURE_2D, colorTexture);
     glDrawArrays(GL_TRIANGLES, 0, 6);
 
     glfwSwapBuffers(window);
     glfwPollEvents();
+    // closes the per-frame stats of every subsystem
+    FrameCounters::EndFrame();
   }
   // --------------------- Clean up --------------------- //
   glDeleteVertexArrays(1, &cubeVAO);
@@ -359,6 +342,15 @@ int main() {
   glDeleteBuffers(1, &cubeVBO);
   glDeleteBuffers(1, &planeVBO);
   glDeleteFramebuffers(1, &FBO);
+  TextureCache::Instance().Release(cubeTexture);
+  TextureCache::Instance().Release(floorTexture);
+  TextureUploader::Instance().Delete();
+  RenderQueue::ReleaseMaterial(floorMaterial);
+  RenderQueue::ReleaseMaterial(cubeMaterial);
+  renderQueue.Delete();
+  Shader::PrintUniformStats();
+  renderQueue.PrintStats();
+  GLState::Instance().PrintStats();
 
   lightingShader.Delete();
   glfwDestroyWindow(window);
@@ -404,38 +396,9 @@ void scroll_callback(GLFWwindow *window, double xoffset, double yoffset) {
   camera.ProcessMouseScroll(static_cast<float>(yoffset));
 }
 // utility function for loading a 2D texture from file
+// (goes through the shared texture cache, so repeated paths are only uploaded once;
+// the demo textures are all color)
 // ---------------------------------------------------
 unsigned int loadTexture(char const *path) {
-  unsigned int textureID;
-  glGenTextures(1, &textureID);
-
-  int width, height, nrComponents;
-  unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-  if (data) {
-    GLenum format;
-    if (nrComponents == 1)
-      format = GL_RED;
-    else if (nrComponents == 3)
-      format = GL_RGB;
-    else if (nrComponents == 4)
-      format = GL_RGBA;
-
-    glBindTexture(GL_TEXTURE_2D, textureID);
-    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format,
-                 GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
-                    GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    stbi_image_free(data);
-  } else {
-    std::cout << "Texture failed to load at path: " << path << std::endl;
-    stbi_image_free(data);
-  }
-
-  return textureID;
+  return TextureCache::Instance().Acquire(path, true);
 }
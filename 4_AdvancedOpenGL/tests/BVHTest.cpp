@@ -0,0 +1,84 @@
+#include <random>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "BVH.hpp"
+#include "Check.hpp"
+
+static vector<Bounds> randomScene(size_t count, mt19937 &random)
+{
+    uniform_real_distribution<float> position(-50.0f, 50.0f);
+    uniform_real_distribution<float> size(0.2f, 3.0f);
+    vector<Bounds> scene;
+    for (size_t i = 0; i < count; i++)
+    {
+        Bounds bounds;
+        bounds.center = glm::vec3(position(random), position(random), position(random));
+        glm::vec3 extents(size(random), size(random), size(random));
+        bounds.min = bounds.center - extents;
+        bounds.max = bounds.center + extents;
+        bounds.radius = glm::length(extents);
+        scene.push_back(bounds);
+    }
+    return scene;
+}
+
+// The BVH has to find exactly what the linear cull finds, only with fewer tests
+static void checkMatchesLinear(BVH &bvh, const vector<Bounds> &scene, const Frustum &frustum)
+{
+    FrustumCuller linear;
+    for (const Bounds &bounds : scene)
+        linear.Add(bounds);
+    vector<uint8_t> expected, visible;
+    size_t expectedCount = linear.Cull(frustum, expected);
+    CHECK(bvh.Cull(frustum, visible) == expectedCount);
+    CHECK(visible.size() == scene.size());
+    for (size_t i = 0; i < scene.size() && i < visible.size(); i++)
+        CHECK(visible[i] == expected[i]);
+}
+
+int main()
+{
+    mt19937 random(1);
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, 100.0f);
+    vector<Frustum> frustums;
+    for (glm::vec3 direction : { glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.3f, -1.0f, 0.2f) })
+        frustums.push_back(Frustum::FromMatrix(projection * glm::lookAt(glm::vec3(0.0f), direction, glm::vec3(0.0f, 1.0f, 0.0f))));
+
+    vector<Bounds> scene = randomScene(2000, random);
+    BVH bvh;
+    CHECK(bvh.Empty());
+    bvh.Build(scene);
+    CHECK(!bvh.Empty());
+    CHECK(bvh.NodeCount() < 2 * scene.size());
+    for (const Frustum &frustum : frustums)
+        checkMatchesLinear(bvh, scene, frustum);
+    // far fewer than the six plane tests per item of the linear cull
+    CHECK(bvh.LastTraversal().planeTests < 6 * scene.size() / 2);
+
+    // refit keeps the tree over moved items correct
+    uniform_real_distribution<float> nudge(-5.0f, 5.0f);
+    for (Bounds &bounds : scene)
+    {
+        glm::vec3 offset(nudge(random), nudge(random), nudge(random));
+        bounds.min += offset;
+        bounds.max += offset;
+        bounds.center += offset;
+    }
+    bvh.Refit(scene);
+    for (const Frustum &frustum : frustums)
+        checkMatchesLinear(bvh, scene, frustum);
+
+    // fewer items than a leaf holds still make a tree
+    vector<Bounds> few = randomScene(3, random);
+    bvh.Build(few);
+    CHECK(bvh.NodeCount() == 1);
+    for (const Frustum &frustum : frustums)
+        checkMatchesLinear(bvh, few, frustum);
+
+    vector<uint8_t> visible;
+    bvh.Clear();
+    CHECK(bvh.Empty());
+    CHECK(bvh.Cull(frustums[0], visible) == 0);
+    return CheckFailures();
+}
@@ -0,0 +1,29 @@
+#ifndef CHECK_HPP
+#define CHECK_HPP
+
+#include <iostream>
+
+using namespace std;
+// --------------------- Check --------------------- //
+/*
+    The one assertion the tests use. A failed CHECK prints the condition and
+    where it is and the test goes on, so one run reports every failure; main
+    returns CheckFailures() and ctest counts anything but 0 as failed.
+*/
+inline int &CheckFailures()
+{
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(condition)                                                                                     \
+    do                                                                                                       \
+    {                                                                                                        \
+        if (!(condition))                                                                                    \
+        {                                                                                                    \
+            cout << "ERROR::TEST::" << __FILE__ << ":" << __LINE__ << " CHECK(" #condition ") failed" << endl; \
+            CheckFailures()++;                                                                               \
+        }                                                                                                    \
+    } while (0)
+
+#endif /* Check_hpp */
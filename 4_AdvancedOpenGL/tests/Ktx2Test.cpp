@@ -0,0 +1,82 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include "Check.hpp"
+#include "Ktx2.hpp"
+#include "TextureCompressor.hpp"
+
+static vector<uint8_t> readFile(const string &path)
+{
+    ifstream file(path, ios::binary);
+    return vector<uint8_t>(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+}
+
+// A 12x8 chain down to 1x1, every level a different color so a mixed up level shows
+static vector<vector<uint8_t>> encodeChain(BlockFormat format, int width, int height)
+{
+    vector<vector<uint8_t>> levels;
+    for (int level = 0;; level++)
+    {
+        vector<uint8_t> rgba((size_t)width * height * 4);
+        for (size_t i = 0; i < rgba.size(); i++)
+            rgba[i] = (uint8_t)(level * 50 + i % 4 * 30);
+        levels.push_back(TextureCompressor::Encode(format, rgba.data(), width, height));
+        if (width == 1 && height == 1)
+            break;
+        width = max(1, width / 2);
+        height = max(1, height / 2);
+    }
+    return levels;
+}
+
+static void testRoundTrip(BlockFormat format, bool srgb)
+{
+    string path = "ktx2_round_trip.ktx2";
+    vector<vector<uint8_t>> levels = encodeChain(format, 12, 8);
+    CHECK(Ktx2::Write(path, format, srgb, 12, 8, levels));
+
+    Ktx2Texture texture;
+    CHECK(Ktx2::Parse(readFile(path), texture));
+    remove(path.c_str());
+    CHECK(texture.vkFormat == Ktx2::VkFormat(format, srgb));
+    CHECK(texture.width == 12 && texture.height == 8);
+    CHECK(texture.levels.size() == levels.size());
+    for (size_t level = 0; level < texture.levels.size() && level < levels.size(); level++)
+    {
+        CHECK(texture.levels[level].size == levels[level].size());
+        CHECK(texture.levels[level].offset + texture.levels[level].size <= texture.file.size());
+        CHECK(memcmp(texture.LevelData(level), levels[level].data(), levels[level].size()) == 0);
+    }
+}
+
+// Files that are not what the header promises are turned down instead of read past their end
+static void testRejects()
+{
+    string path = "ktx2_rejects.ktx2";
+    CHECK(Ktx2::Write(path, BlockFormat::BC1, false, 8, 8, encodeChain(BlockFormat::BC1, 8, 8)));
+    vector<uint8_t> file = readFile(path);
+    remove(path.c_str());
+    Ktx2Texture texture;
+    CHECK(Ktx2::Parse(file, texture));
+
+    vector<uint8_t> truncated(file.begin(), file.end() - 4);
+    CHECK(!Ktx2::Parse(truncated, texture));
+    vector<uint8_t> header(file.begin(), file.begin() + 40);
+    CHECK(!Ktx2::Parse(header, texture));
+    vector<uint8_t> notKtx = file;
+    notKtx[1] = 'X';
+    CHECK(!Ktx2::Parse(notKtx, texture));
+    CHECK(!Ktx2::Parse(vector<uint8_t>(), texture));
+}
+
+int main()
+{
+    testRoundTrip(BlockFormat::BC1, true);
+    testRoundTrip(BlockFormat::BC3, false);
+    testRoundTrip(BlockFormat::BC5, false);
+    testRoundTrip(BlockFormat::ETC2, true);
+    testRejects();
+    return CheckFailures();
+}
@@ -0,0 +1,96 @@
+#include <algorithm>
+#include <array>
+#include <random>
+
+#include "Check.hpp"
+#include "MeshOptimizer.hpp"
+#include "TestMeshes.hpp"
+
+// Every triangle by its corner positions, rotated to start at the smallest corner and sorted,
+// so two meshes with the same surface compare equal however they are indexed and ordered
+static vector<array<float, 9>> triangleSet(const MeshData &mesh)
+{
+    vector<array<float, 9>> triangles;
+    for (size_t i = 0; i < mesh.indices.size(); i += 3)
+    {
+        array<array<float, 3>, 3> corners;
+        for (int c = 0; c < 3; c++)
+        {
+            const glm::vec3 &position = mesh.vertices[mesh.indices[i + c]].Position;
+            corners[c] = { position.x, position.y, position.z };
+        }
+        rotate(corners.begin(), min_element(corners.begin(), corners.end()), corners.end());
+        array<float, 9> triangle;
+        for (int c = 0; c < 3; c++)
+            copy(corners[c].begin(), corners[c].end(), triangle.begin() + 3 * c);
+        triangles.push_back(triangle);
+    }
+    sort(triangles.begin(), triangles.end());
+    return triangles;
+}
+
+static void testMetrics()
+{
+    // two triangles without a shared vertex: every corner is a miss
+    vector<unsigned int> separate = { 0, 1, 2, 3, 4, 5 };
+    CHECK(MeshOptimizer::ACMR(separate, 6) == 3.0f);
+    CHECK(MeshOptimizer::ATVR(separate, 6) == 1.0f);
+    // the second triangle of a quad only brings one new vertex
+    vector<unsigned int> quad = { 0, 1, 2, 2, 1, 3 };
+    CHECK(MeshOptimizer::ACMR(quad, 4) == 2.0f);
+    CHECK(MeshOptimizer::ATVR(quad, 4) == 1.0f);
+}
+
+static void testWeld()
+{
+    MeshData mesh = GridMesh(8, false);
+    vector<array<float, 9>> before = triangleSet(mesh);
+    MeshOptimizer::WeldVertices(mesh);
+    CHECK(mesh.vertices.size() == 9 * 9);
+    CHECK(triangleSet(mesh) == before);
+}
+
+static void testOptimize()
+{
+    // a shuffled triangle order is close to the worst case for the post-transform cache
+    MeshData mesh = GridMesh(64, false);
+    size_t triangleCount = mesh.indices.size() / 3;
+    vector<size_t> order(triangleCount);
+    for (size_t i = 0; i < triangleCount; i++)
+        order[i] = i;
+    shuffle(order.begin(), order.end(), mt19937(1));
+    vector<unsigned int> shuffled;
+    for (size_t triangle : order)
+        shuffled.insert(shuffled.end(), mesh.indices.begin() + 3 * triangle, mesh.indices.begin() + 3 * triangle + 3);
+    mesh.indices = shuffled;
+    vector<array<float, 9>> before = triangleSet(mesh);
+
+    MeshOptimizeReport report = MeshOptimizer::Optimize(mesh);
+    CHECK(report.verticesBefore == 6 * 64 * 64);
+    CHECK(report.verticesAfter == 65 * 65);
+    CHECK(mesh.vertices.size() == report.verticesAfter);
+    CHECK(triangleSet(mesh) == before);
+    CHECK(report.acmrAfter < report.acmrBefore);
+    // a regular grid through a 32 entry cache gets well under one vertex shader run per triangle
+    CHECK(report.acmrAfter < 0.8f);
+    CHECK(report.atvrAfter < 1.6f);
+    CHECK(report.acmrAfter == MeshOptimizer::ACMR(mesh.indices, mesh.vertices.size()));
+
+    // vertex fetch order: vertices are numbered in the order the indices first use them
+    unsigned int next = 0;
+    for (unsigned int index : mesh.indices)
+    {
+        CHECK(index <= next);
+        if (index == next)
+            next++;
+    }
+    CHECK(next == mesh.vertices.size());
+}
+
+int main()
+{
+    testMetrics();
+    testWeld();
+    testOptimize();
+    return CheckFailures();
+}
@@ -0,0 +1,90 @@
+#include <set>
+
+#include "Check.hpp"
+#include "MeshOptimizer.hpp"
+#include "MeshSimplifier.hpp"
+#include "TestMeshes.hpp"
+
+// Indices in range and no triangle collapsed to a line or a point
+static bool validTriangles(const vector<unsigned int> &indices, size_t vertexCount)
+{
+    if (indices.size() % 3 != 0)
+        return false;
+    for (size_t i = 0; i < indices.size(); i += 3)
+    {
+        unsigned int a = indices[i], b = indices[i + 1], c = indices[i + 2];
+        if (a >= vertexCount || b >= vertexCount || c >= vertexCount || a == b || b == c || a == c)
+            return false;
+    }
+    return true;
+}
+
+// A flat grid simplifies without moving the surface, while its border stays where it is
+static void testFlatGrid()
+{
+    unsigned int size = 32;
+    MeshData mesh = GridMesh(size, true);
+    vector<MeshLod> lods = MeshSimplifier::BuildLods(mesh, 0.01f);
+    CHECK(!lods.empty());
+    CHECK(lods.size() <= MeshSimplifier::MAX_LODS);
+    size_t previousCount = mesh.indices.size();
+    for (const MeshLod &lod : lods)
+    {
+        CHECK(validTriangles(lod.indices, mesh.vertices.size()));
+        CHECK(lod.indices.size() < previousCount);
+        CHECK(lod.error < 1e-4f);
+        previousCount = lod.indices.size();
+
+        set<unsigned int> used(lod.indices.begin(), lod.indices.end());
+        for (unsigned int i = 0; i <= size; i++)
+        {
+            CHECK(used.count(i));                        // z = 0
+            CHECK(used.count(size * (size + 1) + i));    // z = size
+            CHECK(used.count(i * (size + 1)));           // x = 0
+            CHECK(used.count(i * (size + 1) + size));    // x = size
+        }
+    }
+}
+
+// A sphere has no flat region: the error grows from level to level and stays under the bound
+static void testSphere()
+{
+    MeshData mesh = SphereMesh(32);
+    MeshOptimizer::Optimize(mesh);
+    float errorBound = 0.05f;
+    vector<MeshLod> lods = MeshSimplifier::BuildLods(mesh, errorBound);
+    CHECK(!lods.empty());
+    float previousError = 0.0f;
+    for (const MeshLod &lod : lods)
+    {
+        CHECK(validTriangles(lod.indices, mesh.vertices.size()));
+        CHECK(lod.error >= previousError);
+        CHECK(lod.error <= errorBound);
+        previousError = lod.error;
+    }
+
+    // a bound of 0 allows no collapse that moves the surface
+    float error;
+    vector<unsigned int> exact = MeshSimplifier::Simplify(mesh.vertices, mesh.indices, mesh.indices.size() / 2, 0.0f,
+                                                          mesh.bounds.radius, error);
+    CHECK(exact.size() == mesh.indices.size());
+    CHECK(error == 0.0f);
+}
+
+// Without a radius there is nothing to measure errors against and the indices come back as they are
+static void testNoRadius()
+{
+    MeshData mesh = GridMesh(8, true);
+    float error = 1.0f;
+    vector<unsigned int> indices = MeshSimplifier::Simplify(mesh.vertices, mesh.indices, 6, 1.0f, 0.0f, error);
+    CHECK(indices == mesh.indices);
+    CHECK(error == 0.0f);
+}
+
+int main()
+{
+    testFlatGrid();
+    testSphere();
+    testNoRadius();
+    return CheckFailures();
+}
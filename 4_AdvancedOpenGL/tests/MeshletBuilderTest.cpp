@@ -0,0 +1,90 @@
+#include <set>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Check.hpp"
+#include "MeshletBuilder.hpp"
+#include "MeshOptimizer.hpp"
+#include "TestMeshes.hpp"
+
+// Meshlets cover the index buffer in order, each within the size limits and its own bounds
+static void testBuild(const MeshData &mesh, const vector<Meshlet> &meshlets)
+{
+    CHECK(!meshlets.empty());
+    uint32_t nextIndex = 0;
+    for (const Meshlet &meshlet : meshlets)
+    {
+        CHECK(meshlet.firstIndex == nextIndex);
+        CHECK(meshlet.triangleCount > 0);
+        CHECK(meshlet.triangleCount <= MeshletBuilder::MAX_TRIANGLES);
+        nextIndex += 3 * meshlet.triangleCount;
+
+        set<unsigned int> vertices(mesh.indices.begin() + meshlet.firstIndex, mesh.indices.begin() + nextIndex);
+        CHECK(vertices.size() <= MeshletBuilder::MAX_VERTICES);
+        for (unsigned int vertex : vertices)
+        {
+            const glm::vec3 &position = mesh.vertices[vertex].Position;
+            for (int axis = 0; axis < 3; axis++)
+                CHECK(position[axis] >= meshlet.bounds.min[axis] - 1e-5f && position[axis] <= meshlet.bounds.max[axis] + 1e-5f);
+            CHECK(glm::length(position - meshlet.bounds.center) <= meshlet.bounds.radius + 1e-5f);
+        }
+    }
+    CHECK(nextIndex == mesh.indices.size());
+
+    vector<unsigned int> partial(mesh.indices.begin(), mesh.indices.begin() + 4);
+    CHECK(MeshletBuilder::Build(mesh.vertices, partial).empty());
+}
+
+// A meshlet that faces away may only hold triangles that are back-facing from eye
+static void testFacesAway(const MeshData &mesh, const vector<Meshlet> &meshlets, const glm::vec3 &eye)
+{
+    size_t facingAway = 0;
+    for (const Meshlet &meshlet : meshlets)
+    {
+        if (!MeshletBuilder::FacesAway(meshlet, eye))
+            continue;
+        facingAway++;
+        for (uint32_t i = meshlet.firstIndex; i < meshlet.firstIndex + 3 * meshlet.triangleCount; i += 3)
+        {
+            glm::vec3 a = mesh.vertices[mesh.indices[i]].Position;
+            glm::vec3 b = mesh.vertices[mesh.indices[i + 1]].Position;
+            glm::vec3 c = mesh.vertices[mesh.indices[i + 2]].Position;
+            glm::vec3 normal = glm::cross(b - a, c - a);
+            CHECK(glm::dot(normal, a - eye) >= 0.0f);
+        }
+    }
+    // from outside, a good part of the sphere is out of sight
+    CHECK(facingAway > meshlets.size() / 4);
+}
+
+static void testCull(const vector<Meshlet> &meshlets)
+{
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, 100.0f);
+    glm::vec3 eye(0.0f, 0.0f, 4.0f);
+    glm::mat4 view = glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    Frustum frustum = Frustum::FromMatrix(projection * view);
+
+    // the whole sphere is on screen: without an eye nothing is culled, with one the back is
+    vector<uint8_t> visible;
+    CHECK(MeshletBuilder::Cull(meshlets, frustum, nullptr, visible) == meshlets.size());
+    CHECK(visible.size() == meshlets.size());
+    size_t frontVisible = MeshletBuilder::Cull(meshlets, frustum, &eye, visible);
+    CHECK(frontVisible > 0 && frontVisible < meshlets.size());
+    for (size_t i = 0; i < meshlets.size(); i++)
+        CHECK(visible[i] == !MeshletBuilder::FacesAway(meshlets[i], eye));
+
+    // looking away from the sphere
+    glm::mat4 away = glm::lookAt(eye, eye + glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    CHECK(MeshletBuilder::Cull(meshlets, Frustum::FromMatrix(projection * away), &eye, visible) == 0);
+}
+
+int main()
+{
+    MeshData sphere = SphereMesh(48);
+    MeshOptimizer::Optimize(sphere);
+    vector<Meshlet> meshlets = MeshletBuilder::Build(sphere.vertices, sphere.indices);
+    testBuild(sphere, meshlets);
+    testFacesAway(sphere, meshlets, glm::vec3(0.0f, 0.0f, 4.0f));
+    testCull(meshlets);
+    return CheckFailures();
+}
@@ -0,0 +1,77 @@
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Check.hpp"
+#include "SceneGraph.hpp"
+
+static glm::mat4 translation(float x, float y, float z)
+{
+    return glm::translate(glm::mat4(1.0f), glm::vec3(x, y, z));
+}
+
+static glm::vec3 origin(const glm::mat4 &world)
+{
+    return glm::vec3(world[3]);
+}
+
+int main()
+{
+    // root
+    //   arm
+    //     hand (meshes 7 and 8)
+    //   leg
+    SceneGraph graph;
+    uint32_t root = graph.AddNode(SceneGraph::NO_NODE, translation(1.0f, 0.0f, 0.0f), "root");
+    uint32_t arm = graph.AddNode(root, translation(0.0f, 2.0f, 0.0f), "arm");
+    uint32_t hand = graph.AddNode(arm, translation(0.0f, 0.0f, 3.0f), "hand");
+    graph.AddMesh(hand, 7);
+    graph.AddMesh(hand, 8);
+    uint32_t leg = graph.AddNode(root, translation(0.0f, -1.0f, 0.0f), "leg");
+
+    CHECK(graph.NodeCount() == 4);
+    CHECK(graph.Parent(hand) == arm);
+    CHECK(graph.Find("leg") == leg);
+    CHECK(graph.Find("tail") == SceneGraph::NO_NODE);
+    CHECK(graph.MeshCount(hand) == 2 && graph.MeshCount(arm) == 0);
+    CHECK(graph.MeshRefs()[graph.FirstMesh(hand)] == 7);
+
+    // meshes go on the last node only
+    graph.AddMesh(arm, 9);
+    CHECK(graph.MeshCount(arm) == 0 && graph.MeshRefs().size() == 2);
+
+    CHECK(graph.Dirty());
+    CHECK(graph.Update() == 4);
+    CHECK(!graph.Dirty());
+    CHECK(origin(graph.World(hand)) == glm::vec3(1.0f, 2.0f, 3.0f));
+    CHECK(origin(graph.World(leg)) == glm::vec3(1.0f, -1.0f, 0.0f));
+
+    // nothing dirty, nothing updated
+    CHECK(graph.Update() == 0);
+    CHECK(graph.UpdatedRanges().empty());
+
+    // moving the arm updates its subtree and leaves the leg alone
+    graph.SetLocal(arm, translation(0.0f, 4.0f, 0.0f));
+    CHECK(graph.Update() == 2);
+    CHECK(graph.LastUpdate().nodesUpdated == 2);
+    CHECK(graph.UpdatedRanges().size() == 1 && graph.UpdatedRanges()[0] == make_pair(arm, hand + 1));
+    CHECK(origin(graph.World(hand)) == glm::vec3(1.0f, 4.0f, 3.0f));
+    CHECK(graph.Local(arm) == translation(0.0f, 4.0f, 0.0f));
+
+    // a dirty node inside a dirty subtree is updated once, with it
+    graph.SetLocal(hand, translation(0.0f, 0.0f, 5.0f));
+    graph.SetLocal(root, translation(-1.0f, 0.0f, 0.0f));
+    graph.SetLocal(leg, translation(0.0f, -2.0f, 0.0f));
+    CHECK(graph.Update() == 4);
+    CHECK(graph.UpdatedRanges().size() == 1);
+    CHECK(origin(graph.World(hand)) == glm::vec3(-1.0f, 4.0f, 5.0f));
+    CHECK(origin(graph.World(leg)) == glm::vec3(-1.0f, -2.0f, 0.0f));
+
+    // two separate subtrees are two ranges
+    graph.SetLocal(leg, translation(0.0f, -3.0f, 0.0f));
+    graph.SetLocal(hand, translation(0.0f, 0.0f, 6.0f));
+    CHECK(graph.Update() == 2);
+    CHECK(graph.UpdatedRanges().size() == 2);
+
+    graph.Clear();
+    CHECK(graph.NodeCount() == 0 && graph.Find("root") == SceneGraph::NO_NODE);
+    return CheckFailures();
+}
@@ -0,0 +1,101 @@
+#ifndef TESTMESHES_HPP
+#define TESTMESHES_HPP
+
+#include <cmath>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include "Mesh.hpp"
+
+using namespace std;
+// --------------------- Test Meshes --------------------- //
+/*
+    Generated meshes the geometry tests share, with their bounds filled in
+    the way Model fills them at import.
+*/
+
+// Bounds of every vertex
+inline Bounds VertexBounds(const vector<Vertex> &vertices)
+{
+    Bounds bounds;
+    bounds.min = bounds.max = vertices[0].Position;
+    for (const Vertex &vertex : vertices)
+    {
+        bounds.min = glm::min(bounds.min, vertex.Position);
+        bounds.max = glm::max(bounds.max, vertex.Position);
+    }
+    bounds.center = (bounds.min + bounds.max) * 0.5f;
+    for (const Vertex &vertex : vertices)
+        bounds.radius = glm::max(bounds.radius, glm::length(vertex.Position - bounds.center));
+    return bounds;
+}
+
+// Flat square of size x size quads on the xz plane, facing +y. Unwelded, every triangle
+// gets vertices of its own, the way OBJ files come in.
+inline MeshData GridMesh(unsigned int size, bool welded)
+{
+    MeshData mesh;
+    auto vertexAt = [size](unsigned int x, unsigned int z) {
+        Vertex vertex;
+        vertex.Position = glm::vec3((float)x / size - 0.5f, 0.0f, (float)z / size - 0.5f);
+        vertex.Normal = glm::vec3(0.0f, 1.0f, 0.0f);
+        vertex.TexCoords = glm::vec2((float)x / size, (float)z / size);
+        return vertex;
+    };
+    if (welded)
+        for (unsigned int z = 0; z <= size; z++)
+            for (unsigned int x = 0; x <= size; x++)
+                mesh.vertices.push_back(vertexAt(x, z));
+    for (unsigned int z = 0; z < size; z++)
+    {
+        for (unsigned int x = 0; x < size; x++)
+        {
+            unsigned int corners[6][2] = { { x, z }, { x, z + 1 }, { x + 1, z }, { x + 1, z }, { x, z + 1 }, { x + 1, z + 1 } };
+            for (unsigned int *corner : corners)
+            {
+                if (welded)
+                    mesh.indices.push_back(corner[1] * (size + 1) + corner[0]);
+                else
+                {
+                    mesh.indices.push_back((unsigned int)mesh.vertices.size());
+                    mesh.vertices.push_back(vertexAt(corner[0], corner[1]));
+                }
+            }
+        }
+    }
+    mesh.bounds = VertexBounds(mesh.vertices);
+    return mesh;
+}
+
+// Unit sphere of rings x 2 * rings quads, wound counter-clockwise seen from outside
+inline MeshData SphereMesh(unsigned int rings)
+{
+    MeshData mesh;
+    unsigned int segments = 2 * rings;
+    for (unsigned int ring = 0; ring <= rings; ring++)
+    {
+        float theta = glm::pi<float>() * ring / rings;
+        for (unsigned int segment = 0; segment <= segments; segment++)
+        {
+            float phi = 2.0f * glm::pi<float>() * segment / segments;
+            Vertex vertex;
+            vertex.Position = glm::vec3(sin(theta) * cos(phi), cos(theta), sin(theta) * sin(phi));
+            vertex.Normal = vertex.Position;
+            vertex.TexCoords = glm::vec2((float)segment / segments, (float)ring / rings);
+            mesh.vertices.push_back(vertex);
+        }
+    }
+    for (unsigned int ring = 0; ring < rings; ring++)
+    {
+        for (unsigned int segment = 0; segment < segments; segment++)
+        {
+            unsigned int a = ring * (segments + 1) + segment, b = a + segments + 1;
+            mesh.indices.insert(mesh.indices.end(), { a, a + 1, b, a + 1, b + 1, b });
+        }
+    }
+    mesh.bounds = VertexBounds(mesh.vertices);
+    return mesh;
+}
+
+#endif /* TestMeshes_hpp */
@@ -0,0 +1,145 @@
+#include <cstdlib>
+
+#include "Check.hpp"
+#include "TextureCompressor.hpp"
+
+// Reference decoders for one block, written from the format specifications, to check what
+// the encoder stores rather than how it searches
+
+static void decodeBC1(const uint8_t *block, uint8_t texels[16][4])
+{
+    uint16_t endpoints[2] = { (uint16_t)(block[0] | block[1] << 8), (uint16_t)(block[2] | block[3] << 8) };
+    int colors[4][3];
+    for (int e = 0; e < 2; e++)
+    {
+        colors[e][0] = (endpoints[e] >> 11 & 31) * 255 / 31;
+        colors[e][1] = (endpoints[e] >> 5 & 63) * 255 / 63;
+        colors[e][2] = (endpoints[e] & 31) * 255 / 31;
+    }
+    for (int c = 0; c < 3; c++)
+    {
+        if (endpoints[0] > endpoints[1])
+        {
+            colors[2][c] = (2 * colors[0][c] + colors[1][c]) / 3;
+            colors[3][c] = (colors[0][c] + 2 * colors[1][c]) / 3;
+        }
+        else
+        {
+            colors[2][c] = (colors[0][c] + colors[1][c]) / 2;
+            colors[3][c] = 0;
+        }
+    }
+    for (int texel = 0; texel < 16; texel++)
+    {
+        int index = block[4 + texel / 4] >> (2 * (texel % 4)) & 3;
+        for (int c = 0; c < 3; c++)
+            texels[texel][c] = (uint8_t)colors[index][c];
+    }
+}
+
+static void decodeBC4(const uint8_t *block, uint8_t texels[16][4], int channel)
+{
+    int values[8] = { block[0], block[1] };
+    bool eightValues = values[0] > values[1];
+    for (int i = 1; i < (eightValues ? 7 : 5); i++)
+        values[i + 1] = eightValues ? ((7 - i) * values[0] + i * values[1]) / 7 : ((5 - i) * values[0] + i * values[1]) / 5;
+    if (!eightValues)
+    {
+        values[6] = 0;
+        values[7] = 255;
+    }
+    uint64_t bits = 0;
+    for (int i = 0; i < 6; i++)
+        bits |= (uint64_t)block[2 + i] << (8 * i);
+    for (int texel = 0; texel < 16; texel++)
+        texels[texel][channel] = (uint8_t)values[bits >> (3 * texel) & 7];
+}
+
+// Largest difference of the given channels between a 4x4 image and its decoded block
+static int blockError(const uint8_t *rgba, uint8_t texels[16][4], int firstChannel, int channelCount)
+{
+    int error = 0;
+    for (int texel = 0; texel < 16; texel++)
+        for (int c = firstChannel; c < firstChannel + channelCount; c++)
+            error = max(error, abs(rgba[texel * 4 + c] - texels[texel][c]));
+    return error;
+}
+
+static void testSizes()
+{
+    CHECK(TextureCompressor::BlockBytes(BlockFormat::BC1) == 8);
+    CHECK(TextureCompressor::BlockBytes(BlockFormat::BC3) == 16);
+    CHECK(TextureCompressor::BlockBytes(BlockFormat::BC5) == 16);
+    CHECK(TextureCompressor::BlockBytes(BlockFormat::ETC2) == 8);
+    // partial blocks at the edges still take a whole block
+    CHECK(TextureCompressor::LevelBytes(BlockFormat::BC1, 1, 1) == 8);
+    CHECK(TextureCompressor::LevelBytes(BlockFormat::BC3, 5, 9) == 2 * 3 * 16);
+
+    vector<uint8_t> rgba(6 * 10 * 4, 128);
+    for (BlockFormat format : { BlockFormat::BC1, BlockFormat::BC3, BlockFormat::BC5, BlockFormat::ETC2 })
+        CHECK(TextureCompressor::Encode(format, rgba.data(), 6, 10).size() ==
+              TextureCompressor::LevelBytes(format, 6, 10));
+}
+
+static void testBC1()
+{
+    // a color 565 holds exactly comes back exactly
+    uint8_t solid[16 * 4];
+    for (int texel = 0; texel < 16; texel++)
+    {
+        solid[texel * 4] = 255;
+        solid[texel * 4 + 1] = 0;
+        solid[texel * 4 + 2] = 255;
+        solid[texel * 4 + 3] = 255;
+    }
+    uint8_t texels[16][4];
+    decodeBC1(TextureCompressor::Encode(BlockFormat::BC1, solid, 4, 4).data(), texels);
+    CHECK(blockError(solid, texels, 0, 3) == 0);
+
+    // a gradient along one axis lies on the endpoint line: only 565 and index rounding remain
+    uint8_t gradient[16 * 4];
+    for (int texel = 0; texel < 16; texel++)
+    {
+        gradient[texel * 4] = (uint8_t)(40 + 12 * (texel % 4));
+        gradient[texel * 4 + 1] = (uint8_t)(100 + 30 * (texel % 4));
+        gradient[texel * 4 + 2] = 60;
+        gradient[texel * 4 + 3] = 255;
+    }
+    decodeBC1(TextureCompressor::Encode(BlockFormat::BC1, gradient, 4, 4).data(), texels);
+    CHECK(blockError(gradient, texels, 0, 3) <= 12);
+}
+
+static void testBC3AndBC5()
+{
+    uint8_t rgba[16 * 4];
+    for (int texel = 0; texel < 16; texel++)
+    {
+        rgba[texel * 4] = (uint8_t)(16 * texel);
+        rgba[texel * 4 + 1] = (uint8_t)(255 - 10 * texel);
+        rgba[texel * 4 + 2] = 200;
+        rgba[texel * 4 + 3] = (uint8_t)(texel < 8 ? 0 : 255);
+    }
+    uint8_t texels[16][4];
+
+    // BC3: the BC4 alpha block comes first, hard alpha edges survive exactly
+    vector<uint8_t> bc3 = TextureCompressor::Encode(BlockFormat::BC3, rgba, 4, 4);
+    decodeBC4(bc3.data(), texels, 3);
+    decodeBC1(bc3.data() + 8, texels);
+    CHECK(blockError(rgba, texels, 3, 1) == 0);
+    CHECK(blockError(rgba, texels, 0, 3) <= 40);
+
+    // BC5: red then green, each to within half a step of eight values over its range
+    vector<uint8_t> bc5 = TextureCompressor::Encode(BlockFormat::BC5, rgba, 4, 4);
+    decodeBC4(bc5.data(), texels, 0);
+    decodeBC4(bc5.data() + 8, texels, 1);
+    CHECK(blockError(rgba, texels, 0, 1) <= 240 / 7 / 2 + 1);
+    CHECK(blockError(rgba, texels, 1, 1) <= 150 / 7 / 2 + 1);
+}
+
+int main()
+{
+    testSizes();
+    testBC1();
+    testBC3AndBC5();
+    return CheckFailures();
+}
@@ -0,0 +1,663 @@
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "BVH.hpp"
+#include "Camera.hpp"
+#include "Frustum.hpp"
+#include "GLState.hpp"
+#include "MeshletBuilder.hpp"
+#include "MeshOptimizer.hpp"
+#include "MipGenerator.hpp"
+#include "Model.hpp"
+#include "RenderQueue.hpp"
+#include "SceneGraph.hpp"
+#include "TextureArrays.hpp"
+#include "TextureCache.hpp"
+#include "TextureUploader.hpp"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+using namespace std;
+
+// --------------------- bench --------------------- //
+/*
+    Benchmarks of the renderer's building blocks, run one after the other in
+    a hidden window and printed to stdout:
+
+        bench [--model path] [--shaders dir] [culling|graph|format|lod|meshlets|mips|arrays]...
+
+    Without names every benchmark runs. The defaults find the backpack and
+    the chapter 3 shaders from a build directory next to src/, like the
+    chapter's own executable finds its resources.
+
+    culling   linear SIMD frustum cull against the BVH on synthetic scenes
+    graph     SceneGraph::Update on deep hierarchies, partial against full
+    format    a grid of backpacks with float and with compact vertices
+    lod       the backpack from a range of distances, with LODs and without
+    meshlets  meshlet culling on the backpack, a sphere and a terrain
+    mips      glGenerateMipmap against MipGenerator's chains and their upload
+    arrays    quads with a texture each, from 2D textures and texture arrays
+*/
+
+const int WIDTH = 800, HEIGHT = 800;
+const float FOV_DEGREES = 45.0f;
+// upload budget while waiting for a model, generous since nothing is drawn meanwhile
+const double LOAD_BUDGET_MS = 50.0;
+
+// culling: scene sizes and how often each cull is repeated for the average
+const unsigned int CULLING_SCENE_SIZES[] = { 1000, 10000, 100000 };
+const unsigned int CULLING_REPEATS = 20;
+// graph: depth of the chain and levels of the full binary tree
+const unsigned int GRAPH_CHAIN_DEPTH = 10000;
+const unsigned int GRAPH_TREE_LEVELS = 17;
+// format: frames per vertex layout and the side of the grid of backpacks
+const unsigned int FORMAT_FRAMES = 120;
+const int FORMAT_GRID = 6;
+// lod: eye distances and frames per distance and mode
+const float LOD_DISTANCES[] = { 2.0f, 5.0f, 10.0f, 20.0f, 40.0f, 80.0f };
+const unsigned int LOD_FRAMES = 30;
+// meshlets: rings of the sphere and quads per side of the terrain
+const unsigned int MESHLET_SPHERE_RINGS = 256;
+const unsigned int MESHLET_TERRAIN_SIZE = 512;
+// mips: side of the square RGBA image and runs per method
+const int MIP_SIZE = 4096;
+const unsigned int MIP_REPEATS = 3;
+// arrays: quads (one material each), their texture size and frames per mode
+const int ARRAY_MATERIALS = 64;
+const int ARRAY_TEXTURE_SIZE = 256;
+const unsigned int ARRAY_FRAMES = 30;
+
+struct BenchContext {
+  string modelPath;
+  Shader *lighting;
+  Shader *compact;
+  Shader *array;
+  glm::mat4 projection;
+  int viewportHeight;
+  shared_ptr<Model> model;
+  shared_ptr<Model> compactModel;
+};
+
+static double msSince(chrono::steady_clock::time_point start) {
+  return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+// Streams a model in and waits for it
+static shared_ptr<Model> loadNow(const string &path, VertexFormat format) {
+  shared_ptr<Model> model = Model::LoadAsync(path, format);
+  while (!model->IsLoaded())
+    Model::UploadPending(LOAD_BUDGET_MS);
+  return model;
+}
+
+static Model &backpack(BenchContext &context) {
+  if (!context.model)
+    context.model = loadNow(context.modelPath, VertexFormat::Float);
+  return *context.model;
+}
+
+// --------------------- culling --------------------- //
+static void benchCulling(BenchContext &) {
+  glm::mat4 projection = glm::perspective(glm::radians(FOV_DEGREES), 1.0f, 0.1f, 100.0f);
+  glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+  Frustum frustum = Frustum::FromMatrix(projection * view);
+  mt19937 random(1);
+  uniform_real_distribution<float> position(-100.0f, 100.0f);
+  uniform_real_distribution<float> size(0.2f, 2.0f);
+
+  for (unsigned int meshCount : CULLING_SCENE_SIZES) {
+    vector<Bounds> scene;
+    FrustumCuller linear;
+    for (unsigned int i = 0; i < meshCount; i++) {
+      Bounds bounds;
+      bounds.center = glm::vec3(position(random), position(random), position(random));
+      glm::vec3 extents(size(random), size(random), size(random));
+      bounds.min = bounds.center - extents;
+      bounds.max = bounds.center + extents;
+      bounds.radius = glm::length(extents);
+      scene.push_back(bounds);
+      linear.Add(bounds);
+    }
+
+    BVH bvh;
+    bvh.Build(scene);
+
+    vector<uint8_t> visible;
+    size_t linearVisible = 0, bvhVisible = 0;
+    auto start = chrono::steady_clock::now();
+    for (unsigned int i = 0; i < CULLING_REPEATS; i++)
+      linearVisible = linear.Cull(frustum, visible);
+    double linearMs = msSince(start) / CULLING_REPEATS;
+    start = chrono::steady_clock::now();
+    for (unsigned int i = 0; i < CULLING_REPEATS; i++)
+      bvhVisible = bvh.Cull(frustum, visible);
+    double bvhMs = msSince(start) / CULLING_REPEATS;
+
+    const BVHTraversal &traversal = bvh.LastTraversal();
+    cout << meshCount << " meshes: BVH built in " << bvh.BuildMs() << " ms (" << bvh.NodeCount() << " nodes); cull "
+         << linearMs << " ms linear, " << bvhMs << " ms BVH (" << traversal.nodesVisited << " nodes, "
+         << traversal.planeTests << " plane tests vs " << 6 * meshCount << "); " << bvhVisible << " visible"
+         << (bvhVisible == linearVisible ? "" : " (MISMATCH with linear)") << endl;
+  }
+}
+
+// --------------------- graph --------------------- //
+// Times one Update after marking the given nodes dirty
+static void timeGraphUpdate(SceneGraph &graph, const vector<uint32_t> &nodes, const char *label) {
+  glm::mat4 nudge = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.01f, 0.0f));
+  for (uint32_t node : nodes)
+    graph.SetLocal(node, nudge * graph.Local(node));
+  graph.Update();
+  cout << "  " << label << ": " << graph.LastUpdate().nodesUpdated << " of " << graph.NodeCount() << " nodes in "
+       << graph.LastUpdate().ms << " ms" << endl;
+}
+
+static void benchGraph(BenchContext &) {
+  glm::mat4 step = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 0.1f));
+
+  SceneGraph chain;
+  uint32_t parent = SceneGraph::NO_NODE;
+  for (unsigned int i = 0; i < GRAPH_CHAIN_DEPTH; i++)
+    parent = chain.AddNode(parent, step);
+  chain.Update();
+  cout << "Chain of " << GRAPH_CHAIN_DEPTH << " nodes:" << endl;
+  timeGraphUpdate(chain, { 0 }, "root moved");
+  timeGraphUpdate(chain, { GRAPH_CHAIN_DEPTH / 2 }, "middle node moved");
+  timeGraphUpdate(chain, { GRAPH_CHAIN_DEPTH - 10 }, "node near the tip moved");
+
+  // full binary tree added depth first, so each subtree is one range
+  SceneGraph tree;
+  vector<uint32_t> leaves;
+  vector<pair<uint32_t, unsigned int>> pending = { { SceneGraph::NO_NODE, 0 } };
+  while (!pending.empty()) {
+    pair<uint32_t, unsigned int> next = pending.back();
+    pending.pop_back();
+    uint32_t node = tree.AddNode(next.first, step);
+    if (next.second + 1 < GRAPH_TREE_LEVELS) {
+      pending.push_back({ node, next.second + 1 });
+      pending.push_back({ node, next.second + 1 });
+    } else
+      leaves.push_back(node);
+  }
+  tree.Update();
+  cout << "Binary tree of " << GRAPH_TREE_LEVELS << " levels:" << endl;
+  timeGraphUpdate(tree, { 0 }, "root moved");
+  timeGraphUpdate(tree, { 1 }, "one child of the root moved");
+  mt19937 random(1);
+  vector<uint32_t> someLeaves;
+  for (size_t i = 0; i < leaves.size() / 100; i++)
+    someLeaves.push_back(leaves[random() % leaves.size()]);
+  timeGraphUpdate(tree, someLeaves, "1% of the leaves moved");
+}
+
+// --------------------- format --------------------- //
+static void benchFormat(BenchContext &context) {
+  Model &floatModel = backpack(context);
+  if (!context.compactModel)
+    context.compactModel = loadNow(context.modelPath, VertexFormat::Compact);
+  Model &compactModel = *context.compactModel;
+
+  Camera viewer(glm::vec3(2.0f * FORMAT_GRID, 6.0f, 8.0f));
+  glm::mat4 view = viewer.GetViewMatrix();
+  Frustum frustum = viewer.GetFrustum(context.projection);
+  LodView lod = viewer.GetLodView((float)context.viewportHeight);
+  RenderQueue queue;
+  double frameMs[2] = { 0.0, 0.0 };
+  for (int compact = 0; compact < 2; compact++) {
+    Shader &shader = compact ? *context.compact : *context.lighting;
+    Model &model = compact ? compactModel : floatModel;
+    for (unsigned int frame = 0; frame < FORMAT_FRAMES; frame++) {
+      auto start = chrono::steady_clock::now();
+      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+      shader.Activate();
+      shader.setMat4("view", view);
+      shader.setMat4("projection", context.projection);
+      queue.Begin(view);
+      for (int x = 0; x < FORMAT_GRID; x++)
+        for (int z = 0; z < FORMAT_GRID; z++)
+          model.Submit(queue, shader, glm::translate(glm::mat4(1.0f), glm::vec3(x * 4.0f, 0.0f, -z * 4.0f)),
+                       frustum, lod);
+      queue.Flush();
+      // wait for the GPU so the time covers the vertex fetches, not just the submission
+      glFinish();
+      frameMs[compact] += msSince(start);
+      FrameCounters::EndFrame();
+    }
+  }
+  queue.Delete();
+  cout << "Vertex format (" << FORMAT_GRID * FORMAT_GRID << " backpacks): float " << frameMs[0] / FORMAT_FRAMES
+       << " ms/frame with " << floatModel.VertexBufferBytes() / 1024 << " KB of vertices, compact "
+       << frameMs[1] / FORMAT_FRAMES << " ms/frame with " << compactModel.VertexBufferBytes() / 1024 << " KB" << endl;
+}
+
+// --------------------- lod --------------------- //
+static void benchLod(BenchContext &context) {
+  Model &model = backpack(context);
+  Shader &shader = *context.lighting;
+  RenderQueue queue;
+  for (float distance : LOD_DISTANCES) {
+    Camera viewer(glm::vec3(0.0f, 0.0f, distance));
+    glm::mat4 view = viewer.GetViewMatrix();
+    Frustum frustum = viewer.GetFrustum(context.projection);
+    cout << "Distance " << distance << ":";
+    for (bool useLod : { false, true }) {
+      LodView lod = useLod ? viewer.GetLodView((float)context.viewportHeight) : LodView();
+      double totalMs = 0.0;
+      for (unsigned int frame = 0; frame < LOD_FRAMES; frame++) {
+        auto start = chrono::steady_clock::now();
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        shader.Activate();
+        shader.setMat4("view", view);
+        shader.setMat4("projection", context.projection);
+        queue.Begin(view);
+        model.Submit(queue, shader, glm::mat4(1.0f), frustum, lod);
+        queue.Flush();
+        glFinish();
+        totalMs += msSince(start);
+        FrameCounters::EndFrame();
+      }
+      cout << (useLod ? ", LOD " : " full ") << queue.Stats().triangles << " triangles " << totalMs / LOD_FRAMES
+           << " ms";
+    }
+    cout << endl;
+  }
+  queue.Delete();
+}
+
+// --------------------- meshlets --------------------- //
+// Prints the share of triangles culled since the last call, per cause
+static void printMeshletCull(const string &label) {
+  FrameCounters::EndFrame();
+  const MeshletStats &stats = MeshletBuilder::Stats();
+  double culledPercent = stats.triangles ? 100.0 * stats.trianglesCulled / stats.triangles : 0.0;
+  cout << "  " << label << ": " << culledPercent << "% of " << stats.triangles << " triangles culled ("
+       << stats.frustumCulled << " meshlets off screen, " << stats.coneCulled << " facing away, of " << stats.meshlets
+       << ") in " << stats.cullMs << " ms" << endl;
+}
+
+static void cullSynthetic(const string &name, MeshData &data, const glm::mat4 &projection,
+                          const vector<pair<string, glm::vec3>> &views) {
+  MeshOptimizer::Optimize(data);
+  auto start = chrono::steady_clock::now();
+  vector<Meshlet> meshlets = MeshletBuilder::Build(data.vertices, data.indices);
+  double buildMs = msSince(start);
+  cout << name << ": " << data.indices.size() / 3 << " triangles in " << meshlets.size() << " meshlets, built in "
+       << buildMs << " ms" << endl;
+  vector<uint8_t> visible;
+  for (const pair<string, glm::vec3> &view : views) {
+    glm::mat4 lookAt = glm::lookAt(view.second, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    MeshletBuilder::Cull(meshlets, Frustum::FromMatrix(projection * lookAt), &view.second, visible);
+    printMeshletCull(view.first);
+  }
+}
+
+static void benchMeshlets(BenchContext &context) {
+  Model &model = backpack(context);
+  Shader &shader = *context.lighting;
+  const glm::mat4 &projection = context.projection;
+  // whatever was counted before is not part of the benchmark
+  FrameCounters::EndFrame();
+
+  RenderQueue queue;
+  const vector<pair<string, glm::vec3>> backpackViews = {
+      { "front", glm::vec3(0.0f, 0.0f, 4.0f) }, { "side", glm::vec3(4.0f, 0.0f, 0.0f) },
+      { "back", glm::vec3(0.0f, 0.0f, -4.0f) }, { "above", glm::vec3(0.0f, 4.0f, 1.0f) },
+      { "close up", glm::vec3(0.5f, 0.5f, 1.5f) } };
+  bool wasCulling = Model::MeshletCulling();
+  cout << "Backpack:" << endl;
+  for (const pair<string, glm::vec3> &eye : backpackViews) {
+    glm::mat4 view = glm::lookAt(eye.second, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    Frustum frustum = Frustum::FromMatrix(projection * view);
+    // a pixel error of 0 keeps every mesh at full detail, so all of it goes through the meshlet cull
+    LodView lod;
+    lod.position = eye.second;
+    lod.projectionScale = context.viewportHeight * 0.5f * projection[1][1];  // projection[1][1] is 1 / tan(fovY / 2)
+    lod.pixelError = 0.0f;
+    size_t triangles[2];
+    for (bool cull : { false, true }) {
+      Model::SetMeshletCulling(cull);
+      shader.Activate();
+      shader.setMat4("view", view);
+      shader.setMat4("projection", projection);
+      queue.Begin(view);
+      model.Submit(queue, shader, glm::mat4(1.0f), frustum, lod);
+      queue.Flush();
+      FrameCounters::EndFrame();
+      triangles[cull] = queue.Stats().triangles;
+    }
+    printMeshletCull(eye.first);
+    cout << "    " << triangles[1] << " of " << triangles[0] << " triangles drawn" << endl;
+  }
+  Model::SetMeshletCulling(wasCulling);
+  queue.Delete();
+
+  // unit sphere
+  MeshData sphere;
+  unsigned int segments = 2 * MESHLET_SPHERE_RINGS;
+  for (unsigned int ring = 0; ring <= MESHLET_SPHERE_RINGS; ring++) {
+    float theta = glm::pi<float>() * ring / MESHLET_SPHERE_RINGS;
+    for (unsigned int segment = 0; segment <= segments; segment++) {
+      float phi = 2.0f * glm::pi<float>() * segment / segments;
+      Vertex vertex;
+      vertex.Position = glm::vec3(sin(theta) * cos(phi), cos(theta), sin(theta) * sin(phi));
+      vertex.Normal = vertex.Position;
+      vertex.TexCoords = glm::vec2((float)segment / segments, (float)ring / MESHLET_SPHERE_RINGS);
+      sphere.vertices.push_back(vertex);
+    }
+  }
+  for (unsigned int ring = 0; ring < MESHLET_SPHERE_RINGS; ring++) {
+    for (unsigned int segment = 0; segment < segments; segment++) {
+      unsigned int a = ring * (segments + 1) + segment, b = a + segments + 1;
+      sphere.indices.insert(sphere.indices.end(), { a, a + 1, b, a + 1, b + 1, b });
+    }
+  }
+  cullSynthetic("Sphere", sphere, projection,
+                { { "outside", glm::vec3(0.0f, 0.0f, 3.0f) }, { "close", glm::vec3(0.0f, 0.5f, 1.3f) } });
+
+  // rolling height field over [-10, 10] on x and z
+  MeshData terrain;
+  unsigned int size = MESHLET_TERRAIN_SIZE;
+  for (unsigned int z = 0; z <= size; z++) {
+    for (unsigned int x = 0; x <= size; x++) {
+      float px = 20.0f * x / size - 10.0f, pz = 20.0f * z / size - 10.0f;
+      Vertex vertex;
+      vertex.Position = glm::vec3(px, sin(px) * cos(pz * 0.7f), pz);
+      vertex.Normal = glm::normalize(glm::vec3(-cos(px) * cos(pz * 0.7f), 1.0f, 0.7f * sin(px) * sin(pz * 0.7f)));
+      vertex.TexCoords = glm::vec2((float)x / size, (float)z / size);
+      terrain.vertices.push_back(vertex);
+    }
+  }
+  for (unsigned int z = 0; z < size; z++) {
+    for (unsigned int x = 0; x < size; x++) {
+      unsigned int a = z * (size + 1) + x, b = a + size + 1;
+      terrain.indices.insert(terrain.indices.end(), { a, b, a + 1, a + 1, b, b + 1 });
+    }
+  }
+  cullSynthetic("Terrain", terrain, projection,
+                { { "overview", glm::vec3(0.0f, 12.0f, 14.0f) }, { "ground level", glm::vec3(0.0f, 1.5f, 4.0f) } });
+}
+
+// --------------------- mips --------------------- //
+// Average ms of MIP_REPEATS runs of the CPU mip chain, which is left in levels
+static double timeMipChain(const vector<uint8_t> &image, MipFilter filter, bool scalar, vector<MipLevel> &levels) {
+  auto start = chrono::steady_clock::now();
+  for (unsigned int i = 0; i < MIP_REPEATS; i++)
+    levels = MipGenerator::Generate(image.data(), MIP_SIZE, MIP_SIZE, 4, filter, true, scalar);
+  return msSince(start) / MIP_REPEATS;
+}
+
+static void benchMips(BenchContext &) {
+  // smooth gradients under noise and hard edges, opaque but for a soft alpha ramp
+  int size = MIP_SIZE;
+  vector<uint8_t> image((size_t)size * size * 4);
+  mt19937 random(1);
+  uniform_int_distribution<int> noise(-24, 24);
+  for (int y = 0; y < size; y++) {
+    for (int x = 0; x < size; x++) {
+      uint8_t *texel = &image[((size_t)y * size + x) * 4];
+      bool checker = ((x / 64) + (y / 64)) % 2 == 0;
+      texel[0] = (uint8_t)glm::clamp(x * 255 / size + noise(random), 0, 255);
+      texel[1] = (uint8_t)glm::clamp(y * 255 / size + noise(random), 0, 255);
+      texel[2] = checker ? 230 : 20;
+      texel[3] = (uint8_t)(255 - y * 64 / size);
+    }
+  }
+
+  unsigned int texture;
+  glGenTextures(1, &texture);
+  GLState::Instance().BindTexture(GL_TEXTURE_2D, texture);
+  glFinish();
+  auto start = chrono::steady_clock::now();
+  for (unsigned int i = 0; i < MIP_REPEATS; i++) {
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.data());
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glFinish();
+  }
+  double glMs = msSince(start) / MIP_REPEATS;
+
+  vector<MipLevel> scalarLevels, simdLevels, kaiserLevels;
+  double scalarMs = timeMipChain(image, MipFilter::Box, true, scalarLevels);
+  double simdMs = timeMipChain(image, MipFilter::Box, false, simdLevels);
+  double kaiserMs = timeMipChain(image, MipFilter::Kaiser, false, kaiserLevels);
+  int maxDifference = 0;
+  for (size_t level = 0; level < simdLevels.size(); level++)
+    for (size_t i = 0; i < simdLevels[level].pixels.size(); i++)
+      maxDifference = max(maxDifference, abs(simdLevels[level].pixels[i] - scalarLevels[level].pixels[i]));
+
+  // what TextureCache does with a CPU chain: level 0 and every mip through the staging ring
+  TextureUploader &uploader = TextureUploader::Instance();
+  glFinish();
+  start = chrono::steady_clock::now();
+  for (unsigned int i = 0; i < MIP_REPEATS; i++) {
+    vector<MipLevel> levels = MipGenerator::Generate(image.data(), size, size, 4, MipFilter::Box, true);
+    uploader.Upload(texture, 4, size, size, image.data());
+    for (size_t level = 0; level < levels.size(); level++)
+      uploader.Upload(texture, 4, levels[level].width, levels[level].height, levels[level].pixels.data(),
+                      (GLint)level + 1);
+    glFinish();
+  }
+  double uploadMs = msSince(start) / MIP_REPEATS;
+  glDeleteTextures(1, &texture);
+  GLState::Instance().TextureDeleted(texture);
+
+  cout << size << "x" << size << " RGBA, " << simdLevels.size() << " mip levels:" << endl;
+  cout << "  glTexImage2D + glGenerateMipmap: " << glMs << " ms" << endl;
+  cout << "  CPU box: scalar " << scalarMs << " ms, " << MipGenerator::InstructionSet() << " " << simdMs << " ms ("
+       << scalarMs / simdMs << "x, levels differ by at most " << maxDifference << "); Kaiser " << kaiserMs << " ms"
+       << endl;
+  cout << "  CPU box + upload per level: " << uploadMs << " ms" << endl;
+}
+
+// --------------------- arrays --------------------- //
+// Draws meshes ARRAY_FRAMES times and prints what the queue made of them
+static void timeQuads(const char *label, vector<Mesh> &quads, Shader &shader, const glm::mat4 &view,
+                      const glm::mat4 &projection) {
+  RenderQueue queue;
+  double frameMs = 0.0;
+  for (unsigned int frame = 0; frame < ARRAY_FRAMES; frame++) {
+    auto start = chrono::steady_clock::now();
+    shader.Activate();
+    shader.setMat4("view", view);
+    shader.setMat4("projection", projection);
+    queue.Begin(view);
+    for (Mesh &quad : quads)
+      quad.Submit(queue, shader, glm::mat4(1.0f));
+    queue.Flush();
+    glFinish();
+    frameMs += msSince(start);
+    FrameCounters::EndFrame();
+  }
+  const RenderQueueStats &stats = queue.Stats();
+  cout << "  " << label << ": " << stats.draws << " draws in " << stats.drawCalls << " draw calls, "
+       << stats.materialChanges[1] << " material changes, " << stats.submitMs << " ms to submit, "
+       << frameMs / ARRAY_FRAMES << " ms/frame" << endl;
+  queue.Delete();
+}
+
+static void benchArrays(BenchContext &context) {
+  int size = ARRAY_TEXTURE_SIZE;
+  int grid = (int)ceil(sqrt((float)ARRAY_MATERIALS));
+  // both sets of quads live in one geometry buffer and are placed by their vertices, so every draw
+  // has the same vertex array and model matrix and only the textures tell them apart
+  GeometryBuffer geometry;
+  vector<Mesh> textureQuads, arrayQuads;
+  vector<unsigned int> textures;
+  vector<ArrayMaterial> materials;
+  vector<string> samplers = Mesh::SamplerNames({ "texture_diffuse" });
+  vector<unsigned char> pixels((size_t)size * size * 3);
+  for (int i = 0; i < ARRAY_MATERIALS; i++) {
+    // a checker in a color of its own
+    glm::vec3 color(0.5f + 0.5f * sin(i * 0.7f), 0.5f + 0.5f * sin(i * 1.3f + 2.0f),
+                    0.5f + 0.5f * sin(i * 2.1f + 4.0f));
+    for (int y = 0; y < size; y++) {
+      for (int x = 0; x < size; x++) {
+        float shade = ((x / 32) + (y / 32)) % 2 ? 1.0f : 0.5f;
+        for (int c = 0; c < 3; c++)
+          pixels[((size_t)y * size + x) * 3 + c] = (unsigned char)(255.0f * color[c] * shade);
+      }
+    }
+
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    TextureUploader::Instance().Upload(texture, 3, size, size, pixels.data());
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    textures.push_back(texture);
+
+    DecodedImage image;
+    image.pixels = pixels.data();
+    image.width = image.height = size;
+    image.components = 3;
+    image.srgb = true;
+    ArrayMaterial material;
+    TextureArrays::Instance().Acquire("benchmark quad " + to_string(i), { image }, samplers, material);
+    materials.push_back(material);
+
+    glm::vec2 corner(i % grid - grid * 0.5f, i / grid - grid * 0.5f);
+    for (vector<Mesh> *quads : { &textureQuads, &arrayQuads }) {
+      vector<Vertex> vertices(4);
+      for (unsigned int v = 0; v < 4; v++) {
+        glm::vec2 offset(v % 2, v / 2);
+        glm::vec2 position = corner + offset * 0.9f;
+        vertices[v].Position = glm::vec3(position.x, position.y, 0.0f);
+        vertices[v].Normal = glm::vec3(0.0f, 0.0f, 1.0f);
+        vertices[v].TexCoords = offset;
+      }
+      vector<Texture> quadTextures;
+      if (quads == &textureQuads)
+        quadTextures.push_back({ texture, "texture_diffuse", "" });
+      quads->emplace_back(std::move(vertices), vector<unsigned int>{ 0, 1, 2, 1, 3, 2 }, std::move(quadTextures),
+                          VertexFormat::Float, &geometry);
+      if (quads == &arrayQuads)
+        quads->back().UseTextureArrays(material);
+    }
+  }
+
+  glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, grid * 1.2f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+  cout << ARRAY_MATERIALS << " quads with a " << size << "x" << size << " texture each ("
+       << (RenderQueue::LayerMergingActive() ? "layers merge" : "no base instances, layers do not merge") << "):"
+       << endl;
+  timeQuads("2D textures", textureQuads, *context.lighting, view, context.projection);
+  timeQuads("texture array", arrayQuads, *context.array, view, context.projection);
+  TextureArrays::Instance().PrintStats();
+
+  for (Mesh &quad : textureQuads)
+    quad.Delete();
+  for (Mesh &quad : arrayQuads)
+    quad.Delete();
+  for (unsigned int i = 0; i < textures.size(); i++) {
+    glDeleteTextures(1, &textures[i]);
+    GLState::Instance().TextureDeleted(textures[i]);
+    TextureArrays::Instance().Release(materials[i]);
+  }
+  geometry.Delete();
+}
+
+struct Benchmark {
+  const char *name;
+  void (*run)(BenchContext &context);
+};
+
+const Benchmark BENCHMARKS[] = {
+    { "culling", benchCulling }, { "graph", benchGraph }, { "format", benchFormat },  { "lod", benchLod },
+    { "meshlets", benchMeshlets }, { "mips", benchMips }, { "arrays", benchArrays } };
+
+int main(int argc, char **argv) {
+  string modelPath = "../../3_ModelLoading/resources/models/backpack/backpack.obj";
+  string shaderDir = "../../3_ModelLoading/resources/shaders/";
+  vector<const Benchmark *> selected;
+  bool usage = false;
+  for (int i = 1; i < argc; i++) {
+    string argument = argv[i];
+    if (argument == "--model" && i + 1 < argc)
+      modelPath = argv[++i];
+    else if (argument == "--shaders" && i + 1 < argc)
+      shaderDir = string(argv[++i]) + "/";
+    else {
+      const Benchmark *found = nullptr;
+      for (const Benchmark &benchmark : BENCHMARKS)
+        if (argument == benchmark.name)
+          found = &benchmark;
+      if (found)
+        selected.push_back(found);
+      else
+        usage = true;
+    }
+  }
+  if (usage) {
+    cout << "usage: bench [--model path] [--shaders dir] [culling|graph|format|lod|meshlets|mips|arrays]..." << endl;
+    return 1;
+  }
+  if (selected.empty())
+    for (const Benchmark &benchmark : BENCHMARKS)
+      selected.push_back(&benchmark);
+
+  // the GL benchmarks draw into the default framebuffer of a window nobody sees
+  glfwInit();
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+  glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+  glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+  GLFWwindow *window = glfwCreateWindow(WIDTH, HEIGHT, "bench", NULL, NULL);
+  if (window == NULL) {
+    cout << "ERROR::BENCH::Failed to create GLFW window" << endl;
+    glfwTerminate();
+    return 1;
+  }
+  glfwMakeContextCurrent(window);
+  glewExperimental = GL_TRUE;
+  if (glewInit() != GLEW_OK) {
+    cout << "ERROR::BENCH::Failed to initialize GLEW" << endl;
+    glfwTerminate();
+    return 1;
+  }
+  stbi_set_flip_vertically_on_load(true);
+  int framebufferWidth, framebufferHeight;
+  glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+  glViewport(0, 0, framebufferWidth, framebufferHeight);
+  glEnable(GL_DEPTH_TEST);
+
+  Shader lighting((shaderDir + "phongLighting.vert").c_str(), (shaderDir + "phongLighting.frag").c_str());
+  Shader compact((shaderDir + "phongLightingCompact.vert").c_str(), (shaderDir + "phongLighting.frag").c_str());
+  Shader array((shaderDir + "phongLightingArray.vert").c_str(), (shaderDir + "phongLightingArray.frag").c_str());
+
+  BenchContext context;
+  context.modelPath = modelPath;
+  context.lighting = &lighting;
+  context.compact = &compact;
+  context.array = &array;
+  context.projection = glm::perspective(glm::radians(FOV_DEGREES),
+                                        (float)framebufferWidth / (float)framebufferHeight, 0.1f, 100.0f);
+  context.viewportHeight = framebufferHeight;
+
+  for (const Benchmark *benchmark : selected) {
+    cout << "--------------------- " << benchmark->name << " ---------------------" << endl;
+    benchmark->run(context);
+  }
+
+  if (context.model)
+    context.model->Delete();
+  if (context.compactModel)
+    context.compactModel->Delete();
+  TextureUploader::Instance().Delete();
+  TextureArrays::Instance().Delete();
+  lighting.Delete();
+  compact.Delete();
+  array.Delete();
+  glfwDestroyWindow(window);
+  glfwTerminate();
+  return 0;
+}
@@ -0,0 +1,161 @@
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Ktx2.hpp"
+#include "MipGenerator.hpp"
+#include "TextureCompressor.hpp"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+using namespace std;
+
+// --------------------- texbake --------------------- //
+/*
+    Offline texture baker. Encodes every image given on the command line to a
+    block compressed KTX2 file next to it ("metal.png" -> "metal.png.ktx2"),
+    with the full mip chain, which TextureCache then loads instead of the
+    image. Prints what decoding the image and reading the KTX2 file cost, and
+    the GPU memory of both.
+
+        texbake [--format auto|bc1|bc3|bc5|etc2] [--filter box|kaiser] [--srgb] [--data]
+                [--no-mips] [--no-flip] image...
+
+    auto picks BC3 for images with any transparency and BC1 for the rest.
+    Mips are made by MipGenerator with the chosen filter, averaging color in
+    linear light unless --data says the texels are not colors (normal maps,
+    masks; implied by bc5).
+    Images are flipped vertically like the demos load them (stb_image's
+    flip flag), since compressed blocks cannot be flipped at load time.
+*/
+
+static double msSince(chrono::steady_clock::time_point start) {
+  return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+static const char *formatName(BlockFormat format) {
+  switch (format) {
+  case BlockFormat::BC1:
+    return "BC1";
+  case BlockFormat::BC3:
+    return "BC3";
+  case BlockFormat::BC5:
+    return "BC5";
+  case BlockFormat::ETC2:
+    return "ETC2";
+  }
+  return "?";
+}
+
+static bool hasTransparency(const unsigned char *rgba, size_t texels) {
+  for (size_t i = 0; i < texels; i++)
+    if (rgba[i * 4 + 3] != 255)
+      return true;
+  return false;
+}
+
+static bool bake(const string &path, const string &formatOption, MipFilter filter, bool srgb, bool data, bool mips) {
+  auto start = chrono::steady_clock::now();
+  int width, height, components;
+  unsigned char *pixels = stbi_load(path.c_str(), &width, &height, &components, 4);
+  double decodeMs = msSince(start);
+  if (!pixels) {
+    cout << "ERROR::TEXBAKE::Could not load " << path << endl;
+    return false;
+  }
+
+  BlockFormat format = BlockFormat::BC1;
+  if (formatOption == "bc3" || (formatOption == "auto" && hasTransparency(pixels, (size_t)width * height)))
+    format = BlockFormat::BC3;
+  else if (formatOption == "bc5")
+    format = BlockFormat::BC5;
+  else if (formatOption == "etc2")
+    format = BlockFormat::ETC2;
+
+  start = chrono::steady_clock::now();
+  vector<vector<uint8_t>> levels;
+  levels.push_back(TextureCompressor::Encode(format, pixels, width, height));
+  double mipMs = 0.0;
+  if (mips) {
+    auto mipStart = chrono::steady_clock::now();
+    bool linearLight = !data && format != BlockFormat::BC5;
+    vector<MipLevel> chain = MipGenerator::Generate(pixels, width, height, 4, filter, linearLight);
+    mipMs = msSince(mipStart);
+    for (const MipLevel &level : chain)
+      levels.push_back(TextureCompressor::Encode(format, level.pixels.data(), level.width, level.height));
+  }
+  double encodeMs = msSince(start);
+  stbi_image_free(pixels);
+
+  string bakedPath = path + ".ktx2";
+  if (!Ktx2::Write(bakedPath, format, srgb, width, height, levels)) {
+    cout << "ERROR::TEXBAKE::Could not write " << bakedPath << endl;
+    return false;
+  }
+
+  // read it back the way TextureCache does, for the load time comparison
+  start = chrono::steady_clock::now();
+  std::ifstream in(bakedPath, std::ios::binary | std::ios::ate);
+  vector<uint8_t> file((size_t)in.tellg());
+  in.seekg(0, std::ios::beg);
+  in.read((char *)file.data(), file.size());
+  Ktx2Texture texture;
+  bool valid = Ktx2::Parse(std::move(file), texture);
+  double loadMs = msSince(start);
+  if (!valid) {
+    cout << "ERROR::TEXBAKE::" << bakedPath << " does not read back" << endl;
+    return false;
+  }
+
+  size_t bakedBytes = 0;
+  for (const vector<uint8_t> &data : levels)
+    bakedBytes += data.size();
+  // what TextureCache uploads for the image: RGBA8 (RGB is padded to it) plus a third for the mips
+  size_t rgbaBytes = (size_t)width * height * 4 * (mips ? 4 : 3) / 3;
+  cout << path << ": " << width << "x" << height << " " << formatName(format) << (srgb ? " sRGB" : "") << ", "
+       << levels.size() << " levels, encoded in " << encodeMs << " ms (mips " << mipMs << " ms, "
+       << MipGenerator::InstructionSet() << ") -> " << bakedPath << endl;
+  cout << "  load: image decode " << decodeMs << " ms, KTX2 read " << loadMs << " ms; GPU: "
+       << rgbaBytes / 1024 << " KB as RGBA8, " << bakedBytes / 1024 << " KB baked" << endl;
+  return true;
+}
+
+int main(int argc, char **argv) {
+  string format = "auto", filter = "box";
+  bool srgb = false, data = false, mips = true, flip = true;
+  vector<string> paths;
+  for (int i = 1; i < argc; i++) {
+    string argument = argv[i];
+    if (argument == "--format" && i + 1 < argc)
+      format = argv[++i];
+    else if (argument == "--filter" && i + 1 < argc)
+      filter = argv[++i];
+    else if (argument == "--srgb")
+      srgb = true;
+    else if (argument == "--data")
+      data = true;
+    else if (argument == "--no-mips")
+      mips = false;
+    else if (argument == "--no-flip")
+      flip = false;
+    else
+      paths.push_back(argument);
+  }
+  if (paths.empty() || (format != "auto" && format != "bc1" && format != "bc3" && format != "bc5" && format != "etc2") ||
+      (filter != "box" && filter != "kaiser")) {
+    cout << "usage: texbake [--format auto|bc1|bc3|bc5|etc2] [--filter box|kaiser] [--srgb] [--data] [--no-mips] "
+            "[--no-flip] image..." << endl;
+    return 1;
+  }
+
+  stbi_set_flip_vertically_on_load(flip);
+  int failed = 0;
+  for (const string &path : paths)
+    if (!bake(path, format, filter == "kaiser" ? MipFilter::Kaiser : MipFilter::Box, srgb, data, mips))
+      failed++;
+  return failed ? 1 : 0;
+}